@@ -0,0 +1,267 @@
+// Copyright (c) 2000 Suneido Software Corp. All rights reserved
+// Licensed under GPLv2
+
+#include "bitmap.h"
+#include "gc.h"
+#include <algorithm>
+#include <cstring>
+
+// returns the index of the first chunk >= hi
+int Bitmap::lower(uint16_t hi) const {
+	return std::lower_bound(chunks, chunks + nchunks, hi,
+			   [](const Chunk& c, uint16_t h) { return c.hi < h; }) -
+		chunks;
+}
+
+Bitmap::Chunk* Bitmap::find(uint16_t hi) const {
+	int i = lower(hi);
+	return i < nchunks && chunks[i].hi == hi ? chunks + i : nullptr;
+}
+
+// returns the chunk for hi, adding an empty one if necessary
+Bitmap::Chunk* Bitmap::insert(uint16_t hi) {
+	int i = lower(hi);
+	if (i < nchunks && chunks[i].hi == hi)
+		return chunks + i;
+	if (nchunks >= cap) {
+		cap = cap ? 2 * cap : 4;
+		auto p = new Chunk[cap];
+		std::copy(chunks, chunks + nchunks, p);
+		chunks = p;
+	}
+	std::copy_backward(chunks + i, chunks + nchunks, chunks + nchunks + 1);
+	++nchunks;
+	chunks[i] = Chunk();
+	chunks[i].hi = hi;
+	return chunks + i;
+}
+
+void Bitmap::add(uint32_t x) {
+	Chunk& c = *insert(x >> 16);
+	uint16_t lo = x & 0xffff;
+	if (!c.bits) {
+		int i = std::lower_bound(c.arr, c.arr + c.n, lo) - c.arr;
+		if (i < c.n && c.arr[i] == lo)
+			return;
+		if (c.n < ARRAYMAX) {
+			if (c.n >= c.cap) {
+				c.cap = std::min(std::max(2 * c.cap, 4), int(ARRAYMAX));
+				auto arr = new (noptrs) uint16_t[c.cap];
+				std::copy(c.arr, c.arr + c.n, arr);
+				c.arr = arr;
+			}
+			std::copy_backward(c.arr + i, c.arr + c.n, c.arr + c.n + 1);
+			c.arr[i] = lo;
+			++c.n;
+			return;
+		}
+		tobits(c);
+	}
+	uint64_t& w = c.bits[lo >> 6];
+	uint64_t bit = uint64_t(1) << (lo & 63);
+	if (!(w & bit)) {
+		w |= bit;
+		++c.n;
+	}
+}
+
+bool Bitmap::has(uint32_t x) const {
+	auto c = find(x >> 16);
+	return c && has(*c, x & 0xffff);
+}
+
+bool Bitmap::has(const Chunk& c, uint16_t lo) {
+	if (c.bits)
+		return c.bits[lo >> 6] & (uint64_t(1) << (lo & 63));
+	return std::binary_search(c.arr, c.arr + c.n, lo);
+}
+
+int Bitmap::size() const {
+	int n = 0;
+	for (int i = 0; i < nchunks; ++i)
+		n += chunks[i].n;
+	return n;
+}
+
+void Bitmap::tobits(Chunk& c) {
+	c.bits = new (noptrs) uint64_t[WORDS];
+	memset(c.bits, 0, WORDS * sizeof(uint64_t));
+	for (int i = 0; i < c.n; ++i)
+		c.bits[c.arr[i] >> 6] |= uint64_t(1) << (c.arr[i] & 63);
+	c.arr = nullptr;
+	c.cap = 0;
+}
+
+void Bitmap::toarray(Chunk& c) {
+	c.arr = new (noptrs) uint16_t[std::max(c.n, 1)];
+	c.cap = c.n;
+	int i = 0;
+	for (int w = 0; w < WORDS; ++w)
+		for (uint64_t b = c.bits[w]; b; b &= b - 1)
+			c.arr[i++] = (w << 6) | __builtin_ctzll(b);
+	c.bits = nullptr;
+}
+
+// intersection ----------------------------------------------------
+
+Bitmap& Bitmap::operator&=(const Bitmap& y) {
+	if (&y == this)
+		return *this;
+	int n = 0;
+	for (int i = 0; i < nchunks; ++i)
+		if (auto yc = y.find(chunks[i].hi)) {
+			and_with(chunks[i], *yc);
+			if (chunks[i].n > 0)
+				chunks[n++] = chunks[i];
+		}
+	std::fill(chunks + n, chunks + nchunks, Chunk()); // for garbage collection
+	nchunks = n;
+	return *this;
+}
+
+void Bitmap::and_with(Chunk& c, const Chunk& y) {
+	if (!c.bits) {
+		// result is a subset of c's array
+		int n = 0;
+		for (int i = 0; i < c.n; ++i)
+			if (has(y, c.arr[i]))
+				c.arr[n++] = c.arr[i];
+		c.n = n;
+	} else if (!y.bits) {
+		// result is a subset of y's array
+		auto arr = new (noptrs) uint16_t[std::max(y.n, 1)];
+		int n = 0;
+		for (int i = 0; i < y.n; ++i)
+			if (has(c, y.arr[i]))
+				arr[n++] = y.arr[i];
+		c.bits = nullptr;
+		c.arr = arr;
+		c.cap = y.n;
+		c.n = n;
+	} else {
+		int n = 0;
+		for (int w = 0; w < WORDS; ++w)
+			n += __builtin_popcountll(c.bits[w] &= y.bits[w]);
+		c.n = n;
+		if (n <= ARRAYMAX)
+			toarray(c);
+	}
+}
+
+// union -----------------------------------------------------------
+
+Bitmap& Bitmap::operator|=(const Bitmap& y) {
+	if (&y == this)
+		return *this;
+	for (auto yc = y.chunks, end = y.chunks + y.nchunks; yc < end; ++yc)
+		or_with(*insert(yc->hi), *yc);
+	return *this;
+}
+
+void Bitmap::or_with(Chunk& c, const Chunk& y) {
+	if (!c.bits && !y.bits && c.n + y.n <= ARRAYMAX) {
+		auto arr = new (noptrs) uint16_t[std::max(c.n + y.n, 1)];
+		c.cap = c.n + y.n;
+		c.n = std::set_union(c.arr, c.arr + c.n, y.arr, y.arr + y.n, arr) -
+			arr;
+		c.arr = arr;
+		return;
+	}
+	if (!c.bits)
+		tobits(c);
+	int n = 0;
+	if (y.bits)
+		for (int w = 0; w < WORDS; ++w)
+			n += __builtin_popcountll(c.bits[w] |= y.bits[w]);
+	else {
+		for (int i = 0; i < y.n; ++i)
+			c.bits[y.arr[i] >> 6] |= uint64_t(1) << (y.arr[i] & 63);
+		for (int w = 0; w < WORDS; ++w)
+			n += __builtin_popcountll(c.bits[w]);
+	}
+	c.n = n;
+}
+
+// tests ------------------------------------------------------------
+
+#include "testing.h"
+#include <set>
+#include <vector>
+
+// values spread over chunks that end up as both arrays and bitsets
+static std::vector<uint32_t> testvals(int n, int seed) {
+	std::vector<uint32_t> v;
+	uint32_t x = seed;
+	for (int i = 0; i < n; ++i) {
+		x = x * 1103515245 + 12345;
+		v.push_back(i % 2 ? (x >> 8) % 20000 : (x >> 8) % 300000);
+	}
+	v.push_back(0xffffffff);
+	return v;
+}
+
+static void check(const Bitmap& bm, const std::set<uint32_t>& set) {
+	assert_eq(bm.size(), int(set.size()));
+	std::vector<uint32_t> v;
+	bm.foreach([&](uint32_t x) { v.push_back(x); });
+	verify(std::equal(v.begin(), v.end(), set.begin(), set.end()));
+	for (auto x : set)
+		verify(bm.has(x));
+}
+
+TEST(bitmap) {
+	Bitmap bm;
+	verify(bm.empty());
+	verify(!bm.has(123));
+	std::set<uint32_t> set;
+	for (auto x : testvals(20000, 1)) {
+		bm.add(x);
+		set.insert(x);
+	}
+	check(bm, set);
+	verify(!bm.has(300001));
+	verify(!bm.has(0xfffffffe));
+}
+
+TEST(bitmap_and_or) {
+	for (int n : {10, 3000, 20000}) {
+		std::set<uint32_t> xset, yset, both, either;
+		Bitmap x, y, a, o;
+		for (auto v : testvals(n, 1)) {
+			x.add(v);
+			xset.insert(v);
+		}
+		for (auto v : testvals(15000, 2)) {
+			y.add(v);
+			yset.insert(v);
+		}
+		std::set_intersection(xset.begin(), xset.end(), yset.begin(),
+			yset.end(), std::inserter(both, both.end()));
+		std::set_union(xset.begin(), xset.end(), yset.begin(), yset.end(),
+			std::inserter(either, either.end()));
+
+		for (auto v : xset)
+			a.add(v);
+		a &= y;
+		check(a, both);
+		for (auto v : xset)
+			o.add(v);
+		o |= y;
+		check(o, either);
+		x &= Bitmap();
+		verify(x.empty());
+	}
+}
+
+BENCHMARK(bitmap_and) {
+	Bitmap x, y;
+	for (auto v : testvals(100000, 1))
+		x.add(v);
+	for (auto v : testvals(100000, 2))
+		y.add(v);
+	while (nreps-- > 0) {
+		Bitmap z;
+		z |= x;
+		z &= y;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+// Copyright (c) 2000 Suneido Software Corp. All rights reserved
+// Licensed under GPLv2
+
+#include <cstdint>
+
+// a compressed set of 32 bit unsigned integers (similar to Roaring bitmaps)
+// values are grouped into chunks by their high 16 bits
+// chunks with up to ARRAYMAX values are sorted arrays of the low 16 bits
+// larger chunks are bitsets
+// intended for garbage collection so no destructor
+// and not copyable since copies would share chunks
+class Bitmap {
+public:
+	Bitmap() = default;
+	Bitmap(const Bitmap&) = delete;
+	Bitmap& operator=(const Bitmap&) = delete;
+
+	void add(uint32_t x);
+	bool has(uint32_t x) const;
+	// the number of values
+	int size() const;
+	bool empty() const {
+		return nchunks == 0;
+	}
+	// intersection
+	Bitmap& operator&=(const Bitmap& y);
+	// union
+	Bitmap& operator|=(const Bitmap& y);
+	// calls f with each value in ascending order
+	template <typename F>
+	void foreach(F f) const {
+		for (auto c = chunks, end = chunks + nchunks; c < end; ++c) {
+			uint32_t hi = uint32_t(c->hi) << 16;
+			if (!c->bits)
+				for (int i = 0; i < c->n; ++i)
+					f(hi | c->arr[i]);
+			else
+				for (int w = 0; w < WORDS; ++w)
+					for (uint64_t b = c->bits[w]; b; b &= b - 1)
+						f(hi | (w << 6) | __builtin_ctzll(b));
+		}
+	}
+
+private:
+	enum { ARRAYMAX = 4096, WORDS = 65536 / 64 };
+	struct Chunk {
+		uint16_t hi = 0;
+		int n = 0;                // the number of values
+		int cap = 0;              // the capacity of arr
+		uint16_t* arr = nullptr;  // sorted low 16 bits if bits is nullptr
+		uint64_t* bits = nullptr; // WORDS words or nullptr
+	};
+	int lower(uint16_t hi) const;
+	Chunk* find(uint16_t hi) const;
+	Chunk* insert(uint16_t hi);
+	static bool has(const Chunk& c, uint16_t lo);
+	static void tobits(Chunk& c);
+	static void toarray(Chunk& c);
+	static void and_with(Chunk& c, const Chunk& y);
+	static void or_with(Chunk& c, const Chunk& y);
+
+	Chunk* chunks = nullptr; // sorted by hi
+	int nchunks = 0;
+	int cap = 0;
+};
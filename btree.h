@@ -31,6 +31,8 @@ class Btree {
 	typedef Btree<LeafSlot, TreeSlot, LeafSlots, TreeSlots, Dest> btree;
 	friend void test_btree_rangefrac_onelevel();
 	friend void test_btree_rangefrac_multilevel();
+	friend void test_btree_load();
+	friend void test_btree_load_small();
 
 private:
 	// LeafNode -----------------------------------------------------
@@ -56,6 +58,7 @@ private:
 			slots.erase(slot);
 			return true;
 		}
+		// splits off a new left node and inserts x into one of the halves
 		Mmoffset split(Dest* dest, const LeafSlot& x, Mmoffset off) {
 			// variable split
 			int percent = 50;
@@ -63,30 +66,67 @@ private:
 				percent = 75;
 			else if (x > slots.back())
 				percent = 25;
-			Mmoffset leftoff = dest->alloc(NODESIZE);
-			LeafNode* left = new (dest->adr(leftoff)) LeafNode;
-
-			// int n = slots.size();
-			// int nright = (n * percent) / 100;
-			// // move first half of right keys to left
-			// left->slots.append(slots.begin(), slots.end() - nright);
-			// slots.erase(slots.begin(), slots.end() - nright);
-
-			// bool new_one_added = false;
-			int rem = (left->slots.remaining() * percent) / 100;
-			while (left->slots.remaining() > rem) {
-				left->slots.push_back(slots.front());
-				slots.erase(slots.begin());
+
+			// the halves are built in temporary nodes
+			// so this node is unchanged if x doesn't fit
+			LeafNode left;
+			LeafNode right;
+			int rem = (left.slots.remaining() * percent) / 100;
+			int n = 0;
+			while (left.slots.remaining() > rem && n < slots.size() - 1 &&
+				left.slots.append(slots[n]))
+				++n;
+
+			// the encoded size of x depends on the prefix of the half
+			// it goes in, so move the split point away from the half
+			// that doesn't have room, until both do
+			int dir = 0;
+			while (int r = split_at(n, x, left, right)) {
+				if (!dir)
+					dir = r;
+				n += dir;
+				if (n < 0 || n > slots.size())
+					except("index entry too large to insert");
 			}
 
+			Mmoffset leftoff = dest->alloc(NODESIZE);
+			LeafNode* newleft = new (dest->adr(leftoff)) LeafNode;
+			newleft->slots = left.slots;
+			slots = right.slots;
+
 			// maintain linked list of leaves
-			left->set_prev(prev());
-			left->set_next(off);
+			newleft->set_prev(prev());
+			newleft->set_next(off);
 			set_prev(leftoff);
-			if (left->prev() != NIL)
-				((LeafNode*) dest->adr(left->prev()))->set_next(leftoff);
+			if (newleft->prev() != NIL)
+				((LeafNode*) dest->adr(newleft->prev()))->set_next(leftoff);
 			return leftoff;
 		}
+		// builds the halves of a split with the first n keys in the left
+		// returns 0 if both halves have room and neither is empty
+		// else -1 to move the split point left, or 1 to move it right
+		int split_at(
+			int n, const LeafSlot& x, LeafNode& left, LeafNode& right) {
+			left.slots = LeafSlots();
+			right.slots = LeafSlots();
+			int i = 0;
+			for (; i < n; ++i)
+				if (!left.slots.append(slots[i]))
+					return -1;
+			for (; i < slots.size(); ++i)
+				if (!right.slots.append(slots[i]))
+					return 1;
+			// x can go in either half if it's between them
+			bool mustleft = n > 0 && x < slots[n - 1];
+			bool mustright = n < slots.size() && x > slots[n];
+			if (!mustright && left.insert(x) == OK)
+				return right.empty() ? -1 : 0;
+			if (!mustleft && right.insert(x) == OK)
+				return left.empty() ? 1 : 0;
+			if (mustleft || mustright)
+				return mustleft ? -1 : 1;
+			return left.slots.remaining() < right.slots.remaining() ? -1 : 1;
+		}
 		void unlink(Dest* dest) {
 			if (prev() != NIL)
 				((LeafNode*) dest->adr(prev()))->set_next(next());
@@ -396,8 +436,6 @@ public:
 		Mmoffset leftoff = leaf->split(dest, x, off);
 		LeafNode* left = (LeafNode*) dest->adr(leftoff);
 		++nnodes;
-		verify(OK ==
-			(x <= left->slots.back() ? left->insert(x) : leaf->insert(x)));
 		Key key = keydup(left->slots.back().key);
 		off = leftoff;
 
@@ -427,6 +465,86 @@ public:
 		verify(treelevels < MAXLEVELS);
 		return true;
 	}
+	// load ---------------------------------------------------------
+	// builds an empty btree bottom up from slots in ascending order
+	// filling each node completely, instead of inserting one at a time
+	template <class Iter>
+	void load(Iter first, Iter last) {
+		verify(isEmpty());
+		if (first == last)
+			return;
+		struct Level {
+			Mmoffset off;
+			TreeNode* node;
+			Key key;        // max key of the pending child
+			Mmoffset child; // pending child, not added until the next arrives
+		};
+		Level levels[MAXLEVELS];
+		int nlevels = 0;
+		// add a child to level i, splitting off full nodes up the tree
+		auto add = [&](int i, Key key, Mmoffset child) {
+			for (;; ++i) {
+				if (i == nlevels) {
+					verify(++nlevels < MAXLEVELS);
+					levels[i].off = dest->alloc(NODESIZE);
+					levels[i].node = new (dest->adr(levels[i].off)) TreeNode;
+					levels[i].child = NIL;
+					++nnodes;
+				}
+				Level& lev = levels[i];
+				if (lev.child == NIL ||
+					lev.node->slots.insert(
+						lev.node->slots.end(), TreeSlot(lev.key, lev.child))) {
+					lev.key = key;
+					lev.child = child;
+					return;
+				}
+				// node is full so pending child becomes its last
+				lev.node->lastoff = lev.child;
+				Key fullkey = lev.key;
+				Mmoffset fulloff = lev.off;
+				lev.off = dest->alloc(NODESIZE);
+				lev.node = new (dest->adr(lev.off)) TreeNode;
+				++nnodes;
+				lev.key = key;
+				lev.child = child;
+				key = fullkey;
+				child = fulloff;
+			}
+		};
+
+		++modified;
+		Mmoffset leafoff = root();
+		LeafNode* leaf = (LeafNode*) dest->adr(leafoff);
+		for (; first != last; ++first) {
+			LeafSlot x(*first);
+			verify(leaf->empty() || leaf->slots.back() < x);
+			if (leaf->slots.insert(leaf->slots.end(), x))
+				continue;
+			if (leaf->empty())
+				except("index entry too large to insert");
+			Mmoffset off = dest->alloc(NODESIZE);
+			LeafNode* next = new (dest->adr(off)) LeafNode;
+			++nnodes;
+			leaf->set_next(off);
+			next->set_prev(leafoff);
+			add(0, keydup(leaf->slots.back().key), leafoff);
+			leaf = next;
+			leafoff = off;
+			verify(leaf->slots.insert(leaf->slots.end(), x));
+		}
+		if (nlevels == 0)
+			return; // everything fit in the root leaf
+		add(0, keydup(leaf->slots.back().key), leafoff);
+		// the pending child of each level is its last
+		for (int i = 0; i < nlevels; ++i) {
+			levels[i].node->lastoff = levels[i].child;
+			if (i + 1 < nlevels)
+				add(i + 1, levels[i].key, levels[i].off);
+		}
+		root_ = levels[nlevels - 1].off;
+		treelevels = nlevels;
+	}
 	// erase --------------------------------------------------------
 	bool erase(const Key& key) {
 		TreeNode* nodes[MAXLEVELS];
@@ -466,23 +584,6 @@ public:
 		root_ = off;
 		return true;
 	}
-	// NOTE: increment is only for Filters since it refers to count
-	bool increment(const Key& key) {
-		Mmoffset off = root();
-		for (int i = 0; i < treelevels; ++i) {
-			TreeNode* node = (TreeNode*) dest->adr(off);
-			off = node->find(key);
-		}
-		LeafNode* leaf = (LeafNode*) dest->adr(off);
-		LeafSlotsIterator t = std::lower_bound(
-			leaf->slots.begin(), leaf->slots.end(), LeafSlot(key));
-		if ((*t).key == key) {
-			++(*t).count; // Note: couldn't do this for Index
-			return true;
-		} else
-			return false;
-	}
-
 	//---------------------------------------------------------------
 
 	float rangefrac(const Key& from, const Key& to) {
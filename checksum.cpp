@@ -27,15 +27,11 @@
 	DO8(buf, 0); \
 	DO8(buf, 8)
 
-uint32_t checksum(uint32_t adler, const void* p, int len) {
+static uint32_t checksum_scalar(uint32_t adler, const uint8_t* buf, int len) {
 	uint32_t s1 = adler & 0xffff;
 	uint32_t s2 = (adler >> 16) & 0xffff;
 	int k;
 
-	if (p == 0)
-		return 1;
-	auto buf = static_cast<const uint8_t*>(p);
-
 	while (len > 0) {
 		k = len < NMAX ? len : NMAX;
 		len -= k;
@@ -54,3 +50,187 @@ uint32_t checksum(uint32_t adler, const void* p, int len) {
 	}
 	return (s2 << 16) | s1;
 }
+
+// vectorized versions ----------------------------------------------
+
+// For a block of N bytes b[0..N-1]:
+//		s1 += sum of b[i]
+//		s2 += N * s1 + sum of (N - i) * b[i]
+// Vectors accumulate the byte sums (vs1), the weighted sums (vs2)
+// and the running total of previous blocks' byte sums (vps)
+// which are combined with the scalar s1 and s2 at the end of each NMAX
+// chunk. Since NMAX keeps the true s2 within 32 bits, so do the parts.
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define SIMD_CHECKSUM
+#include <immintrin.h>
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+
+SSE2 static inline uint32_t hsum(__m128i v) {
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(v);
+}
+
+SSE2 static uint32_t checksum_sse2(
+	uint32_t adler, const uint8_t* buf, int len) {
+	uint32_t s1 = adler & 0xffff;
+	uint32_t s2 = (adler >> 16) & 0xffff;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i wlo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+	const __m128i whi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+
+	while (len > 0) {
+		int k = len < NMAX ? len : NMAX;
+		len -= k;
+		if (int nblocks = k / 16) {
+			k -= nblocks * 16;
+			__m128i vs1 = zero;
+			__m128i vs2 = zero;
+			__m128i vps = zero;
+			s2 += s1 * 16 * nblocks;
+			do {
+				__m128i b = _mm_loadu_si128((const __m128i*) buf);
+				vps = _mm_add_epi32(vps, vs1);
+				vs1 = _mm_add_epi32(vs1, _mm_sad_epu8(b, zero));
+				vs2 = _mm_add_epi32(
+					vs2, _mm_madd_epi16(_mm_unpacklo_epi8(b, zero), wlo));
+				vs2 = _mm_add_epi32(
+					vs2, _mm_madd_epi16(_mm_unpackhi_epi8(b, zero), whi));
+				buf += 16;
+			} while (--nblocks);
+			s2 += (hsum(vps) << 4) + hsum(vs2);
+			s1 += hsum(vs1);
+		}
+		for (; k > 0; --k) {
+			s1 += *buf++;
+			s2 += s1;
+		}
+		s1 %= BASE;
+		s2 %= BASE;
+	}
+	return (s2 << 16) | s1;
+}
+
+AVX2 static inline uint32_t hsum(__m256i v) {
+	__m128i x = _mm_add_epi32(
+		_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+	x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(x);
+}
+
+AVX2 static uint32_t checksum_avx2(
+	uint32_t adler, const uint8_t* buf, int len) {
+	uint32_t s1 = adler & 0xffff;
+	uint32_t s2 = (adler >> 16) & 0xffff;
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi16(1);
+	const __m256i weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26,
+		25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8,
+		7, 6, 5, 4, 3, 2, 1);
+
+	while (len > 0) {
+		int k = len < NMAX ? len : NMAX;
+		len -= k;
+		if (int nblocks = k / 32) {
+			k -= nblocks * 32;
+			__m256i vs1 = zero;
+			__m256i vs2 = zero;
+			__m256i vps = zero;
+			s2 += s1 * 32 * nblocks;
+			do {
+				__m256i b = _mm256_loadu_si256((const __m256i*) buf);
+				vps = _mm256_add_epi32(vps, vs1);
+				vs1 = _mm256_add_epi32(vs1, _mm256_sad_epu8(b, zero));
+				vs2 = _mm256_add_epi32(vs2,
+					_mm256_madd_epi16(_mm256_maddubs_epi16(b, weights), ones));
+				buf += 32;
+			} while (--nblocks);
+			s2 += (hsum(vps) << 5) + hsum(vs2);
+			s1 += hsum(vs1);
+		}
+		for (; k > 0; --k) {
+			s1 += *buf++;
+			s2 += s1;
+		}
+		s1 %= BASE;
+		s2 %= BASE;
+	}
+	return (s2 << 16) | s1;
+}
+#endif
+
+typedef uint32_t (*ChecksumFn)(uint32_t adler, const uint8_t* buf, int len);
+
+// choose the best version the cpu supports
+static ChecksumFn checksum_fn() {
+#ifdef SIMD_CHECKSUM
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return checksum_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return checksum_sse2;
+#endif
+	return checksum_scalar;
+}
+
+uint32_t checksum(uint32_t adler, const void* p, int len) {
+	if (p == 0)
+		return 1;
+	static const ChecksumFn fn = checksum_fn();
+	return fn(adler, static_cast<const uint8_t*>(p), len);
+}
+
+// tests ------------------------------------------------------------
+
+#include "testing.h"
+#include "random.h"
+
+static void test_checksum_fn(ChecksumFn fn) {
+	const int N = 20000;
+	static uint8_t buf[N];
+	for (int i = 0; i < N; ++i)
+		buf[i] = random(256);
+	for (int i = 0; i < 200; ++i) {
+		int off = random(64);
+		int len = random(N - off);
+		uint32_t adler = random(2) ? 1 : checksum_scalar(1, buf, random(N));
+		assert_eq(fn(adler, buf + off, len),
+			checksum_scalar(adler, buf + off, len));
+	}
+	// worst case for overflow
+	memset(buf, 0xff, N);
+	assert_eq(fn(0xfff0fff0, buf, N), checksum_scalar(0xfff0fff0, buf, N));
+}
+
+TEST(checksum) {
+	assert_eq(checksum(1, "", 0), 1u);
+	assert_eq(checksum(1, "Wikipedia", 9), 0x11E60398u);
+	test_checksum_fn(checksum_fn());
+#ifdef SIMD_CHECKSUM
+	test_checksum_fn(checksum_sse2);
+	if (__builtin_cpu_supports("avx2"))
+		test_checksum_fn(checksum_avx2);
+#endif
+}
+
+//-------------------------------------------------------------------
+
+static const int BENCH_SIZE = 1024 * 1024;
+
+static void checksum_bench(ChecksumFn fn, int64_t nreps) {
+	static uint8_t buf[BENCH_SIZE];
+	while (nreps-- > 0)
+		fn(1, buf, BENCH_SIZE);
+}
+
+BENCHMARK(checksum_scalar) {
+	checksum_bench(checksum_scalar, nreps);
+}
+
+BENCHMARK(checksum) {
+	checksum_bench(checksum_fn(), nreps);
+}
@@ -7,4 +7,5 @@ const char* cmdnames[]{"ABORT", "ADMIN", "AUTH", "CHECK", "CLOSE", "COMMIT",
 	"FINAL", "GET", "GET1", "HEADER", "INFO", "KEYS", "KILL", "LIBGET",
 	"LIBRARIES", "LOAD", "LOG", "NONCE", "ORDER", "OUTPUT", "QUERY",
 	"READCOUNT", "REQUEST", "REWIND", "RUN", "SESSIONID", "SIZE", "TIMESTAMP",
-	"TOKEN", "TRANSACTION", "TRANSACTIONS", "UPDATE", "WRITECOUNT"};
+	"TOKEN", "TRANSACTION", "TRANSACTIONS", "UPDATE", "WRITECOUNT", "GETN",
+	"OUTPUTS"};
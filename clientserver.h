@@ -47,7 +47,9 @@ enum class Command {
 	TRANSACTION,
 	TRANSACTIONS,
 	UPDATE,
-	WRITECOUNT
+	WRITECOUNT,
+	GETN,   // not supported by jSuneido
+	OUTPUTS // not supported by jSuneido
 };
 
 extern char* cmdnames[];
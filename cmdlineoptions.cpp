@@ -12,6 +12,7 @@
 extern int su_port;
 extern int dbserver_timeout;
 extern bool is_client;
+extern int tempindex_memory;
 
 enum {
 	PORT = AFTER_ACTIONS,
@@ -25,7 +26,10 @@ enum {
 	COMPACT_EXIT,
 	IGNORE_VERSION,
 	IGNORE_CHECK,
+	SYNC_COMMIT,
 	TIMEOUT,
+	SORT_MEMORY,
+	NO_LIBCACHE,
 	END_OF_OPTIONS
 };
 
@@ -105,6 +109,9 @@ const char* CmdLineOptions::parse(const char* str) {
 		case IGNORE_VERSION:
 			ignore_version = true;
 			break;
+		case SYNC_COMMIT:
+			sync_commit = true;
+			break;
 		case TIMEOUT: {
 			int minutes = strtol(s, &end, 10);
 			s = end;
@@ -112,6 +119,16 @@ const char* CmdLineOptions::parse(const char* str) {
 				dbserver_timeout = minutes;
 			break;
 		}
+		case SORT_MEMORY: {
+			int mb = strtol(s, &end, 10);
+			s = end;
+			if (mb > 0 && mb < 2048)
+				tempindex_memory = mb * 1024 * 1024;
+			break;
+		}
+		case NO_LIBCACHE:
+			no_libcache = true;
+			break;
 		case HELP:
 			alert("options:\n"
 				  "	-check\n"
@@ -133,7 +150,10 @@ const char* CmdLineOptions::parse(const char* str) {
 				  "	-g[arbage]c[ollection]\n"
 				  "	-i[nstall]s[ervice] [options]\n"
 				  "	-u[ninstall]s[ervice]\n"
-				  "	-t[ime]o[ut] minutes\n");
+				  "	-t[ime]o[ut] minutes\n"
+				  "	-s[ync]c[ommit]\n"
+				  "	-s[ort]m[emory] mb\n"
+				  "	-n[o]l[ib]c[ache]\n");
 			exit(EXIT_SUCCESS);
 		case END_OF_OPTIONS:
 			break;
@@ -164,6 +184,10 @@ static struct {
 	{"-ll", LOCAL_LIBRARY},
 	{"-load", LOAD},
 	{"-l", LOAD},
+	{"-synccommit", SYNC_COMMIT},
+	{"-sc", SYNC_COMMIT},
+	{"-sortmemory", SORT_MEMORY},
+	{"-sm", SORT_MEMORY},
 	{"-service", SERVICE},
 	{"-server", SERVER},
 	{"-s", SERVER},
@@ -202,6 +226,8 @@ static struct {
 	{"-ignoreversion", IGNORE_VERSION},
 	{"-iv", IGNORE_VERSION},
 	{"-ignorecheck", IGNORE_CHECK},
+	{"-nolibcache", NO_LIBCACHE},
+	{"-nlc", NO_LIBCACHE},
 	{"--", END_OF_OPTIONS},
 };
 
@@ -40,6 +40,8 @@ public:
 	bool compact_exit = false;
 	bool ignore_version = false;
 	bool ignore_check = false;
+	bool sync_commit = false;
+	bool no_libcache = false;
 
 private:
 	int get_option();
@@ -0,0 +1,541 @@
+// Copyright (c) 2000 Suneido Software Corp. All rights reserved
+// Licensed under GPLv2
+
+#include "codeopt.h"
+#include "sufunction.h"
+#include "opcodes.h"
+#include "symbols.h"
+#include "except.h"
+using std::vector;
+
+bool codeopt_enabled = true;
+
+// The code is decoded into a list of instructions,
+// transformed in place (replacing bytes or marking instructions dead)
+// and then encoded again with the jump offsets recalculated.
+// Jump targets are kept as original addresses until the end.
+// Every jump has its offset in bytes 1 and 2,
+// relative to the address of the jump plus 3.
+
+const int NONE = -1;
+
+static int varint_len(const uint8_t* p) {
+	int n = 1;
+	while (*p++ & 0x80)
+		++n;
+	return n;
+}
+
+// the size of the operand for push, call, and assignment options
+int target_len(int option, const uint8_t* p) {
+	switch (option) {
+	case AUTO:
+	case DYNAMIC:
+		return 1;
+	case GLOBAL:
+		return 2;
+	case LITERAL:
+	case MEM:
+	case MEM_SELF:
+		return varint_len(p);
+	default:
+		return 0;
+	}
+}
+
+// returns the size of the instruction at p, must match Frame::run
+int insn_len(const uint8_t* p) {
+	int op = p[0];
+	switch (op) {
+	case I_SUPER:
+	case I_PUSH_INT:
+		return 3;
+	case I_EACH:
+	case I_BLOCK_THROW:
+	case I_INC_AUTO:
+	case I_DEC_AUTO:
+		return 2;
+	case I_BLOCK:
+		return 5;
+	case I_JUMP_AUTO_INT:
+		return 7;
+	case I_JUMP_AUTO_AUTO:
+		return 6;
+	case I_TRY:
+		return 3 + varint_len(p + 3);
+	default:
+		break;
+	}
+	if (op < I_CALL_GLOBAL)
+		return 1;
+	if (op < I_CALL_MEM)
+		return 3;
+	if (op < I_PUSH)
+		return 1 + varint_len(p + 1);
+	if (op < I_PUSH_VALUE)
+		return 1 + target_len(op & 7, p + 1);
+	if (op < I_ADDEQ)
+		return 1;
+	if ((op & 0xf8) == I_CALL) {
+		// LITERAL means the function is on the stack
+		int n = op == (I_CALL | LITERAL) ? 1 : 1 + target_len(op & 7, p + 1);
+		return n + 2 + 2 * p[n + 1];
+	}
+	if ((op & 0xf8) == I_JUMP) // includes I_CATCH
+		return 3;
+	if (op < I_ADD)
+		return 1 + target_len((op - 0x80) >> 4, p + 1);
+	return 1;
+}
+
+static bool is_jump(int op) {
+	return (op & 0xf8) == I_JUMP || op == I_TRY || op == I_BLOCK ||
+		op == I_JUMP_AUTO_INT || op == I_JUMP_AUTO_AUTO;
+}
+
+static bool is_const_push(int op) {
+	return (I_PUSH_LITERAL <= op && op < I_PUSH_LITERAL + 8) ||
+		op == (I_PUSH | LITERAL) || op == I_PUSH_INT ||
+		(I_PUSH_VALUE <= op && op <= (I_PUSH_VALUE | ONE));
+}
+
+// returns the local for a push of an auto variable, else NONE
+static int push_auto(const vector<uint8_t>& insn) {
+	int op = insn[0];
+	if (I_PUSH_AUTO <= op && op < I_PUSH_AUTO + 14)
+		return op & 15;
+	if (op == (I_PUSH | AUTO))
+		return insn[1];
+	return NONE;
+}
+
+// for I_JUMP_AUTO_INT, only jumps on false so POP_YES is inverted
+static int invert(int cmp) {
+	switch (cmp) {
+	case I_LT:
+		return I_GTE;
+	case I_LTE:
+		return I_GT;
+	case I_GT:
+		return I_LTE;
+	case I_GTE:
+		return I_LT;
+	case I_IS:
+		return I_ISNT;
+	case I_ISNT:
+		return I_IS;
+	default:
+		unreachable();
+	}
+}
+
+static bool is_compare(int op) {
+	return (I_LT <= op && op <= I_GTE) || op == I_IS || op == I_ISNT;
+}
+
+const int ASSIGN_AUTO = 0x80 + (AUTO << 4);
+
+class CodeOpt {
+public:
+	CodeOpt(vector<uint8_t>& c, const vector<short>& l) : code(c), locals(l) {
+	}
+	void run(vector<Debug>& db);
+
+private:
+	struct Insn {
+		int adr;               // the original address
+		int len;               // the original size
+		vector<uint8_t> bytes; // possibly replaced
+		int target = NONE;     // the original address of the jump target
+		bool label = false;    // something jumps here
+		bool dead = false;
+	};
+
+	void decode();
+	void dead_stores();
+	void dead_pops();
+	void const_jumps();
+	void thread_jumps();
+	void inc_dec();
+	void cmp_jumps();
+	void encode(vector<Debug>& db);
+	// the next live instruction after i, or NONE
+	int next(int i) const {
+		for (++i; i < int(insns.size()); ++i)
+			if (!insns[i].dead)
+				return i;
+		return NONE;
+	}
+	// the first live instruction at or after an original address
+	int at(int adr) const {
+		int i = index[adr];
+		return i < int(insns.size()) && insns[i].dead ? next(i) : i;
+	}
+	// the next live instruction if it isn't a jump target, else NONE
+	int follow(int i) const {
+		int j = next(i);
+		return j == NONE || insns[j].label ? NONE : j;
+	}
+
+	vector<uint8_t>& code;
+	const vector<short>& locals;
+	vector<Insn> insns;
+	vector<int> index; // original address to instruction
+	bool has_try = false;
+};
+
+void codeopt(vector<uint8_t>& code, vector<Debug>& db,
+	const vector<short>& locals) {
+	CodeOpt(code, locals).run(db);
+}
+
+void CodeOpt::run(vector<Debug>& db) {
+	decode();
+	dead_stores();
+	dead_pops();
+	const_jumps();
+	// a jump out of a try clears the catcher (see Frame::run I_JUMP)
+	// so jumps are left alone if there is a try
+	if (!has_try)
+		thread_jumps();
+	inc_dec();
+	cmp_jumps();
+	encode(db);
+}
+
+void CodeOpt::decode() {
+	index.assign(code.size() + 1, NONE);
+	for (int ci = 0; ci < int(code.size());) {
+		Insn insn;
+		insn.adr = ci;
+		insn.len = insn_len(&code[ci]);
+		insn.bytes.assign(code.begin() + ci, code.begin() + ci + insn.len);
+		if (is_jump(code[ci]))
+			insn.target = ci + 3 + short(code[ci + 1] | (code[ci + 2] << 8));
+		if (code[ci] == I_TRY)
+			has_try = true;
+		index[ci] = insns.size();
+		insns.push_back(insn);
+		ci += insn.len;
+	}
+	index[code.size()] = insns.size();
+	for (int i = 0; i < int(insns.size()); ++i) {
+		Insn& insn = insns[i];
+		if (insn.target != NONE) {
+			verify(index[insn.target] != NONE);
+			if (index[insn.target] < int(insns.size()))
+				insns[index[insn.target]].label = true;
+		}
+		// block code starts after I_BLOCK
+		if (insn.bytes[0] == I_BLOCK && i + 1 < int(insns.size()))
+			insns[i + 1].label = true;
+	}
+}
+
+// stores to locals that are never read are removed
+// dynamic variables (starting with underscore) may be read by callees
+void CodeOpt::dead_stores() {
+	vector<bool> read(locals.size());
+	for (int i = 0; i < int(locals.size()); ++i)
+		read[i] = *symstr(locals[i]) == '_';
+	for (auto& insn : insns) {
+		int op = insn.bytes[0];
+		int option = (op - 0x80) >> 4;
+		if (push_auto(insn.bytes) != NONE)
+			read[push_auto(insn.bytes)] = true;
+		else if (op == (I_PUSH | DYNAMIC) || op == (I_CALL | AUTO) ||
+			op == (I_CALL | DYNAMIC))
+			read[insn.bytes[1]] = true;
+		else if (I_ADDEQ <= op && op < I_ADD &&
+			(option == AUTO || option == DYNAMIC) &&
+			op != (I_EQ | ASSIGN_AUTO))
+			read[insn.bytes[1]] = true;
+	}
+	for (auto& insn : insns) {
+		int op = insn.bytes[0];
+		if (I_EQ_AUTO <= op && op < I_EQ_AUTO_POP) {
+			if (!read[op & 7])
+				insn.dead = true; // leaves the value on the stack
+		} else if (I_EQ_AUTO_POP <= op && op < I_CALL_GLOBAL) {
+			if (!read[op & 7])
+				insn.bytes = {I_POP};
+		} else if (op == (I_EQ | ASSIGN_AUTO) && !read[insn.bytes[1]])
+			insn.dead = true;
+	}
+}
+
+// a constant pushed and immediately popped is removed
+void CodeOpt::dead_pops() {
+	for (int i = 0; i < int(insns.size()); ++i) {
+		int op = insns[i].bytes[0];
+		if (insns[i].dead || !(is_const_push(op) || op == I_DUP))
+			continue;
+		int j = follow(i);
+		if (j != NONE && insns[j].bytes[0] == I_POP)
+			insns[i].dead = insns[j].dead = true;
+	}
+}
+
+// e.g. while (true) or if (false)
+void CodeOpt::const_jumps() {
+	for (int i = 0; i < int(insns.size()); ++i) {
+		int op = insns[i].bytes[0];
+		if (insns[i].dead ||
+			(op != (I_PUSH_VALUE | TRUE) && op != (I_PUSH_VALUE | FALSE)))
+			continue;
+		int j = follow(i);
+		if (j == NONE)
+			continue;
+		int jop = insns[j].bytes[0];
+		if (jop != (I_JUMP | POP_YES) && jop != (I_JUMP | POP_NO))
+			continue;
+		insns[i].dead = true;
+		if ((op == (I_PUSH_VALUE | TRUE)) == (jop == (I_JUMP | POP_YES)))
+			insns[j].bytes[0] = I_JUMP | UNCOND;
+		else
+			insns[j].dead = true;
+	}
+}
+
+// retarget jumps whose target is another jump
+// (or for else pop jumps, a jump whose result is known)
+// jumps to a return are replaced by the return
+// and unconditional jumps to the next instruction are removed
+void CodeOpt::thread_jumps() {
+	for (int i = 0; i < int(insns.size()); ++i) {
+		Insn& insn = insns[i];
+		int op = insn.bytes[0];
+		if (insn.dead || (op & 0xf8) != I_JUMP || op == (I_JUMP | CASE_YES) ||
+			op == (I_JUMP | CASE_NO) || op == I_CATCH)
+			continue;
+		for (int n = 0; n < 10; ++n) { // limit in case of loops
+			int t = at(insn.target);
+			if (t == NONE || t == int(insns.size()))
+				break;
+			Insn& tgt = insns[t];
+			int top = tgt.bytes[0];
+			if (top == (I_JUMP | UNCOND))
+				insn.target = tgt.target;
+			else if (op == (I_JUMP | UNCOND) &&
+				(top == I_RETURN || top == I_RETURN_NIL)) {
+				insn.bytes = {uint8_t(top)};
+				insn.target = NONE;
+				break;
+			} else if (op == (I_JUMP | ELSE_POP_YES) ||
+				op == (I_JUMP | ELSE_POP_NO)) {
+				// else pop jumps leave a value that is known to be
+				// true (for yes) or false (for no)
+				bool yes = op == (I_JUMP | ELSE_POP_YES);
+				int same = I_JUMP | (yes ? POP_YES : POP_NO);
+				int opposite = I_JUMP | (yes ? POP_NO : POP_YES);
+				if (top == op)
+					insn.target = tgt.target;
+				else if (top == same) {
+					op = same;
+					insn.target = tgt.target;
+				} else if (top == opposite) {
+					op = same;
+					insn.target = tgt.adr + tgt.len;
+				} else
+					break;
+			} else
+				break;
+		}
+		if (insn.target != NONE)
+			insn.bytes[0] = op;
+		if (insn.bytes[0] == (I_JUMP | UNCOND) && at(insn.target) == next(i))
+			insn.dead = true;
+	}
+}
+
+// ++x, x++, x += 1 (and decrements) as statements
+void CodeOpt::inc_dec() {
+	for (int i = 0; i < int(insns.size()); ++i) {
+		if (insns[i].dead)
+			continue;
+		int op = insns[i].bytes[0];
+		int j = follow(i);
+		if (j == NONE)
+			continue;
+		int k = NONE;
+		int x = j;
+		if (op == (I_PUSH_VALUE | ONE)) {
+			int jop = insns[j].bytes[0];
+			if (jop == (I_ADDEQ | ASSIGN_AUTO))
+				op = I_PREINC | ASSIGN_AUTO;
+			else if (jop == (I_SUBEQ | ASSIGN_AUTO))
+				op = I_PREDEC | ASSIGN_AUTO;
+			else
+				continue;
+			k = follow(j);
+		} else {
+			k = j;
+			x = i;
+		}
+		if (k == NONE || insns[k].bytes[0] != I_POP)
+			continue;
+		int result;
+		if (op == (I_PREINC | ASSIGN_AUTO) || op == (I_POSTINC | ASSIGN_AUTO))
+			result = I_INC_AUTO;
+		else if (op == (I_PREDEC | ASSIGN_AUTO) ||
+			op == (I_POSTDEC | ASSIGN_AUTO))
+			result = I_DEC_AUTO;
+		else
+			continue;
+		uint8_t local = insns[x].bytes[1];
+		insns[i].bytes = {uint8_t(result), local};
+		insns[k].dead = true;
+		if (j != k)
+			insns[j].dead = true;
+	}
+}
+
+// push auto, push int or auto, compare, jump pop yes/no
+// e.g. while (i < n) or if (x is 0)
+void CodeOpt::cmp_jumps() {
+	for (int i = 0; i < int(insns.size()); ++i) {
+		if (insns[i].dead)
+			continue;
+		int x = push_auto(insns[i].bytes);
+		if (x == NONE)
+			continue;
+		int j = follow(i);
+		if (j == NONE)
+			continue;
+		int c = follow(j);
+		if (c == NONE || !is_compare(insns[c].bytes[0]))
+			continue;
+		int k = follow(c);
+		if (k == NONE)
+			continue;
+		int jop = insns[k].bytes[0];
+		if (jop != (I_JUMP | POP_NO) && jop != (I_JUMP | POP_YES))
+			continue;
+		int cmp = insns[c].bytes[0];
+		if (jop == (I_JUMP | POP_YES))
+			cmp = invert(cmp);
+		const vector<uint8_t>& y = insns[j].bytes;
+		vector<uint8_t> result;
+		if (push_auto(y) != NONE)
+			result = {I_JUMP_AUTO_AUTO, 0, 0, uint8_t(cmp), uint8_t(x),
+				uint8_t(push_auto(y))};
+		else if (y[0] == I_PUSH_INT)
+			result = {
+				I_JUMP_AUTO_INT, 0, 0, uint8_t(cmp), uint8_t(x), y[1], y[2]};
+		else if (y[0] == (I_PUSH_VALUE | ZERO) || y[0] == (I_PUSH_VALUE | ONE))
+			result = {I_JUMP_AUTO_INT, 0, 0, uint8_t(cmp), uint8_t(x),
+				uint8_t(y[0] == (I_PUSH_VALUE | ONE)), 0};
+		else
+			continue;
+		insns[i].bytes = result;
+		insns[i].target = insns[k].target;
+		insns[j].dead = insns[c].dead = insns[k].dead = true;
+	}
+}
+
+void CodeOpt::encode(vector<Debug>& db) {
+	// new address of each instruction
+	// dead instructions get the address of the next live one
+	vector<int> adr(insns.size() + 1);
+	int ci = 0;
+	for (int i = 0; i < int(insns.size()); ++i) {
+		adr[i] = ci;
+		if (!insns[i].dead)
+			ci += insns[i].bytes.size();
+	}
+	adr[insns.size()] = ci;
+
+	vector<uint8_t> result;
+	result.reserve(ci);
+	for (int i = 0; i < int(insns.size()); ++i) {
+		Insn& insn = insns[i];
+		if (insn.dead)
+			continue;
+		if (insn.target != NONE) {
+			int offset = adr[index[insn.target]] - (adr[i] + 3);
+			insn.bytes[1] = offset & 255;
+			insn.bytes[2] = (offset >> 8) & 255;
+		}
+		result.insert(result.end(), insn.bytes.begin(), insn.bytes.end());
+	}
+	for (auto& d : db)
+		d.ci = adr[index[d.ci]];
+	code.swap(result);
+}
+
+// tests ------------------------------------------------------------
+
+#include "testing.h"
+#include "compile.h"
+#include "ostreamstr.h"
+
+static const char* disasm(SuFunction* fn) {
+	OstreamStr out;
+	for (int ci = 0; ci < fn->nc;)
+		ci = fn->disasm1(out, ci);
+	return out.str();
+}
+
+static const char* optimized(const char* src) {
+	return disasm(force<SuFunction*>(compile(src)));
+}
+
+#define LINE "\t\t\t\t\t"
+
+TEST(codeopt) {
+	// constant condition
+	assert_streq(optimized("function () { while (true) F() }"),
+		LINE "  0  nop \n" //
+		LINE "  1  nop \n" //
+		LINE "  2  call global pop F 0\n" //
+		LINE "  5  jump 0\n" //
+		LINE "  8  nop \n" //
+		LINE "  9  return nil \n" //
+		LINE " 10  nop \n");
+
+	// dead store and pop, a is never read
+	assert_streq(optimized("function () { a = 5; b = 6; b }"),
+		LINE "  0  nop \n" //
+		LINE "  1  nop \n" //
+		LINE "  2  push int 6\n" //
+		LINE "  5  = auto pop b\n" //
+		LINE "  6  nop \n" //
+		LINE "  7  push auto b\n" //
+		LINE "  8  return \n" //
+		LINE "  9  nop \n");
+
+	// a or b jumps straight into the if
+	assert_streq(optimized("function (a, b) { if (a or b) F() }"),
+		LINE "  0  nop \n" //
+		LINE "  1  push auto a\n" //
+		LINE "  2  jump pop yes 10\n" //
+		LINE "  5  push auto b\n" //
+		LINE "  6  bool \n" //
+		LINE "  7  jump pop no 14\n" //
+		LINE " 10  nop \n" //
+		LINE " 11  call global pop F 0\n" //
+		LINE " 14  nop \n" //
+		LINE " 15  return nil \n" //
+		LINE " 16  nop \n");
+
+	// superinstructions, and the source positions must follow
+	auto fn = force<SuFunction*>(
+		compile("function () { for (i = 0; i < 8; ++i) F() }"));
+	assert_streq(disasm(fn),
+		LINE "  0  nop \n" //
+		LINE "  1  push value 0 \n" //
+		LINE "  2  = auto pop i\n" //
+		LINE "  3  jump 8\n" //
+		LINE "  6  ++ auto i\n" //
+		LINE "  8  jump no auto int i < 8 22\n" //
+		LINE " 15  nop \n" //
+		LINE " 16  call global pop F 0\n" //
+		LINE " 19  jump 6\n" //
+		LINE " 22  nop \n" //
+		LINE " 23  return nil \n" //
+		LINE " 24  nop \n");
+	assert_eq(fn->nd, 4);
+	assert_eq(fn->db[1].ci, 15);
+	assert_eq(fn->db[2].ci, 22);
+	assert_eq(fn->db[3].ci, 24);
+}
@@ -0,0 +1,30 @@
+#pragma once
+// Copyright (c) 2000 Suneido Software Corp. All rights reserved
+// Licensed under GPLv2
+
+#include <vector>
+#include <cstdint>
+
+struct Debug;
+
+// peephole optimization of the code for a compiled function
+// - folds conditional jumps on true or false
+// - threads jumps to jumps
+// - removes stores to locals that are never read
+// - removes pushes of constants that are immediately popped
+// - combines auto ++/-- and compare and jump into single instructions
+// db (the source positions) is updated to match the new code
+// locals are used to recognize dynamic variables, which are never dead
+void codeopt(std::vector<uint8_t>& code, std::vector<Debug>& db,
+	const std::vector<short>& locals);
+
+// allows tests to check the code before optimization
+extern bool codeopt_enabled;
+
+// instruction decoding, also used by libcache
+
+// the size of the operand for push, call, and assignment options
+int target_len(int option, const uint8_t* p);
+
+// the size of the instruction at p
+int insn_len(const uint8_t* p);
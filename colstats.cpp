@@ -0,0 +1,202 @@
+// Copyright (c) 2000 Suneido Software Corp. All rights reserved
+// Licensed under GPLv2
+
+#include "colstats.h"
+#include "database.h"
+#include "thedb.h"
+#include "hashmap.h"
+#include <algorithm>
+#include <cmath>
+using std::max;
+using std::min;
+
+const int NBUCKETS = 20;
+const int MAXSAMPLE = 10000; // per column
+
+ColStats::ColStats(int nr, std::vector<gcstring>& sample) : nrows(nr) {
+	std::sort(sample.begin(), sample.end());
+	int n = sample.size();
+	// count the distinct values, and the ones that occur only once
+	int d = 0;
+	int f1 = 0;
+	for (int i = 0, j; i < n; i = j) {
+		for (j = i + 1; j < n && sample[j] == sample[i]; ++j)
+			;
+		++d;
+		if (j - i == 1)
+			++f1;
+	}
+	if (n >= nr || n == 0)
+		ndistinct = d;
+	else // Guaranteed Error Estimator (Charikar et al.)
+		ndistinct = min(double(nr), sqrt(double(nr) / n) * f1 + (d - f1));
+	if (n > 0)
+		for (int i = 0; i <= NBUCKETS; ++i)
+			bounds.push_back(sample[min(n - 1, i * n / NBUCKETS)]);
+}
+
+double ColStats::eqfrac(const gcstring& value) const {
+	if (bounds.empty() || value < bounds.front() || bounds.back() < value)
+		return 0;
+	// frequent values fill one or more buckets
+	int n = 0;
+	for (int i = 0; i < NBUCKETS; ++i)
+		if (bounds[i] == value && bounds[i + 1] == value)
+			++n;
+	return n > 0 ? double(n) / NBUCKETS : 1 / max(1.0, ndistinct);
+}
+
+// buckets partly in the range are counted as half
+double ColStats::rangefrac(const gcstring& org, const gcstring& end) const {
+	if (org == end)
+		return eqfrac(org);
+	if (bounds.empty())
+		return 0;
+	double n = 0;
+	for (int i = 0; i < NBUCKETS; ++i) {
+		const gcstring& lo = bounds[i];
+		const gcstring& hi = bounds[i + 1];
+		if (end < lo || hi < org)
+			continue;
+		n += (!(lo < org) && !(end < hi)) ? 1 : .5;
+	}
+	return n / NBUCKETS;
+}
+
+// the histogram is saved as a string containing a packed record
+static gcstring pack_bounds(const std::vector<gcstring>& bounds) {
+	Record r;
+	for (auto& b : bounds)
+		r.addraw(b);
+	std::vector<char> buf(r.cursize());
+	r.copyto(buf.data());
+	return gcstring(buf.data(), buf.size());
+}
+
+static std::vector<gcstring> unpack_bounds(const gcstring& s) {
+	int n = s.size();
+	Record r(memcpy(new (noptrs) char[n], s.ptr(), n));
+	std::vector<gcstring> bounds;
+	for (int i = 0; i < r.size(); ++i) {
+		gcstring b = r.getraw(i);
+		bounds.push_back(gcstring(b.ptr(), b.size()));
+	}
+	return bounds;
+}
+
+// a simple generator since rand() may only go to 32767
+static uint32_t next_random(uint32_t& seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 1;
+}
+
+void analyze_table(const gcstring& table) {
+	Database* db = theDB();
+	if (Database::is_system_table(table))
+		except("analyze: can't analyze system table: " << table);
+	Tbl* tbl = db->ck_get_table(table);
+	db->remove_stats(table);
+	if (nil(tbl->idxs))
+		return;
+
+	Lisp<Col> cols;
+	for (Lisp<Col> c = tbl->cols; !nil(c); ++c)
+		if (c->colnum >= 0)
+			cols.push(*c);
+	int ncols = size(cols);
+	std::vector<std::vector<gcstring>> samples(ncols);
+
+	// reservoir sample of the records
+	uint32_t seed = 12345;
+	int nrows = 0;
+	Index* idx = tbl->idxs->index; // use first index
+	for (auto iter = idx->begin(schema_tran); !iter.eof(); ++iter, ++nrows) {
+		int slot =
+			nrows < MAXSAMPLE ? nrows : next_random(seed) % (nrows + 1);
+		if (slot >= MAXSAMPLE)
+			continue;
+		Record r(iter.data());
+		int i = 0;
+		for (Lisp<Col> c = cols; !nil(c); ++c, ++i) {
+			gcstring x = r.getraw(c->colnum);
+			x = gcstring(x.ptr(), x.size()); // copy out of the database
+			if (slot < int(samples[i].size()))
+				samples[i][slot] = x;
+			else
+				samples[i].push_back(x);
+		}
+	}
+
+	int i = 0;
+	for (Lisp<Col> c = cols; !nil(c); ++c, ++i) {
+		ColStats cs(nrows, samples[i]);
+		Record r;
+		r.addval(table);
+		r.addval(c->column);
+		r.addval(nrows);
+		r.addval(int(cs.ndistinct + .5));
+		r.addval(pack_bounds(cs.bounds));
+		db->add_stats(r);
+	}
+}
+
+// cached, including columns without stats (nullptr)
+// add_stats and remove_stats change schema_version which clears the cache
+const ColStats* get_stats(const gcstring& table, const gcstring& column) {
+	static HashMap<gcstring, ColStats*> cache;
+	static int version = -1;
+	if (version != Database::schema_version) {
+		cache.clear();
+		version = Database::schema_version;
+	}
+	gcstring key = table + "." + column;
+	if (ColStats** p = cache.find(key))
+		return *p;
+	ColStats* cs = nullptr;
+	Record r = theDB()->get_stats(table, column);
+	if (!nil(r))
+		cs = new ColStats(r.getint(S_NROWS), r.getint(S_DISTINCT),
+			unpack_bounds(r.getstr(S_HISTOGRAM)));
+	cache[key] = cs;
+	return cs;
+}
+
+// tests ------------------------------------------------------------
+
+#include "testing.h"
+
+static gcstring pk(int n) {
+	Record r;
+	r.addval(n);
+	return r.getraw(0);
+}
+
+TEST(colstats) {
+	// 1000 records, half of them 0, the rest 1 to 500
+	std::vector<gcstring> sample;
+	for (int i = 0; i < 500; ++i) {
+		sample.push_back(pk(0));
+		sample.push_back(pk(i + 1));
+	}
+	ColStats cs(1000, sample);
+	assert_eq(cs.ndistinct, 501);
+	assert_eq(int(cs.bounds.size()), NBUCKETS + 1);
+	verify(fabs(cs.eqfrac(pk(0)) - .5) < .06);
+	verify(cs.eqfrac(pk(7)) < .01);
+	assert_eq(cs.eqfrac(pk(999)), 0);
+	verify(fabs(cs.rangefrac(pk(1), pk(250)) - .25) < .06);
+	verify(cs.rangefrac(pk(0), pk(500)) > .95);
+
+	auto bounds = unpack_bounds(pack_bounds(cs.bounds));
+	ColStats cs2(cs.nrows, cs.ndistinct, bounds);
+	assert_eq(cs2.bounds.size(), cs.bounds.size());
+	for (int i = 0; i <= NBUCKETS; ++i)
+		assert_eq(cs2.bounds[i], cs.bounds[i]);
+
+	// sampled
+	std::vector<gcstring> sample2;
+	for (int i = 0; i < 1000; ++i)
+		sample2.push_back(pk(i % 100));
+	ColStats cs3(100000, sample2);
+	assert_eq(cs3.ndistinct, 100);
+}
@@ -0,0 +1,31 @@
+#pragma once
+// Copyright (c) 2000 Suneido Software Corp. All rights reserved
+// Licensed under GPLv2
+
+#include "gcstring.h"
+#include <vector>
+
+// per column statistics for the optimizer
+// computed by the analyze admin command and kept in the stats table
+struct ColStats {
+	// from a sample of the column's packed values, sorts the sample
+	ColStats(int nr, std::vector<gcstring>& sample);
+	ColStats(int nr, double nd, const std::vector<gcstring>& b)
+		: nrows(nr), ndistinct(nd), bounds(b) {
+	}
+	// estimated fraction of records equal to value
+	double eqfrac(const gcstring& value) const;
+	// estimated fraction of records from org to end inclusive
+	double rangefrac(const gcstring& org, const gcstring& end) const;
+
+	int nrows; // when computed
+	double ndistinct;
+	// equi-depth histogram, bucket i is from bounds[i] to bounds[i + 1]
+	std::vector<gcstring> bounds;
+};
+
+// compute and save the statistics for all the columns of a table
+void analyze_table(const gcstring& table);
+
+// returns nullptr if the column has not been analyzed
+const ColStats* get_stats(const gcstring& table, const gcstring& column);
@@ -32,6 +32,7 @@
 #include "sublock.h" // for BLOCK_REST
 #include "varint.h"
 #include "opcodes.h"
+#include "codeopt.h"
 #include "ostreamstr.h"
 
 bool getSystemOption(const char* option, bool def_value);
@@ -262,6 +263,14 @@ Value compile(const char* s, const char* gname, CodeVisitor* visitor) {
 	return x;
 }
 
+// the system options that change the code compile produces
+// so cached compiled code (LibCache) isn't used with different ones
+const char* compile_options() {
+	return getSystemOption("SwitchUnhandledThrow", true)
+		? "SwitchUnhandledThrow"
+		: "";
+}
+
 // Compiler ---------------------------------------------------------------
 
 Compiler::Compiler(const char* s, CodeVisitor* visitor)
@@ -775,6 +784,8 @@ SuFunction* FunctionCompiler::function() {
 
 	mark();
 
+	if (codeopt_enabled)
+		codeopt(code, db, locals);
 	if (code.size() > SHRT_MAX)
 		except("can't compile code larger than 32K");
 	fn->code = dup(code, noptrs);
@@ -2050,7 +2061,8 @@ short FunctionCompiler::emit(short op, short option, short target, short nargs,
 		} else if (x == SuFalse) {
 			op = I_PUSH_VALUE;
 			option = FALSE;
-		} else if (x.is_int()) {
+		} else if (x.is_int() && SHRT_MIN <= x.integer() &&
+			x.integer() <= SHRT_MAX) { // push int only has 16 bits
 			op = I_PUSH_INT;
 			target = x.integer();
 		}
@@ -2066,7 +2078,7 @@ short FunctionCompiler::emit(short op, short option, short target, short nargs,
 
 	if (op == I_PUSH) {
 		// OPTIMIZE: pushes
-		if (option == LITERAL && target < 16)
+		if (option == LITERAL && target < 8)
 			code[adr] = I_PUSH_LITERAL | target;
 		else if (option == AUTO && target < 14)
 			code[adr] = I_PUSH_AUTO | target;
@@ -3597,6 +3609,9 @@ static void process(int i, const char* code, const char* result) {
 }
 
 TEST(compile) {
+	// these check the code before optimization, see codeopt.cpp
+	Save save(codeopt_enabled);
+	codeopt_enabled = false;
 	for (int i = 0; i < sizeof cmpltests / sizeof(Cmpltest); ++i)
 		process(i, cmpltests[i].query, cmpltests[i].result);
 }
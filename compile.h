@@ -10,3 +10,6 @@ Value compile(
 	const char* s, const char* name = "", CodeVisitor* visitor = nullptr);
 
 Value constant(const char* s);
+
+// identifies the system options that affect compile
+const char* compile_options();
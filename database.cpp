@@ -7,6 +7,7 @@
 #include "recover.h"
 #include "commalist.h"
 #include <cctype>
+#include <algorithm>
 #ifdef _WIN32
 #include <io.h> // for access
 #include <process.h>
@@ -16,10 +17,14 @@
 #include "fatal.h"
 #include "checksum.h"
 #include "value.h"
-#include "fibers.h" // for yieldif for create_indexes
+#include "fibers.h" // for yieldif for create_indexes and build_index
+#include "tempruns.h"
 #include "sustring.h"
 
-const int DB_VERSION = 2; // increment for non-compatible format changes
+const int DB_VERSION = 3; // increment for non-compatible format changes
+// version 2 is still read since its Vslots index leaves are handled,
+// but it is marked as 3 when opened because new leaves are Pslots
+const int DB_VERSION_VSLOTS = 2;
 
 // Tbl ==============================================================
 
@@ -129,9 +134,12 @@ private:
 
 // Database ======================================================
 
+int Database::schema_version = 0;
+
 Database::Database(const char* file, bool createmode)
 	: tables(new Tables), clock(1), cksum(::checksum(0, nullptr, 0)),
 	  output_type(MM_DATA) {
+	++schema_version;
 	bool existed = _access(file, 0) == 0;
 	mmf = new Mmfile(file, createmode);
 	if (existed && !check_shutdown(mmf)) {
@@ -150,9 +158,11 @@ Database::Database(const char* file, bool createmode)
 		output_type = MM_DATA;
 	} else {
 		if (mmf->length(dbhdr()) < sizeof(Dbhdr) ||
-			dbhdr()->version != DB_VERSION)
+			(dbhdr()->version != DB_VERSION &&
+				dbhdr()->version != DB_VERSION_VSLOTS))
 			fatal("incompatible database\n\n"
 				  "please dump with the old exe and load with the new one");
+		dbhdr()->version = DB_VERSION; // so older exes won't open it
 		new (adr(alloc(sizeof(Session), MM_SESSION))) Session(Session::STARTUP);
 		mmf->sync();
 		open();
@@ -187,7 +197,17 @@ Dbhdr* Database::dbhdr() const {
 	return static_cast<Dbhdr*>(mmf->first());
 }
 
+// the stats table is a system table created when first needed
+// so it has a name users can't create, that can't clash with their tables
+const char* const STATS = "stats!";
+
 void Database::add_table(const gcstring& table) {
+	if (table == STATS)
+		except("add table: reserved table name: " << table);
+	add_any_table(table);
+}
+
+void Database::add_any_table(const gcstring& table) {
 	if (istable(table))
 		except("add table: table already exists: " << table);
 	int tblnum = dbhdr()->next_table++;
@@ -224,46 +244,198 @@ void Database::add_column(const gcstring& table, const gcstring& col) {
 		tbl->update();
 	}
 	tables->erase(table);
+	++schema_version;
 }
 
 void Database::add_index(const gcstring& table, const gcstring& columns,
 	bool iskey, const gcstring& fktable, const gcstring& fkcolumns,
-	Fkmode fkmode, bool unique) {
+	Fkmode fkmode, bool unique, bool (*progress)(int)) {
 	Tbl* tbl = ck_get_table(table);
 	short* colnums = comma_to_nums(tbl->cols, columns);
 	if (!colnums)
 		except("add index: nonexistent column(s): "
 			<< difference(commas_to_list(columns), get_columns(table)) << " in "
 			<< table);
-	for (Lisp<Idx> idxs = tbl->idxs; !nil(idxs); ++idxs)
-		if (idxs->columns == columns)
-			except("add index: index already exists: " << columns << " in "
-													   << table);
+	auto ck_new = [&]() {
+		for (Lisp<Idx> idxs = tbl->idxs; !nil(idxs); ++idxs)
+			if (idxs->columns == columns)
+				except("add index: index already exists: " << columns << " in "
+														   << table);
+	};
+	ck_new();
 	Index* index = new Index(this, tbl->num, columns.str(), iskey, unique);
 
-	if (!nil(tbl->idxs) && tbl->nrecords) {
-		// insert existing records
-		Index* idx = tbl->idxs->index; // use first index
-		Tbl* fktbl = get_table(fktable);
-		for (auto iter = idx->begin(schema_tran); !iter.eof(); ++iter) {
-			Record r(iter.data());
-			if (fkey_source_block(
-					schema_tran, fktbl, fkcolumns, project(r, colnums)))
-				except("add index: blocked by foreign key: "
-					<< columns << " in " << table);
-			Record key = project(r, colnums, iter->adr());
-			if (!index->insert(schema_tran, Vslot(key)))
-				except("add index: duplicate key: " << columns << " = " << key
-													<< " in " << table);
+	int snapshot = (!nil(tbl->idxs) && tbl->nrecords)
+		? transaction(READONLY)
+		: schema_tran;
+	try {
+		if (snapshot != schema_tran) {
+			build_index(snapshot, tbl, index, columns, colnums, fktable,
+				fkcolumns, progress);
+			ck_new(); // in case it was added while building
 		}
+		Record r =
+			record(tbl->num, columns, index, fktable, fkcolumns, fkmode);
+		add_any_record(schema_tran, "indexes", r);
+		tbl->idxs.append(Idx(table, r, columns, colnums, index, this));
+	} catch (...) {
+		if (snapshot != schema_tran)
+			abort(snapshot);
+		throw;
 	}
-
-	Record r = record(tbl->num, columns, index, fktable, fkcolumns, fkmode);
-	add_any_record(schema_tran, "indexes", r);
-	tbl->idxs.append(Idx(table, r, columns, colnums, index, this));
+	// ended after the index is added, so finalizing the records deleted
+	// since the snapshot will remove them from it
+	if (snapshot != schema_tran)
+		verify(commit(snapshot));
+	if (progress)
+		progress(100);
 
 	if (fktable != "")
 		tables->erase(fktable); // update target
+	++schema_version;
+}
+
+// the keys for building an index, sorted in memory up to tempindex_memory
+// and then as runs in a temporary file
+class IndexKeys {
+public:
+	~IndexKeys() {
+		if (runs)
+			runs->close();
+	}
+	void add(Record key) {
+		keys.push_back(key);
+		mem += key.cursize();
+		if (mem > tempindex_memory)
+			spill();
+	}
+	// bulk load the keys into an empty index
+	// returns a duplicate key if there is one
+	Record load(Index* index) {
+		if (!runs)
+			return index->load(keys);
+		spill();
+		return index->load(*runs);
+	}
+
+private:
+	void spill() {
+		if (!runs)
+			runs = new TempRuns;
+		std::sort(keys.begin(), keys.end());
+		for (auto& key : keys)
+			runs->add(key, Records());
+		runs->end_run();
+		keys.clear();
+		mem = 0;
+	}
+
+	std::vector<Record> keys;
+	TempRuns* runs = nullptr;
+	int64_t mem = 0;
+};
+
+Database::LoadKeys::~LoadKeys() {
+	for (auto& k : idxs)
+		if (k.runs)
+			k.runs->close();
+}
+
+bool Database::LoadKeys::has(int i, Record key) {
+	if (i >= int(idxs.size()))
+		return false;
+	Keys& k = idxs[i];
+	if (k.mem.count(key))
+		return true;
+	if (!k.runs)
+		return false;
+	k.runs->seek(key);
+	return !k.runs->eof() && k.runs->key() == key;
+}
+
+void Database::LoadKeys::add(int i, Record key) {
+	if (i >= int(idxs.size()))
+		idxs.resize(i + 1);
+	Keys& k = idxs[i];
+	k.mem.insert(key);
+	k.size += key.cursize();
+	if (k.size > tempindex_memory) {
+		if (!k.runs)
+			k.runs = new TempRuns;
+		for (auto& x : k.mem)
+			k.runs->add(x, Records());
+		k.runs->end_run();
+		k.mem.clear();
+		k.size = 0;
+	}
+}
+
+// fill a new index with the existing records of a table
+// without stopping other fibers for the whole time
+// the keys are collected from a snapshot (a readonly transaction)
+// yielding as it goes, and then bulk loaded
+// records created or deleted since the snapshot are still in the other
+// indexes, so they are then inserted, without yielding,
+// so the caller can add the index before anything else changes
+// the snapshot prevents their transactions from being finalized meanwhile
+// system tables are updated by schema_tran which isn't versioned,
+// so they are done without yielding
+void Database::build_index(int t, Tbl* tbl, Index* index,
+	const gcstring& columns, short* colnums, const gcstring& fktable,
+	const gcstring& fkcolumns, bool (*progress)(int)) {
+	bool online = !is_system_table(tbl->name);
+	Tbl* fktbl = get_table(fktable);
+	auto getkey = [&](Mmoffset adr) {
+		Record r(input(adr));
+		if (fkey_source_block(
+				schema_tran, fktbl, fkcolumns, project(r, colnums)))
+			except("add index: blocked by foreign key: " << columns << " in "
+														 << tbl->name);
+		return project(r, colnums, adr);
+	};
+	IndexKeys keys;
+	int nrecs = tbl->nrecords;
+	int n = 0;
+	int pct = 0;
+	Index* idx = tbl->idxs->index; // use first index
+	for (auto iter = idx->begin(t); !iter.eof(); ++iter) {
+		keys.add(getkey(iter->adr()));
+		if (progress) {
+			int p = std::min(int(++n * 100LL / nrecs), 99);
+			if (p > pct && !progress(pct = p))
+				except("add index: cancelled: " << columns << " in "
+												<< tbl->name);
+		}
+		if (online) {
+			Fibers::yieldif();
+			if (get_table(tbl->num) != tbl)
+				except("add index: table changed while adding: "
+					<< columns << " in " << tbl->name);
+			fktbl = get_table(fktable);
+		}
+	}
+	Record dup = keys.load(index);
+	if (!nil(dup))
+		except("add index: duplicate key: " << columns << " = " << dup
+											<< " in " << tbl->name);
+
+	// catch up
+	TranTime asof = tran_asof(t);
+	auto catchup = [&](const Transaction& tr) {
+		for (auto& act : tr.acts)
+			// a record that is created and deleted is done by its create
+			if (act.tblnum == tbl->num && !visible(t, asof, act.off) &&
+				(act.type == CREATE_ACT || !created.find(act.off))) {
+				Record key = getkey(act.off);
+				if (!index->insert(schema_tran, Vslot(key)))
+					except("add index: duplicate key: "
+						<< columns << " = " << key << " in " << tbl->name);
+			}
+	};
+	for (auto& tr : trans)
+		catchup(tr.second);
+	for (auto& tr : final)
+		catchup(tr);
 }
 
 bool Database::recover_index(Record& idxrec) {
@@ -299,6 +471,7 @@ bool Database::recover_index(Record& idxrec) {
 
 void Database::invalidate_table(TblNum tblnum) {
 	tables->erase(tblnum);
+	++schema_version;
 }
 
 void Database::add_view(const gcstring& table, const gcstring& definition) {
@@ -306,6 +479,7 @@ void Database::add_view(const gcstring& table, const gcstring& definition) {
 	r.addval(table);
 	r.addval(definition);
 	add_any_record(schema_tran, "views", r);
+	++schema_version;
 }
 
 void Database::add_record(int tran, const gcstring& table, Record r) {
@@ -331,6 +505,7 @@ void Database::add_any_record(int tran, Tbl* tbl, Record& r) {
 	if (tran != schema_tran && ck_get_tran(tran)->type != READWRITE)
 		except("can't output from read-only transaction to " << tbl->name);
 	verify(tbl);
+	ck_not_loading(tbl);
 	verify(!nil(tbl->idxs));
 
 	if (!loading)
@@ -358,6 +533,94 @@ void Database::add_any_record(int tran, Tbl* tbl, Record& r) {
 	}
 }
 
+void Database::add_records(
+	int tran, const gcstring& table, const Lisp<Record>& recs) {
+	if (is_system_table(table))
+		except("add records: can't add records to system table: " << table);
+	add_any_records(tran, ck_get_table(table), recs);
+}
+
+// adds many records to one table
+// the same as add_any_record for each one, except that
+// foreign keys are checked, and keys are inserted into each index,
+// in sorted order, and the table and index info is updated once
+// so either all of them are added or none are.
+// If the table has a user trigger the records are added one at a time
+// with add_any_record, so the trigger sees the same as with separate
+// outputs, and a failure leaves the earlier records added.
+void Database::add_any_records(
+	int tran, Tbl* tbl, const Lisp<Record>& recs) {
+	if (ck_get_tran(tran)->type != READWRITE)
+		except("can't output from read-only transaction to " << tbl->name);
+	verify(tbl);
+	verify(!nil(tbl->idxs));
+	ck_not_loading(tbl);
+
+	std::vector<Record> rs;
+	for (Lisp<Record> r = recs; !nil(r); ++r) {
+		if (tbl->num > TN_VIEWS && r->size() > tbl->nextfield)
+			except("output: record has more fields ("
+				<< r->size() << ") than " << tbl->name << " should ("
+				<< tbl->nextfield << ")");
+		rs.push_back(*r);
+	}
+	if (rs.empty())
+		return;
+	if (!loading && tbl->has_user_trigger()) {
+		for (auto& r : rs)
+			add_any_record(tran, tbl, r);
+		return;
+	}
+	std::vector<Record> keys;
+	keys.reserve(rs.size());
+
+	if (!loading)
+		for (Lisp<Idx> i = tbl->idxs; !nil(i); ++i) {
+			if (i->fksrc.table == "")
+				continue;
+			keys.clear();
+			for (auto& r : rs)
+				keys.push_back(project(r, i->colnums));
+			std::sort(keys.begin(), keys.end());
+			Tbl* fktbl = get_table(i->fksrc.table);
+			for (size_t k = 0; k < keys.size(); ++k)
+				if ((k == 0 || keys[k] != keys[k - 1]) &&
+					fkey_source_block(tran, fktbl, i->fksrc.columns, keys[k]))
+					except("add record: blocked by foreign key: "
+						<< i->fksrc.columns << " in " << tbl->name);
+		}
+
+	for (auto& r : rs)
+		output(tbl->num, r);
+	for (Lisp<Idx> i = tbl->idxs; !nil(i); ++i) {
+		keys.clear();
+		for (auto& r : rs)
+			keys.push_back(project(r, i->colnums, r.off()));
+		std::sort(keys.begin(), keys.end());
+		for (size_t k = 0; k < keys.size(); ++k)
+			// handle insert failing due to duplicate key
+			if (!i->index->insert(tran, Vslot(keys[k]))) {
+				// delete from this and previous indexes
+				for (size_t j = 0; j < k; ++j)
+					verify(i->index->erase(keys[j]));
+				for (Lisp<Idx> j = tbl->idxs; j->index != i->index; ++j)
+					for (auto& r : rs) {
+						Record key2 = project(r, j->colnums, r.off());
+						verify(j->index->erase(key2));
+					}
+				except("duplicate key: " << i->columns << " = " << keys[k]
+										 << " in " << tbl->name);
+			}
+		i->update(); // update indexes record from index
+	}
+	for (auto& r : rs) {
+		create_act(tran, tbl->num, r.off());
+		++tbl->nrecords;
+		tbl->totalsize += r.cursize();
+	}
+	tbl->update(); // update tables record
+}
+
 void Database::add_index_entries(int tran, Tbl* tbl, Record r) {
 	Mmoffset off = r.off();
 	for (Lisp<Idx> i = tbl->idxs; !nil(i); ++i) {
@@ -407,7 +670,7 @@ bool Database::fkey_source_block(
 	return false;
 }
 
-// for use by dbcopy only - does NOT update indexes
+// for use by dbcopy and load only - does NOT update indexes
 Mmoffset Database::output_record(int tran, Tbl* tbl, Record& rec) {
 	Mmoffset off = output(tbl->num, rec);
 	++tbl->nrecords;
@@ -417,7 +680,8 @@ Mmoffset Database::output_record(int tran, Tbl* tbl, Record& rec) {
 	return off;
 }
 
-// for use by dbcopy only
+// for use by dbcopy and load only
+// builds the (empty) indexes bottom up from the sorted keys
 void Database::create_indexes(Tbl* tbl, Mmoffset first, Mmoffset last) {
 	if (!tbl->nrecords)
 		return;
@@ -425,27 +689,79 @@ void Database::create_indexes(Tbl* tbl, Mmoffset first, Mmoffset last) {
 	first -= sizeof(int);
 	Mmfile::iterator end(mmf->end());
 	for (Lisp<Idx> ix = tbl->idxs; !nil(ix); ++ix) {
+		IndexKeys keys;
 		int n = 0;
 		for (Mmfile::iterator iter(first, mmf); iter != end; ++iter) {
-			if (iter.type() == MM_COMMIT)
-				continue;
 			Fibers::yieldif();
-			verify(iter.type() == MM_DATA);
+			// other fibers may have written meanwhile
+			// e.g. other tables' records and index nodes, and commits
+			if (iter.type() != MM_DATA || *(int*) *iter != tbl->num)
+				continue;
 			Mmoffset off = iter.offset() + sizeof(int);
 			Record r(mmf, off);
-			Record key = project(r, ix->colnums, off);
-			if (!ix->index->insert(schema_tran, Vslot(key)))
-				except("duplicate  " << ix->columns << " = " << key << " in "
-									 << tbl->name);
+			keys.add(project(r, ix->colnums, off));
 			++n;
 			if (off == last)
 				break;
 		}
 		verify(n == tbl->nrecords);
+		Record dup = keys.load(ix->index);
+		if (!nil(dup))
+			except("duplicate  " << ix->columns << " = " << dup << " in "
+								 << tbl->name);
 		ix->update();
 	}
 }
 
+// for use by load only
+// checks what add_any_record would, before output_record
+// so a bad record can be skipped instead of failing create_indexes
+// keys are the key and unique index entries loaded so far
+void Database::load_check(int tran, Tbl* tbl, Record rec, LoadKeys& keys) {
+	Lisp<Idx> i;
+	for (i = tbl->idxs; !nil(i); ++i) {
+		if (i->fksrc.table == "" || i->fksrc.table == tbl->name)
+			continue; // self references may be loaded in any order
+		Tbl* fktbl = get_table(i->fksrc.table);
+		if (!fktbl)
+			continue; // not loaded yet when loading a whole database
+		if (fkey_source_block(
+				tran, fktbl, i->fksrc.columns, project(rec, i->colnums)))
+			except("add record: blocked by foreign key: "
+				<< i->fksrc.columns << " in " << tbl->name);
+	}
+	std::vector<std::pair<int, Record>> newkeys;
+	int n = 0;
+	for (i = tbl->idxs; !nil(i); ++i, ++n) {
+		if (!i->iskey && !i->index->is_unique())
+			continue;
+		Record key = project(rec, i->colnums);
+		if (!i->iskey && key_empty(key))
+			continue;
+		if (keys.has(n, key))
+			except("duplicate key: " << i->columns << " = " << key << " in "
+									 << tbl->name);
+		newkeys.emplace_back(n, key);
+	}
+	for (auto& k : newkeys)
+		keys.add(k.first, k.second);
+}
+
+// other transactions can't write to a table while load outputs its records
+// and builds its indexes, create_indexes requires the indexes to be empty
+void Database::begin_load(TblNum tblnum) {
+	loading_tbls.insert(tblnum);
+}
+
+void Database::end_load(TblNum tblnum) {
+	loading_tbls.erase(tblnum);
+}
+
+void Database::ck_not_loading(Tbl* tbl) {
+	if (loading_tbls.count(tbl->num))
+		except("can't update " << tbl->name << " while it is being loaded");
+}
+
 void Database::update_record(int tran, const gcstring& table,
 	const gcstring& index, Record key, Record newrec) {
 	update_any_record(tran, table, index, key, newrec);
@@ -473,6 +789,7 @@ Mmoffset Database::update_record(
 		if (is_system_table(tbl->name))
 			except("can't update records in system table: " << tbl->name);
 	}
+	ck_not_loading(tbl);
 
 	if (tbl->num > TN_VIEWS && newrec.size() > tbl->nextfield)
 		except("update: record has more fields (" << newrec.size() << ") than "
@@ -544,6 +861,7 @@ Mmoffset Database::update_record(
 void Database::remove_table(const gcstring& table) {
 	if (is_system_table(table))
 		except("drop: can't destroy system table: " << table);
+	remove_stats(table);
 	remove_any_table(table);
 }
 
@@ -559,13 +877,14 @@ void Database::remove_any_table(const gcstring& table) {
 		remove_column(table, q->column);
 
 	tables->erase(table);
+	++schema_version;
 
 	remove_any_record(schema_tran, "tables", "tablename", key(table));
 }
 
 bool Database::is_system_table(const gcstring& table) {
 	return table == "tables" || table == "columns" || table == "indexes" ||
-		table == "views";
+		table == "views" || table == STATS;
 }
 
 bool Database::is_system_column(const gcstring& table, const gcstring& column) {
@@ -611,6 +930,7 @@ void Database::remove_column(const gcstring& table, const gcstring& column) {
 		except(
 			"delete column: nonexistent column: " << column << " in " << table);
 	tbl->cols.erase(*q);
+	++schema_version;
 
 	remove_any_record(
 		schema_tran, "columns", "table,column", key(tbl->num, column));
@@ -638,6 +958,7 @@ void Database::remove_any_index(Tbl* tbl, const gcstring& columns) {
 		except("delete index: nonexistent index: " //
 			<< columns << " in " << tbl->name);
 	tbl->idxs.erase(*p);
+	++schema_version;
 
 	remove_any_record(
 		schema_tran, "indexes", "table,columns", key(tbl->num, columns));
@@ -677,6 +998,7 @@ void Database::remove_record(int tran, Tbl* tbl, Record r) {
 	}
 	verify(tbl);
 	verify(!nil(r));
+	ck_not_loading(tbl);
 
 	if (auto fktblname = fkey_target_block(tran, tbl, r))
 		except("delete record from "
@@ -1100,6 +1422,7 @@ Tbl* Database::get_table(Record table_rec) {
 	// have to do this before indexes since they may need it
 	Tbl* tbl = new Tbl(table_rec, cols, Lisp<Idx>());
 	tables->add(tbl);
+	final_keys.erase(tbl->num); // columns may have changed
 
 	// indexes
 	Lisp<Idx> idxs;
@@ -1143,6 +1466,61 @@ gcstring Database::get_view(const gcstring& table) {
 
 void Database::remove_view(const gcstring& table) {
 	remove_any_record(schema_tran, "views", "view_name", key(table));
+	++schema_version;
+}
+
+// the stats table is created when first needed
+// so existing databases don't require conversion
+void Database::add_stats(Record r) {
+	if (!istable(STATS)) {
+		add_any_table(STATS);
+		add_column(STATS, "stats_table");
+		add_column(STATS, "stats_column");
+		add_column(STATS, "stats_nrows");
+		add_column(STATS, "stats_distinct");
+		add_column(STATS, "stats_histogram");
+		add_index(STATS, "stats_table,stats_column", true);
+	}
+	add_any_record(schema_tran, STATS, r);
+	++schema_version;
+}
+
+Record Database::get_stats(const gcstring& table, const gcstring& column) {
+	Index* idx = get_index(STATS, "stats_table,stats_column");
+	return find(schema_tran, idx, ::key(table, column));
+}
+
+void Database::remove_stats(const gcstring& table) {
+	Index* idx = get_index(STATS, "stats_table,stats_column");
+	if (!idx)
+		return;
+	Lisp<gcstring> cols;
+	for (auto iter = idx->begin(schema_tran, key(table)); !iter.eof(); ++iter)
+		cols.push(Record(iter.data()).getstr(S_COLUMN));
+	for (; !nil(cols); ++cols)
+		remove_any_record(schema_tran, STATS, "stats_table,stats_column",
+			::key(table, *cols));
+	++schema_version;
+}
+
+// stats are keyed by table name so they have to move with the table
+void Database::rename_stats(const gcstring& oldname, const gcstring& newname) {
+	Index* idx = get_index(STATS, "stats_table,stats_column");
+	if (!idx)
+		return;
+	Lisp<Record> recs;
+	for (auto iter = idx->begin(schema_tran, key(oldname)); !iter.eof();
+		 ++iter)
+		recs.push(Record(iter.data()));
+	for (; !nil(recs); ++recs) {
+		Record r;
+		r.addval(newname);
+		for (int i = S_COLUMN; i < recs->size(); ++i)
+			r.addraw(recs->getraw(i));
+		update_any_record(schema_tran, STATS, "stats_table,stats_column",
+			::key(oldname, recs->getstr(S_COLUMN)), r);
+	}
+	++schema_version;
 }
 
 Index* Database::get_index(Tbl* tbl, const gcstring& columns) {
@@ -1230,6 +1608,8 @@ bool Database::rename_table(const gcstring& oldname, const gcstring& newname) {
 		except("rename table: can't rename system table: " << oldname);
 	if (istable(newname))
 		except("rename table: table already exists: " << newname);
+	if (newname == STATS)
+		except("rename table: reserved table name: " << newname);
 
 	update_any_record(schema_tran, "tables", "table", key(tbl->num),
 		record(
@@ -1237,6 +1617,8 @@ bool Database::rename_table(const gcstring& oldname, const gcstring& newname) {
 
 	tables->erase(
 		oldname); // Note: table will be reloaded into tables on next use
+	rename_stats(oldname, newname);
+	++schema_version;
 
 	return true;
 }
@@ -1289,6 +1671,7 @@ bool Database::rename_column(
 
 	tables->erase(
 		table); // Note: table will be reloaded into tables on next use
+	++schema_version;
 	return true;
 }
 
@@ -1324,6 +1707,7 @@ Record Database::get_record(
 #include "testing.h"
 #include "tempdb.h"
 #include "btree.h"
+#include "ostreamstr.h"
 
 static void assertreceq(Record r1, Record r2) {
 	if (r1.size() != r2.size())
@@ -1440,6 +1824,226 @@ TEST(database) {
 	END
 }
 
+static int index_size(const char* table, const char* columns) {
+	int n = 0;
+	Index* index = thedb->get_index(table, columns);
+	for (auto iter = index->begin(schema_tran); !iter.eof(); ++iter)
+		++n;
+	return n;
+}
+static int nprogress = 0;
+static bool count_progress(int) {
+	++nprogress;
+	return true;
+}
+static bool cancel_progress(int pct) {
+	return pct < 50;
+}
+
+TEST(database_add_index_online) {
+	BEGIN
+
+	const char* table = "test_database";
+	thedb->add_table(table);
+	thedb->add_column(table, "name");
+	thedb->add_column(table, "phone");
+	thedb->add_column(table, "num");
+	thedb->add_index(table, "num", true);
+	int tran = thedb->transaction(READWRITE);
+	for (int i = 0; i < 100; ++i)
+		thedb->add_record(tran, table, record("x", i % 2 ? "odd" : "even", i));
+	verify(thedb->commit(tran));
+
+	// a delete that is committed, but not finalized because of old
+	int old = thedb->transaction(READONLY);
+	tran = thedb->transaction(READWRITE);
+	thedb->remove_record(tran, table, "num", key(1));
+	verify(thedb->commit(tran));
+	// an uncommitted create
+	tran = thedb->transaction(READWRITE);
+	thedb->add_record(tran, table, record("x", "new", 100));
+
+	// small enough to sort in runs
+	int memory = tempindex_memory;
+	tempindex_memory = 1000;
+	nprogress = 0;
+	thedb->add_index(
+		table, "phone", false, "", "", BLOCK, false, count_progress);
+	tempindex_memory = memory;
+	verify(nprogress > 0);
+	// both still have the deleted record and have the uncommitted one
+	assert_eq(index_size(table, "num"), 101);
+	assert_eq(index_size(table, "phone"), 101);
+
+	xassert(thedb->add_index(
+		table, "name", false, "", "", BLOCK, false, cancel_progress));
+	verify(!thedb->get_index(table, "name"));
+
+	verify(thedb->commit(tran));
+	verify(thedb->commit(old));
+	assert_eq(index_size(table, "num"), 100);
+	assert_eq(index_size(table, "phone"), 100);
+
+	xassert(thedb->add_index(table, "name", true)); // duplicate keys
+
+	END
+}
+
+TEST(database_add_records) {
+	BEGIN
+
+	const char* table = "test_database";
+	thedb->add_table(table);
+	thedb->add_column(table, "name");
+	thedb->add_column(table, "phone");
+	thedb->add_column(table, "num");
+	thedb->add_index(table, "num", true);
+	thedb->add_index(table, "name", true);
+
+	Record records[] = {record("bob", "123-4444", 3),
+		record("andy", "242-0707", 1), record("joe", "652-9876", 2)};
+	int tran = thedb->transaction(READWRITE);
+	thedb->add_records(
+		tran, table, lisp(records[0], records[1], records[2]));
+	// duplicate in the second index, so none are added
+	xassert(thedb->add_records(tran, table,
+		lisp(record("sue", "", 4), record("andy", "", 5))));
+	// duplicate within the batch
+	xassert(thedb->add_records(tran, table,
+		lisp(record("ann", "", 6), record("tom", "", 6))));
+	verify(thedb->commit(tran));
+
+	assert_eq(thedb->nrecords(table), 3);
+	assert_eq(index_size(table, "num"), 3);
+	assert_eq(index_size(table, "name"), 3);
+	tran = thedb->transaction(READONLY);
+	Index* index = thedb->get_index(table, "num");
+	int i = 0;
+	for (auto iter = index->begin(tran); !iter.eof(); ++iter, ++i)
+		assertreceq(records[(i + 1) % 3], Record(iter.data()));
+	assert_eq(i, 3);
+	verify(thedb->commit(tran));
+
+	END
+}
+
+TEST(database_load) {
+	BEGIN
+
+	const char* table = "test_database";
+	thedb->add_table(table);
+	thedb->add_column(table, "name");
+	thedb->add_column(table, "phone");
+	thedb->add_column(table, "num");
+	thedb->add_index(table, "num", true);
+	thedb->add_index(table, "name", false, "", "", BLOCK, true); // unique
+	Tbl* tbl = thedb->ck_get_table(table);
+
+	thedb->begin_load(tbl->num);
+	Record records[] = {record("bob", "123-4444", 3), record("", "", 1),
+		record("", "", 4), record("sue", "", 3), record("bob", "", 5),
+		record("joe", "652-9876", 2)};
+	Database::LoadKeys keys;
+	Mmoffset first = 0;
+	Mmoffset last = 0;
+	int nloaded = 0;
+	int tran = thedb->transaction(READWRITE);
+	for (auto& r : records) {
+		try {
+			thedb->load_check(tran, tbl, r, keys);
+		} catch (...) {
+			continue; // duplicate key, skipped
+		}
+		last = thedb->output_record(tran, tbl, r);
+		if (!first)
+			first = last;
+		++nloaded;
+	}
+	assert_eq(nloaded, 4); // empty names aren't duplicates
+	verify(thedb->commit(tran));
+
+	// other writers are blocked until the indexes are built
+	tran = thedb->transaction(READWRITE);
+	xassert(thedb->add_record(tran, table, record("ann", "", 6)));
+	thedb->create_indexes(tbl, first, last);
+	thedb->end_load(tbl->num);
+	thedb->add_record(tran, table, record("ann", "", 6));
+	verify(thedb->commit(tran));
+
+	assert_eq(thedb->nrecords(table), 5);
+	assert_eq(index_size(table, "num"), 5);
+	assert_eq(index_size(table, "name"), 5);
+
+	END
+}
+
+TEST(database_load_interleaved) {
+	BEGIN
+
+	const char* table = "test_database";
+	thedb->add_table(table);
+	thedb->add_column(table, "name");
+	thedb->add_column(table, "phone");
+	thedb->add_column(table, "num");
+	thedb->add_index(table, "num", true);
+	thedb->add_index(table, "phone", false);
+	const char* other = "test_other";
+	thedb->add_table(other);
+	thedb->add_column(other, "name");
+	thedb->add_column(other, "phone");
+	thedb->add_column(other, "num");
+	thedb->add_index(other, "num", true);
+	thedb->add_index(other, "name", false);
+	Tbl* tbl = thedb->ck_get_table(table);
+
+	// small enough that the loaded keys spill to runs
+	int memory = tempindex_memory;
+	tempindex_memory = 1000;
+	thedb->begin_load(tbl->num);
+	Database::LoadKeys keys;
+	Mmoffset first = 0;
+	Mmoffset last = 0;
+	int nloaded = 0;
+	int tran = thedb->transaction(READWRITE);
+	for (int i = 0; i < 500; ++i) {
+		Record r = record("x", "", i % 400); // the last 100 are duplicates
+		try {
+			thedb->load_check(tran, tbl, r, keys);
+		} catch (...) {
+			continue;
+		}
+		last = thedb->output_record(tran, tbl, r);
+		if (!first)
+			first = last;
+		++nloaded;
+		if (i % 10 == 9) {
+			verify(thedb->commit(tran));
+			// as if another fiber wrote to another table meanwhile
+			// adding records, index nodes, and commits
+			int t = thedb->transaction(READWRITE);
+			for (int j = 0; j < 10; ++j) {
+				OstreamStr os;
+				os << (i * 10 + j) << " a name long enough to split nodes";
+				thedb->add_record(t, other, record(os.str(), "", i * 10 + j));
+			}
+			verify(thedb->commit(t));
+			tran = thedb->transaction(READWRITE);
+		}
+	}
+	verify(thedb->commit(tran));
+	thedb->create_indexes(tbl, first, last);
+	thedb->end_load(tbl->num);
+	tempindex_memory = memory;
+
+	assert_eq(nloaded, 400);
+	assert_eq(thedb->nrecords(table), 400);
+	assert_eq(index_size(table, "num"), 400);
+	assert_eq(index_size(table, "phone"), 400);
+	assert_eq(index_size(other, "name"), 500);
+
+	END
+}
+
 TEST(database_rules) {
 	BEGIN
 
@@ -48,6 +48,9 @@ enum {
 // views records fields
 enum { V_NAME, V_DEFINITION };
 
+// stats records fields, see colstats.h
+enum { S_TABLE, S_COLUMN, S_NROWS, S_DISTINCT, S_HISTOGRAM };
+
 typedef int TblNum;
 
 // ReSharper disable once CppImplicitDefaultConstructorNotAvailable
@@ -109,6 +112,7 @@ struct Tbl {
 	Lisp<gcstring> get_fields();
 	bool singleton();
 	void user_trigger(int tran, Record oldrec, Record newrec);
+	bool has_user_trigger();
 
 	Record rec;
 	Lisp<Col> cols;
@@ -154,6 +158,29 @@ struct TranDelete {
 	TranTime time = 0;
 };
 
+// counts of the record addresses in created and deleted, by hash,
+// so visible can skip looking up records that are in neither
+// a count of zero means neither has the address
+class VersionFilter {
+public:
+	void add(Mmoffset off) {
+		++counts[slot(off)];
+	}
+	void remove(Mmoffset off) {
+		verify(counts[slot(off)]-- > 0);
+	}
+	bool has(Mmoffset off) const {
+		return counts[slot(off)] != 0;
+	}
+
+private:
+	enum { BITS = 14 };
+	static int slot(Mmoffset off) {
+		return (uint32_t(mmoffset_to_int(off)) * 2654435761u) >> (32 - BITS);
+	}
+	uint32_t counts[1 << BITS] = {};
+};
+
 class Transaction {
 public:
 	Transaction() = default; // need for trans map
@@ -180,6 +207,18 @@ inline bool operator<(TranTime time, const Transaction& tran) {
 	return time < tran.asof;
 }
 
+// keys written by finalized transactions, per table index
+// so validate_reads can probe a range instead of scanning every act
+struct FinalKey {
+	const Transaction* tran;
+	ActType type;
+};
+
+struct FinalIdx {
+	short* colnums = nullptr;
+	std::multimap<Record, FinalKey> keys;
+};
+
 #define DBCREATE true
 
 struct Dbhdr;
@@ -212,12 +251,17 @@ public:
 	Lisp<int> tranlist();
 	int final_size() const;
 	bool visible(int tran, Mmoffset adr);
+	// for checking many records, asof is from tran_asof
+	bool visible(int tran, TranTime asof, Mmoffset adr);
+	TranTime tran_asof(int tran);
 
 	void add_table(const gcstring& table);
 	void add_column(const gcstring& table, const gcstring& column);
+	// progress is given a percentage and can return false to cancel
 	void add_index(const gcstring& table, const gcstring& columns, bool key,
 		const gcstring& fktable = "", const gcstring& fkcolumns = "",
-		Fkmode fkmode = BLOCK, bool unique = false);
+		Fkmode fkmode = BLOCK, bool unique = false,
+		bool (*progress)(int) = nullptr);
 	void add_view(const gcstring& table, const gcstring& definition);
 
 	void add_record(int tran, const gcstring& table, Record r);
@@ -225,6 +269,9 @@ public:
 		add_any_record(tran, ck_get_table(table), r);
 	}
 	void add_any_record(int tran, Tbl* tbl, Record& r);
+	void add_records(
+		int tran, const gcstring& table, const Lisp<Record>& recs);
+	void add_any_records(int tran, Tbl* tbl, const Lisp<Record>& recs);
 	void update_record(int tran, const gcstring& table, const gcstring& index,
 		Record key, Record newrec);
 	Mmoffset update_record(
@@ -241,6 +288,10 @@ public:
 	void remove_any_record(
 		int tran, const gcstring& table, const gcstring& index, Record key);
 	void remove_view(const gcstring& table);
+	void add_stats(Record r);
+	Record get_stats(const gcstring& table, const gcstring& column);
+	void remove_stats(const gcstring& table);
+	void rename_stats(const gcstring& oldname, const gcstring& newname);
 
 	bool istable(const gcstring& table) {
 		return get_table(table) != 0;
@@ -290,10 +341,31 @@ public:
 		return mmf->adr(offset);
 	}
 
-	// for use by dbcopy only
+	// for use by dbcopy and load only
 	Mmoffset output_record(int tran, Tbl* tbl, Record& rec);
 	void create_indexes(Tbl* tbl, Mmoffset first, Mmoffset last);
 
+	// for use by load only
+	// the key and unique index entries loaded so far, per index
+	// in memory up to tempindex_memory and then as runs in a temporary file
+	class LoadKeys {
+	public:
+		~LoadKeys();
+		bool has(int i, Record key);
+		void add(int i, Record key);
+
+	private:
+		struct Keys {
+			std::set<Record> mem;
+			int64_t size = 0;
+			TempRuns* runs = nullptr;
+		};
+		std::vector<Keys> idxs;
+	};
+	void load_check(int tran, Tbl* tbl, Record rec, LoadKeys& keys);
+	void begin_load(TblNum tblnum);
+	void end_load(TblNum tblnum);
+
 	// for tests
 	bool final_empty() const {
 		return final.empty();
@@ -304,18 +376,27 @@ public:
 
 	Mmfile* mmf;
 	bool loading = false;
+	bool sync_commit = false; // commit waits for its data to be flushed
+	// incremented by schema changes, used to invalidate cached query plans
+	static int schema_version;
 
 private:
 	void open();
 	void create();
+	void wait_flushed();
+	void add_any_table(const gcstring& table);
 	Tbl* get_table(Record table_rec);
 	Index* get_index(Tbl* tbl, const gcstring& columns);
 	void remove_record(int tran, Tbl* tbl, Record r);
 	void remove_index_entries(Tbl* tbl, Record r);
+	void ck_not_loading(Tbl* tbl);
 	void remove_any_index(const gcstring& table, const gcstring& columns) {
 		remove_any_index(ck_get_table(table), columns);
 	}
 	void remove_any_index(Tbl* tbl, const gcstring& columns);
+	void build_index(int snapshot, Tbl* tbl, Index* index,
+		const gcstring& columns, short* colnums, const gcstring& fktable,
+		const gcstring& fkcolumns, bool (*progress)(int));
 	static Record record(TblNum tblnum, const gcstring& column, int field);
 	static Record record(TblNum tblnum, const gcstring& columns, Index* index,
 		const gcstring& fktable = "", const gcstring& fkcolumns = "",
@@ -354,6 +435,9 @@ private:
 	TranRead* read_act(int tran, TblNum tblnum, const char* index);
 	void table_create_act(TblNum tblnum);
 	bool validate_reads(Transaction* t);
+	FinalIdx* final_index(Tbl* tbl, const char* index);
+	void add_final_keys(const Transaction* t);
+	void remove_final_keys(const Transaction* t);
 	bool finalize();
 	void shutdown();
 	Transaction* get_tran(int tran);
@@ -381,8 +465,13 @@ private:
 	std::map<int, Transaction> trans;        // TODO consider Transaction*
 	HashMap<Mmoffset, TranTime> created;     // record address -> create time
 	HashMap<Mmoffset, TranDelete> deleted;   // record address -> delete time
+	VersionFilter versions;                  // of created and deleted
 	HashMap<TblNum, TranTime> table_created; // table name -> create time
 	std::set<Transaction> final; // transactions that need to be finalized
+	std::set<TblNum> loading_tbls; // tables being bulk loaded
+	// tblnum -> index columns -> keys written by final transactions
+	// built lazily by validate_reads, discarded when the Tbl is reloaded
+	std::map<TblNum, std::map<gcstring, FinalIdx>> final_keys;
 	uint32_t cksum;              // since commit
 	Lisp<Mmoffset> schema_deletes;
 	int output_type;
@@ -48,6 +48,8 @@ Dbms* dbms() {
 #include "tempdb.h"
 #include "row.h"
 #include "value.h"
+#include "globals.h"
+#include "compile.h"
 
 TEST(dbms_recadr) {
 	TempDB tempdb;
@@ -96,3 +98,57 @@ TEST(dbms_recadr) {
 		verify(dbms()->commit(tran));
 	}
 }
+
+static Record numrec(int n) {
+	Record r;
+	r.addval(n);
+	r.addval("x");
+	return r;
+}
+
+static int count(const char* query) {
+	int tran = dbms()->transaction(Dbms::READONLY);
+	DbmsQuery* q = dbms()->query(tran, query);
+	int n = 0;
+	while (q->get(NEXT) != Row::Eof)
+		++n;
+	q->close();
+	verify(dbms()->commit(tran));
+	return n;
+}
+
+// a batch output runs the trigger for each record before adding the next
+TEST(dbms_output_trigger) {
+	TempDB tempdb;
+
+	// so trigger searches won't give error
+	dbms()->admin("create stdlib (group, name, text) key(name,group)");
+	dbms()->admin("create trig_test (num, name) key(num)");
+	globals.put("Trigger_trig_test",
+		compile("function (t, oldrec, newrec)\n"
+				"\t{\n"
+				"\tif (newrec.num is 3)\n"
+				"\t\tthrow 'trigger failed'\n"
+				"\tif (false isnt t.Query1('trig_test where num = ' $\n"
+				"\t\t(newrec.num + 1)))\n"
+				"\t\tthrow 'trigger saw a later record'\n"
+				"\t}"));
+
+	int tran = dbms()->transaction(Dbms::READWRITE);
+	dbms()->output(tran, "trig_test", lisp(numrec(1), numrec(2)));
+	verify(dbms()->commit(tran));
+	assert_eq(count("trig_test"), 2);
+
+	// the records before the failing one have been added
+	tran = dbms()->transaction(Dbms::READWRITE);
+	xassert(dbms()->output(
+		tran, "trig_test", lisp(numrec(5), numrec(3), numrec(6))));
+	DbmsQuery* q = dbms()->query(tran, "trig_test where num > 2");
+	assert_eq(q->get(NEXT).data[1].getval(0), Value(3));
+	assert_eq(q->get(NEXT).data[1].getval(0), Value(5));
+	verify(q->get(NEXT) == Row::Eof);
+	q->close();
+	dbms()->abort(tran);
+
+	globals.put("Trigger_trig_test", Value());
+}
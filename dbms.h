@@ -62,6 +62,9 @@ public:
 	virtual int load(const char* filename) = 0;
 	virtual void log(const char* s) = 0;
 	virtual gcstring nonce() = 0;
+	// adds many records to one table, see Database::add_any_records
+	virtual void output(
+		int tn, const char* table, const Lisp<Record>& recs) = 0;
 	virtual DbmsQuery* query(int tn, const char* query) = 0;
 	virtual int readCount(int tn) = 0;
 	virtual int request(int tn, const char* s) = 0;
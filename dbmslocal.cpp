@@ -112,6 +112,7 @@ public:
 	int load(const char* filename) override;
 	void log(const char* s) override;
 	gcstring nonce() override;
+	void output(int tn, const char* table, const Lisp<Record>& recs) override;
 	DbmsQuery* query(int tn, const char* query) override;
 	int readCount(int tn) override;
 	int request(int tn, const char* s) override;
@@ -148,12 +149,12 @@ int DbmsLocal::request(int tran, const char* s) {
 }
 
 DbmsQuery* DbmsLocal::cursor(const char* s) {
-	Query* q = ::query(s, IS_CURSOR);
+	Query* q = query_cached(s, IS_CURSOR);
 	return new DbmsQueryLocal(q);
 }
 
 DbmsQuery* DbmsLocal::query(int tran, const char* s) {
-	Query* q = ::query(s);
+	Query* q = query_cached(s);
 	q->set_transaction(tran);
 	return new DbmsQueryLocal(q);
 }
@@ -216,6 +217,8 @@ Value DbmsLocal::info() {
 	SuObject* info = new SuObject;
 	info->putdata("tempDest", tempdest());
 	info->putdata("currentSize", size());
+	info->putdata("planCacheHits", plan_cache_hits);
+	info->putdata("planCacheMisses", plan_cache_misses);
 	return info;
 }
 
@@ -281,6 +284,19 @@ Mmoffset DbmsLocal::update(int tran, Mmoffset recadr, Record& newrec) {
 	return theDB()->update_record(tran, tbl, oldrec, newrec);
 }
 
+void DbmsLocal::output(int tran, const char* table, const Lisp<Record>& recs) {
+	Tbl* tbl = theDB()->ck_get_table(table);
+	Lisp<Record> rs;
+	for (Lisp<Record> r = recs; !nil(r); ++r)
+		if (tbl->num > TN_VIEWS && r->size() > tbl->nextfield) {
+			Record r2 = r->dup();
+			r2.truncate(tbl->nextfield);
+			rs.push(r2);
+		} else
+			rs.push(*r);
+	theDB()->add_records(tran, table, rs.reverse());
+}
+
 extern int tempdest_inuse;
 
 int DbmsLocal::tempdest() {
@@ -377,6 +393,7 @@ int update_request(
 	if (q->optimize(best_key, columns, Fields(), false, true) >= IMPOSSIBLE)
 		except("update: invalid query");
 	q = q->addindex();
+	need_data(q, true);
 	trace_tempindex(q);
 
 	Header hdr = q->header();
@@ -11,6 +11,8 @@
 #include "fibers.h"
 #include <cctype>
 #include <vector>
+#include <deque>
+#include <algorithm>
 #include "cmdlineoptions.h"
 #include "build.h"
 #include "tr.h"
@@ -47,6 +49,7 @@ public:
 	int load(const char* filename) override;
 	void log(const char* s) override;
 	gcstring nonce() override;
+	void output(int tn, const char* table, const Lisp<Record>& recs) override;
 	DbmsQuery* query(int tn, const char* query) override;
 	int readCount(int tn) override;
 	int request(int tn, const char* s) override;
@@ -61,11 +64,20 @@ public:
 	Mmoffset update(int tn, Mmoffset recadr, Record& rec) override;
 	int writeCount(int tn) override;
 
+	bool prefetch = true; // false if the server doesn't support GETN
+	bool outputs = true;  // false if the server doesn't support OUTPUTS
+
 private:
+	bool readonly(int tn) const {
+		return std::find(readonly_trans.begin(), readonly_trans.end(), tn) !=
+			readonly_trans.end();
+	}
+	void ended(int tn);
 	static bool checkHello(const gcstring& hello);
 	void close(int qn, CorQ cq);
 	const char* strategy(int qn, CorQ cq);
 	Row get(int tn, int qn, Dir dir);
+	bool getn(int qn, Dir dir, int skip, int n, std::deque<Row>& rows);
 	Header header(int qn, CorQ cq);
 	Lisp<Lisp<gcstring>> keys(int qn, CorQ cq);
 	Lisp<gcstring> order(int qn, CorQ cq);
@@ -79,7 +91,7 @@ private:
 	void send(Command cmd, int tn, int qn, Dir dir);
 	void send(Command cmd, Dir dir, bool one, int tn, const char* query);
 	void send(Command cmd, int qn, Record rec);
-	void send(Command cmd, int tn, int recadr, Record rec);
+	void send(Command cmd, int tn, Mmoffset recadr, Record rec);
 	void send(Command cmd, int n, CorQ cq);
 	void send(Command cmd, int n, const gcstring& s);
 	void send(Command cmd, const char* s);
@@ -92,11 +104,13 @@ private:
 	Row getRow(Header* phdr = nullptr);
 
 	ClientConnection io;
+	std::vector<int> readonly_trans; // outstanding READONLY transactions
 };
 
 class DbmsQueryRemote : public DbmsQuery {
 public:
-	DbmsQueryRemote(DbmsRemote& d, int q) : dr(d), qn(q) {
+	DbmsQueryRemote(DbmsRemote& d, int q, bool pf = false)
+		: dr(d), qn(q), prefetch_(pf) {
 	}
 	void set_transaction(int tn) override {
 	}
@@ -106,9 +120,7 @@ public:
 	const char* strategy() override {
 		return dr.strategy(qn, c_or_q());
 	}
-	Row get(Dir dir) override {
-		return dr.get(getTran(), qn, dir);
-	}
+	Row get(Dir dir) override;
 	Header header() override {
 		if (nil(header_))
 			header_ = dr.header(qn, c_or_q());
@@ -126,6 +138,8 @@ public:
 		return dr.output(qn, rec);
 	}
 	void rewind() override {
+		rows.clear();
+		rowseof = false;
 		return dr.rewind(qn, c_or_q());
 	}
 
@@ -136,13 +150,64 @@ protected:
 	virtual int getTran() {
 		return NO_TRAN;
 	}
+	// rows fetched earlier are only valid if nothing can change them
+	// i.e. queries in READONLY transactions (which see a fixed snapshot)
+	// update transactions could write between gets and
+	// cursors use a different transaction for each get
+	virtual bool prefetch() {
+		return prefetch_;
+	}
 
 	DbmsRemote& dr;
 	const int qn;
 	Header header_;             // cache
 	Lisp<Lisp<gcstring>> keys_; // cache
+
+private:
+	const bool prefetch_;
+	// rows fetched from the server but not yet returned
+	std::deque<Row> rows;
+	Dir rowsdir = NEXT;
+	bool rowseof = false; // server reached eof after rows
+	int batch = 1;        // doubles while reading sequentially
 };
 
+const int GETN_MAX_ROWS = 256;
+const int GETN_MAX_BYTES = 64 * 1024;
+
+Row DbmsQueryRemote::get(Dir dir) {
+	if (!prefetch())
+		return dr.get(getTran(), qn, dir);
+	if (dir == rowsdir && !rows.empty()) {
+		Row row = rows.front();
+		rows.pop_front();
+		return row;
+	}
+	if (dir == rowsdir && rowseof) {
+		rowseof = false; // server has already rewound
+		batch = 1;
+		return Row::Eof;
+	}
+	int skip = 0;
+	if (dir != rowsdir) {
+		// server is past the rows we haven't returned
+		// (and one more if it has already rewound)
+		skip = rows.size() + (rowseof ? 1 : 0);
+		rows.clear();
+		rowsdir = dir;
+		batch = 1;
+	}
+	rowseof = dr.getn(qn, dir, skip, batch, rows);
+	batch = std::min(2 * batch, GETN_MAX_ROWS);
+	if (rows.empty()) {
+		rowseof = false;
+		return Row::Eof;
+	}
+	Row row = rows.front();
+	rows.pop_front();
+	return row;
+}
+
 class DbmsCursorRemote : public DbmsQueryRemote {
 public:
 	DbmsCursorRemote(DbmsRemote& d, int c) : DbmsQueryRemote(d, c) {
@@ -174,6 +239,8 @@ DbmsRemote::DbmsRemote(SocketConnect* sc) : io(sc) {
 		except("connect failed\n"
 			<< "client: Suneido " << build << "\n"
 			<< "server: " << hello);
+	prefetch = !hello.has("Java");
+	outputs = prefetch;
 }
 
 bool DbmsRemote::checkHello(const gcstring& hello) {
@@ -199,6 +266,7 @@ DbmsRemote::~DbmsRemote() {
 }
 
 void DbmsRemote::abort(int tn) {
+	ended(tn);
 	send(Command::ABORT, tn);
 }
 
@@ -221,6 +289,7 @@ void DbmsRemote::close(int qn, CorQ cq) { // DbmsQuery
 }
 
 bool DbmsRemote::commit(int tn, const char** conflict) {
+	ended(tn);
 	send(Command::COMMIT, tn);
 	if (io.getBool())
 		return true;
@@ -250,7 +319,8 @@ Value DbmsRemote::dump(const char* filename) {
 }
 
 void DbmsRemote::erase(int tn, Mmoffset recadr) {
-	send(Command::ERASE, tn, recadr);
+	putCmd(Command::ERASE).putInt(tn).putInt(recadr);
+	doRequest();
 }
 
 Value DbmsRemote::exec(Value ob) {
@@ -278,10 +348,26 @@ Row DbmsRemote::get(int tn, int qn, Dir dir) { // DbmsQuery
 	return getRow();
 }
 
+// appends the rows to the deque, returns true if the server reached eof
+bool DbmsRemote::getn(
+	int qn, Dir dir, int skip, int n, std::deque<Row>& rows) { // DbmsQuery
+	putCmd(Command::GETN)
+		.put(dir == NEXT ? '+' : '-')
+		.putInt(NO_TRAN)
+		.putInt(qn)
+		.putInt(skip)
+		.putInt(n)
+		.putInt(GETN_MAX_BYTES);
+	doRequest();
+	for (Row row; Row::Eof != (row = getRow());)
+		rows.push_back(row);
+	return io.getBool();
+}
+
 Row DbmsRemote::getRow(Header* phdr) {
 	if (!io.getBool())
 		return Row::Eof;
-	int64_t recadr = static_cast<unsigned int>(io.getInt());
+	Mmoffset recadr = io.getInt();
 	if (phdr)
 		*phdr = getHeader();
 	gcstring r = io.getBuf();
@@ -377,10 +463,26 @@ bool DbmsRemote::output(int qn, Record rec) { // DbmsQuery
 	return true;
 }
 
+void DbmsRemote::output(int tn, const char* table, const Lisp<Record>& recs) {
+	if (!outputs) {
+		DbmsQuery* q = query(tn, table);
+		for (Lisp<Record> r = recs; !nil(r); ++r)
+			q->output(*r);
+		q->close();
+		return;
+	}
+	putCmd(Command::OUTPUTS).putInt(tn).putStr(table).putInt(recs.size());
+	for (Lisp<Record> r = recs; !nil(r); ++r) {
+		io.putInt(r->cursize());
+		io.write(static_cast<char*>(r->dup().ptr()), r->cursize());
+	}
+	doRequest();
+}
+
 DbmsQuery* DbmsRemote::query(int tn, const char* query) {
 	send(Command::QUERY, tn, query);
 	int qn = io.getInt();
-	return new DbmsQueryRemote(*this, qn);
+	return new DbmsQueryRemote(*this, qn, prefetch && readonly(tn));
 }
 
 int DbmsRemote::readCount(int tn) {
@@ -436,7 +538,16 @@ Lisp<int> DbmsRemote::tranlist() {
 
 int DbmsRemote::transaction(TranType type, const char* session_id) {
 	send(Command::TRANSACTION, type == READWRITE);
-	return io.getInt();
+	int tn = io.getInt();
+	if (type == READONLY)
+		readonly_trans.push_back(tn);
+	return tn;
+}
+
+void DbmsRemote::ended(int tn) {
+	auto it = std::find(readonly_trans.begin(), readonly_trans.end(), tn);
+	if (it != readonly_trans.end())
+		readonly_trans.erase(it);
 }
 
 Mmoffset DbmsRemote::update(int tn, Mmoffset recadr, Record& rec) {
@@ -491,7 +602,7 @@ void DbmsRemote::send(Command cmd, int qn, Record rec) {
 	doRequest();
 }
 
-void DbmsRemote::send(Command cmd, int tn, int recadr, Record rec) {
+void DbmsRemote::send(Command cmd, int tn, Mmoffset recadr, Record rec) {
 	putCmd(cmd).putInt(tn).putInt(recadr).putInt(rec.cursize());
 	io.write(static_cast<char*>(rec.dup().ptr()), rec.cursize());
 	doRequest();
@@ -581,3 +692,223 @@ Dbms* dbms_remote(const char* addr) {
 		throw;
 	}
 }
+
+// tests ------------------------------------------------------------
+
+#include "testing.h"
+#include "record.h"
+
+// a Serializer that just accumulates what is put
+class TestReply : public Serializer {
+public:
+	TestReply() : Serializer(rd, wr) {
+	}
+	TestReply& ok() {
+		putOk();
+		return *this;
+	}
+	TestReply& flag(bool b) {
+		putBool(b);
+		return *this;
+	}
+	TestReply& num(int64_t n) {
+		putInt(n);
+		return *this;
+	}
+	TestReply& row(Mmoffset recadr, const char* s) {
+		Record rec;
+		rec.addval(s);
+		putBool(true).putInt(recadr).putInt(rec.bufsize());
+		wr.add(static_cast<char*>(rec.ptr()), rec.bufsize());
+		return *this;
+	}
+	gcstring gcstr() const {
+		return wr.gcstr();
+	}
+
+protected:
+	void need(int n) override {
+	}
+	void read(char* buf, int n) override {
+	}
+
+private:
+	Buffer rd;
+	Buffer wr;
+};
+
+// a fake server that answers each request with the next scripted reply
+// and records the commands it was sent
+class TestServer : public SocketConnect {
+public:
+	TestServer() {
+		char* buf = salloc(HELLO_SIZE);
+		memset(buf, 0, HELLO_SIZE);
+		strcpy(buf, "Suneido ");
+		strcat(buf, build);
+		replies.push_back(gcstring::noalloc(buf, HELLO_SIZE));
+	}
+	void reply(const TestReply& r) {
+		replies.push_back(r.gcstr());
+	}
+	using SocketConnect::read;
+	int read(char* buf, int required, int bufsize) override {
+		gcstring& r = replies[cur];
+		int n = std::min(bufsize, int(r.size()) - pos);
+		verify(n >= required);
+		memcpy(buf, r.ptr() + pos, n);
+		pos += n;
+		return n;
+	}
+	bool readline(char* buf, int n) override {
+		return false;
+	}
+	// requests may be written in more than one piece,
+	// a new one starts with a command
+	void write(const char* buf, int n) override {
+		if (wrbuf.size() > 0) {
+			cmds.push_back(Command(wrbuf.buffer()[0]));
+			requests.push_back(wrbuf.gcstr());
+			++cur;
+			pos = 0;
+		}
+		wrbuf.clear();
+	}
+	void close() override {
+	}
+
+	std::vector<Command> cmds;
+	std::vector<gcstring> requests; // without any record
+
+private:
+	std::vector<gcstring> replies;
+	int cur = 0;
+	int pos = 0;
+};
+
+static gcstring getstr(Row row) {
+	return row.data[0].getstr(0);
+}
+
+TEST(dbmsremote_get_after_update) {
+	auto ts = new TestServer;
+	ts->reply(TestReply().ok().num(1)); // TRANSACTION
+	ts->reply(TestReply().ok().num(2)); // QUERY
+	ts->reply(TestReply().ok().row(100, "one"));
+	ts->reply(TestReply().ok().num(200)); // UPDATE
+	ts->reply(TestReply().ok().row(300, "two"));
+	DbmsRemote dr(ts);
+	int tn = dr.transaction(Dbms::READWRITE, "");
+	DbmsQuery* q = dr.query(tn, "tbl");
+	assert_eq(getstr(q->get(NEXT)), "one");
+	Record rec;
+	rec.addval("changed");
+	dr.update(tn, 100, rec);
+	// must come from the server, not from rows fetched before the update
+	assert_eq(getstr(q->get(NEXT)), "two");
+	std::vector<Command> expected{Command::TRANSACTION, Command::QUERY,
+		Command::GET, Command::UPDATE, Command::GET};
+	verify(ts->cmds == expected);
+}
+
+TEST(dbmsremote_readonly_prefetch) {
+	auto ts = new TestServer;
+	ts->reply(TestReply().ok().num(1)); // TRANSACTION
+	ts->reply(TestReply().ok().num(2)); // QUERY
+	// GETN batch of 1
+	ts->reply(TestReply().ok().row(100, "one").flag(false).flag(false));
+	// GETN batch of 2, then eof
+	ts->reply(TestReply()
+				  .ok()
+				  .row(101, "two")
+				  .row(102, "three")
+				  .flag(false)
+				  .flag(true));
+	DbmsRemote dr(ts);
+	int tn = dr.transaction(Dbms::READONLY, "");
+	DbmsQuery* q = dr.query(tn, "tbl");
+	assert_eq(getstr(q->get(NEXT)), "one");
+	assert_eq(getstr(q->get(NEXT)), "two");
+	assert_eq(getstr(q->get(NEXT)), "three");
+	verify(Row::Eof == q->get(NEXT));
+	std::vector<Command> expected{Command::TRANSACTION, Command::QUERY,
+		Command::GETN, Command::GETN};
+	verify(ts->cmds == expected);
+}
+
+// a Serializer that reads back a request the TestServer recorded
+class TestRequest : public Serializer {
+public:
+	explicit TestRequest(const gcstring& s) : Serializer(rd, wr) {
+		rd.add(s);
+	}
+
+protected:
+	void need(int n) override {
+		verify(rd.remaining() >= n);
+	}
+	void read(char* buf, int n) override {
+	}
+
+private:
+	Buffer rd;
+	Buffer wr;
+};
+
+// record addresses past 4 gb must survive the trip in both directions
+TEST(dbmsremote_recadr_64) {
+	const Mmoffset adr1 = (Mmoffset(5) << 30) + 4;
+	const Mmoffset adr2 = (Mmoffset(6) << 30) + 8;
+	auto ts = new TestServer;
+	ts->reply(TestReply().ok().num(1)); // TRANSACTION
+	ts->reply(TestReply().ok().num(2)); // QUERY
+	ts->reply(TestReply().ok().row(adr1, "one"));
+	ts->reply(TestReply().ok().num(adr2)); // UPDATE
+	ts->reply(TestReply().ok()); // ERASE
+	DbmsRemote dr(ts);
+	int tn = dr.transaction(Dbms::READWRITE, "");
+	DbmsQuery* q = dr.query(tn, "tbl");
+	assert_eq(q->get(NEXT).recadr, adr1);
+	Record rec;
+	rec.addval("changed");
+	assert_eq(dr.update(tn, adr1, rec), adr2);
+	dr.erase(tn, adr2);
+
+	TestRequest update(ts->requests[3]);
+	assert_eq(update.getCmd(), char(Command::UPDATE));
+	assert_eq(update.getInt(), tn);
+	assert_eq(update.getInt(), adr1);
+	TestRequest erase(ts->requests[4]);
+	assert_eq(erase.getCmd(), char(Command::ERASE));
+	assert_eq(erase.getInt(), tn);
+	assert_eq(erase.getInt(), adr2);
+}
+
+// benchmarks -------------------------------------------------------
+// these need a server running on the local machine i.e. suneido -s
+
+static void get_rows(DbmsRemote* dr, int64_t nreps) {
+	int tn = dr->transaction(Dbms::READONLY, "");
+	DbmsQuery* q = dr->query(tn, "columns");
+	while (nreps > 0)
+		if (Row::Eof == q->get(NEXT))
+			q->rewind();
+		else
+			--nreps;
+	q->close();
+	const char* conflict;
+	dr->commit(tn, &conflict);
+}
+
+BENCHMARK(remote_get) {
+	static DbmsRemote* dr =
+		new DbmsRemote(socketClientSync("127.0.0.1", su_port));
+	dr->prefetch = false;
+	get_rows(dr, nreps);
+}
+
+BENCHMARK(remote_getn) {
+	static DbmsRemote* dr =
+		new DbmsRemote(socketClientSync("127.0.0.1", su_port));
+	get_rows(dr, nreps);
+}
@@ -74,6 +74,10 @@ public:
 	gcstring nonce() override {
 		return dbms->nonce();
 	}
+	void output(
+		int tran, const char* table, const Lisp<Record>& recs) override {
+		unauth();
+	}
 	DbmsQuery* query(int tran, const char* s) override {
 		unauth();
 	}
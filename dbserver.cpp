@@ -71,6 +71,8 @@ public:
 	void cmd_TRANSACTIONS();
 	void cmd_UPDATE();
 	void cmd_WRITECOUNT();
+	void cmd_GETN();
+	void cmd_OUTPUTS();
 
 	Dbms& dbms() const {
 		return data.auth ? *::dbms() : *newDbmsUnauth(::dbms());
@@ -85,12 +87,14 @@ public:
 	void putValue(Value val);
 
 	void close() {
+		fiber->killed = true; // e.g. to cancel an index build
 		io.close();
 	}
 
 	Connection io;
 	DbServerData& data;
 	SuString* session_id;
+	ThreadLocalStorage* fiber;
 	SesViews session_views;
 	Proc proc;
 };
@@ -109,6 +113,7 @@ static const gcstring hello = makeHello();
 
 DbServer::DbServer(SocketConnect* sc) : io(sc), data(*DbServerData::create()) {
 	tls().fiber_id = sc->getadr();
+	fiber = &tls();
 	session_id = new SuString(sc->getadr());
 	dbserver_connections().add(session_id);
 	dbservers.push_back(this);
@@ -162,7 +167,7 @@ static CmdFn commands[]{&DbServer::cmd_ABORT, &DbServer::cmd_ADMIN,
 	&DbServer::cmd_SESSIONID, &DbServer::cmd_SIZE, &DbServer::cmd_TIMESTAMP,
 	&DbServer::cmd_TOKEN, &DbServer::cmd_TRANSACTION,
 	&DbServer::cmd_TRANSACTIONS, &DbServer::cmd_UPDATE,
-	&DbServer::cmd_WRITECOUNT};
+	&DbServer::cmd_WRITECOUNT, &DbServer::cmd_GETN, &DbServer::cmd_OUTPUTS};
 
 void DbServer::run() {
 	while (true) {
@@ -283,6 +288,35 @@ void DbServer::cmd_GET() {
 	return putRow(row, hdr, false);
 }
 
+// returns up to n rows, or until the byte budget is used
+// skip lets the client discard rows it prefetched but didn't use
+// when it changes direction
+void DbServer::cmd_GETN() {
+	Dir dir = (io.get() == '-') ? PREV : NEXT;
+	DbmsQuery* q = q_or_tc();
+	int skip = io.getInt();
+	int n = io.getInt();
+	int budget = io.getInt();
+	Header hdr = q->header();
+	io.putOk();
+	bool eof = false;
+	for (; skip > 0 && !eof; --skip)
+		eof = nil(q->get(dir).data);
+	for (int nbytes = 0; !eof && n > 0 && nbytes < budget; --n) {
+		Row row = q->get(dir);
+		if (nil(row.data)) {
+			eof = true;
+			break;
+		}
+		Record rec = row.to_record(hdr);
+		io.putBool(true).putInt(row.recadr);
+		io.putInt(rec.bufsize());
+		io.write(static_cast<char*>(rec.ptr()), rec.bufsize());
+		nbytes += rec.bufsize();
+	}
+	io.putBool(false).putBool(eof);
+}
+
 void DbServer::cmd_GET1() {
 	char d = io.get();
 	Dir dir = d == '-' ? PREV : NEXT;
@@ -383,6 +417,17 @@ void DbServer::cmd_OUTPUT() {
 	io.putOk();
 }
 
+void DbServer::cmd_OUTPUTS() {
+	int tn = io.getInt();
+	gcstring table = io.getStr();
+	int n = io.getInt();
+	Lisp<Record> recs;
+	for (int i = 0; i < n; ++i)
+		recs.push(getRecord());
+	dbms().output(tn, table.str(), recs.reverse());
+	io.putOk();
+}
+
 void DbServer::cmd_QUERY() {
 	int tn = io.getInt();
 	gcstring query = io.getStr();
@@ -450,7 +495,7 @@ void DbServer::cmd_TRANSACTIONS() {
 
 void DbServer::cmd_UPDATE() {
 	int tn = io.getInt();
-	int recadr = io.getInt();
+	Mmoffset recadr = io.getInt();
 	Record rec = getRecord();
 	recadr = dbms().update(tn, recadr, rec);
 	io.putOk().putInt(recadr);
@@ -4,12 +4,12 @@
 #include "dump.h"
 #include "database.h"
 #include "thedb.h"
-#include "ostreamfile.h"
+#include "fileasync.h"
 #include "fibers.h" // for yieldif
 
-static int dump1(OstreamFile& fout, int tran, const gcstring& table,
+static int dump1(Ostream& fout, int tran, const gcstring& table,
 	bool output_name = true);
-static void write_size(OstreamFile& fout, int n);
+static void write_size(Ostream& fout, int n);
 
 struct Session {
 	Session() {
@@ -25,13 +25,14 @@ void dump(const gcstring& table) {
 	Session session;
 
 	if (table != "") {
-		OstreamFile fout((table + ".su").str(), "wb");
+		OstreamFileAsync fout((table + ".su").str());
 		if (!fout)
 			except("can't create " << table + ".su");
 		fout << "Suneido dump 2" << endl;
 		dump1(fout, session.tran, table, false);
+		fout.flush(); // throws if a write failed
 	} else {
-		OstreamFile fout("database.su", "wb");
+		OstreamFileAsync fout("database.su");
 		if (!fout)
 			except("can't create database.su");
 		fout << "Suneido dump 2" << endl;
@@ -45,11 +46,12 @@ void dump(const gcstring& table) {
 			dump1(fout, session.tran, t);
 		}
 		dump1(fout, session.tran, "views");
+		fout.flush(); // throws if a write failed
 	}
 }
 
 static int dump1(
-	OstreamFile& fout, int tran, const gcstring& table, bool output_name) {
+	Ostream& fout, int tran, const gcstring& table, bool output_name) {
 	fout << "====== "; // load needs this same length as "create"
 	if (output_name)
 		fout << table << " ";
@@ -82,7 +84,7 @@ static int dump1(
 	return nrecs;
 }
 
-static void write_size(OstreamFile& fout, int n) {
+static void write_size(Ostream& fout, int n) {
 	char buf[4];
 	buf[0] = n >> 24;
 	buf[1] = n >> 16;
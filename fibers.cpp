@@ -68,7 +68,8 @@ static int64_t run_until;
 static const int TIME_SLICE_MS = 50;
 
 ThreadLocalStorage::ThreadLocalStorage()
-	: proc(0), thedbms(0), session_views(0), fiber_id(""), synchronized(0) {
+	: proc(0), thedbms(0), session_views(0), fiber_id(""), synchronized(0),
+	  killed(false) {
 }
 
 ThreadLocalStorage& tls() {
@@ -17,6 +17,7 @@ struct ThreadLocalStorage {
 	SesViews* session_views;
 	const char* fiber_id;
 	int synchronized; // normally 0 (meaning allow yield), set by Synchronized
+	bool killed; // set by kill_connections, long requests can stop early
 };
 
 extern ThreadLocalStorage& tls();
@@ -0,0 +1,265 @@
+// Copyright (c) 2000 Suneido Software Corp. All rights reserved
+// Licensed under GPLv2
+
+#include "fileasync.h"
+#include "port.h"
+#include "except.h"
+#include "win.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+using std::min;
+
+// the buffers are NOT garbage collected
+// and the threads must not allocate from the garbage collected heap
+const int BUFSIZE = 1024 * 1024;
+
+// IstreamFileAsync =================================================
+
+class IstreamFileAsyncImp {
+public:
+	explicit IstreamFileAsyncImp(const char* filename)
+		: f(fopen(filename, "rb")) {
+		if (!f)
+			return;
+		for (int i = 0; i < 2; ++i) {
+			buf[i] = static_cast<char*>(mem_committed(BUFSIZE));
+			empty[i] = CreateEvent(nullptr, FALSE, TRUE, nullptr);
+			full[i] = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		}
+		thread = CreateThread(nullptr, 0, reader, this, 0, nullptr);
+		verify(thread);
+	}
+	void close() {
+		if (!f)
+			return;
+		stop = true;
+		SetEvent(empty[0]);
+		SetEvent(empty[1]);
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+		for (int i = 0; i < 2; ++i) {
+			CloseHandle(empty[i]);
+			CloseHandle(full[i]);
+			mem_release(buf[i]);
+		}
+		fclose(f);
+		f = nullptr;
+	}
+	int get() {
+		if (pos >= lim && !next())
+			return -1;
+		return static_cast<unsigned char>(buf[cur][pos++]);
+	}
+	int read(char* dst, int n) {
+		int nread = 0;
+		while (nread < n && (pos < lim || next())) {
+			int k = min(n - nread, lim - pos);
+			memcpy(dst + nread, buf[cur] + pos, k);
+			pos += k;
+			nread += k;
+		}
+		return nread;
+	}
+	int64_t tellg() const {
+		return offset + pos;
+	}
+
+private:
+	// release the current buffer back to the reader thread
+	// and switch to the other one once it has been filled
+	bool next() {
+		if (!f || eof)
+			return false;
+		if (started)
+			SetEvent(empty[cur]);
+		started = true;
+		offset += lim;
+		cur = 1 - cur;
+		WaitForSingleObject(full[cur], INFINITE);
+		pos = 0;
+		lim = len[cur];
+		if (lim < BUFSIZE)
+			eof = true;
+		return lim > 0;
+	}
+	// runs in a separate thread, alternately filling the two buffers
+	static DWORD WINAPI reader(LPVOID p) {
+		auto imp = static_cast<IstreamFileAsyncImp*>(p);
+		for (int i = 0;; i = 1 - i) {
+			WaitForSingleObject(imp->empty[i], INFINITE);
+			if (imp->stop)
+				return 0;
+			imp->len[i] = fread(imp->buf[i], 1, BUFSIZE, imp->f);
+			SetEvent(imp->full[i]);
+			if (imp->len[i] < BUFSIZE)
+				return 0;
+		}
+	}
+
+	FILE* f;
+	HANDLE thread = nullptr;
+	char* buf[2] = {};
+	int len[2] = {};
+	HANDLE empty[2] = {};
+	HANDLE full[2] = {};
+	volatile bool stop = false;
+	int cur = 1; // so the first next() switches to buffer 0
+	bool started = false;
+	bool eof = false;
+	int pos = 0;
+	int lim = 0;
+	int64_t offset = 0;
+};
+
+IstreamFileAsync::IstreamFileAsync(const char* filename)
+	: imp(new IstreamFileAsyncImp(filename)) {
+}
+
+IstreamFileAsync::~IstreamFileAsync() {
+	imp->close();
+}
+
+int IstreamFileAsync::get_() {
+	return imp->get();
+}
+
+int IstreamFileAsync::read_(char* buf, int n) {
+	return imp->read(buf, n);
+}
+
+int64_t IstreamFileAsync::tellg() {
+	return imp->tellg();
+}
+
+Istream& IstreamFileAsync::seekg(int64_t pos) {
+	except("IstreamFileAsync does not support seekg");
+}
+
+// OstreamFileAsync =================================================
+
+class OstreamFileAsyncImp {
+public:
+	explicit OstreamFileAsyncImp(const char* filename)
+		: f(fopen(filename, "wb")) {
+		if (!f)
+			return;
+		for (int i = 0; i < 2; ++i) {
+			buf[i] = static_cast<char*>(mem_committed(BUFSIZE));
+			// buffer 0 starts out in use by the caller
+			empty[i] = CreateEvent(nullptr, FALSE, i == 1, nullptr);
+			full[i] = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		}
+		thread = CreateThread(nullptr, 0, writer, this, 0, nullptr);
+		verify(thread);
+	}
+	void close() {
+		if (!f)
+			return;
+		if (pos > 0)
+			next();
+		len[cur] = 0; // tells the writer thread to finish
+		SetEvent(full[cur]);
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+		for (int i = 0; i < 2; ++i) {
+			CloseHandle(empty[i]);
+			CloseHandle(full[i]);
+			mem_release(buf[i]);
+		}
+		fclose(f);
+		f = nullptr;
+	}
+	void add(const void* s, int n) {
+		if (!f)
+			return;
+		auto p = static_cast<const char*>(s);
+		while (n > 0) {
+			int k = min(n, BUFSIZE - pos);
+			memcpy(buf[cur] + pos, p, k);
+			pos += k;
+			p += k;
+			n -= k;
+			if (pos == BUFSIZE) {
+				next();
+				ck();
+			}
+		}
+	}
+	explicit operator bool() const {
+		return f;
+	}
+	// waits till everything so far has been written
+	void flush() {
+		if (!f)
+			return;
+		if (pos > 0)
+			next();
+		int other = 1 - cur;
+		WaitForSingleObject(empty[other], INFINITE);
+		SetEvent(empty[other]); // writer thread is now idle
+		if (fflush(f) != 0)
+			failed = true;
+		ck();
+	}
+
+private:
+	// the writer thread can't throw, so it sets failed
+	void ck() const {
+		if (failed)
+			except("error writing file (disk full?)");
+	}
+	// pass the current buffer to the writer thread
+	// and switch to the other one once it has been written
+	void next() {
+		len[cur] = pos;
+		SetEvent(full[cur]);
+		cur = 1 - cur;
+		WaitForSingleObject(empty[cur], INFINITE);
+		pos = 0;
+	}
+	// runs in a separate thread, alternately writing the two buffers
+	static DWORD WINAPI writer(LPVOID p) {
+		auto imp = static_cast<OstreamFileAsyncImp*>(p);
+		for (int i = 0;; i = 1 - i) {
+			WaitForSingleObject(imp->full[i], INFINITE);
+			if (imp->len[i] == 0)
+				return 0;
+			if (fwrite(imp->buf[i], 1, imp->len[i], imp->f) !=
+				size_t(imp->len[i]))
+				imp->failed = true;
+			SetEvent(imp->empty[i]);
+		}
+	}
+
+	FILE* f;
+	HANDLE thread = nullptr;
+	char* buf[2] = {};
+	int len[2] = {};
+	HANDLE empty[2] = {};
+	HANDLE full[2] = {};
+	volatile bool failed = false;
+	int cur = 0;
+	int pos = 0;
+};
+
+OstreamFileAsync::OstreamFileAsync(const char* filename)
+	: imp(new OstreamFileAsyncImp(filename)) {
+}
+
+OstreamFileAsync::~OstreamFileAsync() {
+	imp->close();
+}
+
+Ostream& OstreamFileAsync::write(const void* s, int n) {
+	imp->add(s, n);
+	return *this;
+}
+
+void OstreamFileAsync::flush() {
+	imp->flush();
+}
+
+OstreamFileAsync::operator bool() const {
+	return bool(*imp);
+}
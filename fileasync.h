@@ -0,0 +1,43 @@
+#pragma once
+// Copyright (c) 2000 Suneido Software Corp. All rights reserved
+// Licensed under GPLv2
+
+#include "istream.h"
+#include "ostream.h"
+
+class IstreamFileAsyncImp;
+
+// an input stream from a file
+// that reads ahead on a separate thread into double buffers
+// for large sequential reads e.g. load
+class IstreamFileAsync : public Istream {
+public:
+	explicit IstreamFileAsync(const char* filename);
+	~IstreamFileAsync();
+	int64_t tellg() override;
+	Istream& seekg(int64_t pos) override;
+
+protected:
+	int get_() override;
+	int read_(char* buf, int n) override;
+
+private:
+	IstreamFileAsyncImp* imp;
+};
+
+class OstreamFileAsyncImp;
+
+// an output stream to a file
+// that writes behind on a separate thread from double buffers
+// for large sequential writes e.g. dump
+class OstreamFileAsync : public Ostream {
+public:
+	explicit OstreamFileAsync(const char* filename);
+	~OstreamFileAsync();
+	Ostream& write(const void* buf, int n) override;
+	explicit operator bool() const;
+	void flush() override;
+
+private:
+	OstreamFileAsyncImp* imp;
+};
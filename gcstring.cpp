@@ -129,23 +129,116 @@ int gcstring::find(char c, int pos) const {
 	return q ? q - p : -1;
 }
 
+// substring search ------------------------------------------------
+
+// the search functions require 2 <= xn <= sn
+// and return the offset of the first match or -1
+
+// memchr (which libc vectorizes) for the first char, then memcmp the rest
+static int search_scalar(const char* s, int sn, const char* x, int xn) {
+	const char* lim = s + sn - xn;
+	for (const char* p = s; p <= lim; ++p) {
+		p = static_cast<const char*>(memchr(p, x[0], lim - p + 1));
+		if (!p)
+			break;
+		if (0 == memcmp(p + 1, x + 1, xn - 1))
+			return p - s;
+	}
+	return -1;
+}
+
+// Compare a block of positions at once against the first and last chars
+// of x and only memcmp the middle where both match. Checking the last char
+// as well as the first keeps false positives rare even on repetitive text.
+// The tail that doesn't fill a block is left to search_scalar.
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define SIMD_SEARCH
+#include <immintrin.h>
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+
+SSE2 static int search_sse2(const char* s, int sn, const char* x, int xn) {
+	const __m128i first = _mm_set1_epi8(x[0]);
+	const __m128i last = _mm_set1_epi8(x[xn - 1]);
+	int i = 0;
+	for (; i + xn - 1 + 16 <= sn; i += 16) {
+		__m128i bf = _mm_loadu_si128((const __m128i*) (s + i));
+		__m128i bl = _mm_loadu_si128((const __m128i*) (s + i + xn - 1));
+		unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(first, bf), _mm_cmpeq_epi8(last, bl)));
+		for (; mask; mask &= mask - 1) {
+			int j = i + __builtin_ctz(mask);
+			if (0 == memcmp(s + j + 1, x + 1, xn - 2))
+				return j;
+		}
+	}
+	int j = search_scalar(s + i, sn - i, x, xn);
+	return j < 0 ? -1 : i + j;
+}
+
+AVX2 static int search_avx2(const char* s, int sn, const char* x, int xn) {
+	const __m256i first = _mm256_set1_epi8(x[0]);
+	const __m256i last = _mm256_set1_epi8(x[xn - 1]);
+	int i = 0;
+	for (; i + xn - 1 + 32 <= sn; i += 32) {
+		__m256i bf = _mm256_loadu_si256((const __m256i*) (s + i));
+		__m256i bl = _mm256_loadu_si256((const __m256i*) (s + i + xn - 1));
+		unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi8(first, bf), _mm256_cmpeq_epi8(last, bl)));
+		for (; mask; mask &= mask - 1) {
+			int j = i + __builtin_ctz(mask);
+			if (0 == memcmp(s + j + 1, x + 1, xn - 2))
+				return j;
+		}
+	}
+	int j = search_scalar(s + i, sn - i, x, xn);
+	return j < 0 ? -1 : i + j;
+}
+#endif
+
+typedef int (*SearchFn)(const char* s, int sn, const char* x, int xn);
+
+// choose the best version the cpu supports
+static SearchFn search_fn() {
+#ifdef SIMD_SEARCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return search_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return search_sse2;
+#endif
+	return search_scalar;
+}
+
 int gcstring::find(const gcstring& x, int pos) const {
 	ckflat();
 	x.ckflat();
-	int lim = n - x.n;
-	for (int i = max(0, pos); i <= lim; ++i)
-		if (0 == memcmp(p + i, x.p, x.n))
-			return i;
-	return -1;
+	if (pos < 0)
+		pos = 0;
+	if (x.n <= 1)
+		return x.n == 1 ? find(x.p[0], pos) : (pos <= n ? pos : -1);
+	if (pos > n - x.n)
+		return -1;
+	static const SearchFn search = search_fn();
+	int i = search(p + pos, n - pos, x.p, x.n);
+	return i < 0 ? -1 : pos + i;
 }
 
+// checks the first and last chars before comparing the rest
 int gcstring::findlast(const gcstring& x, int pos) const {
 	if (x.size() > size())
 		return -1;
 	ckflat();
 	x.ckflat();
+	if (x.n == 0)
+		return min(pos, n) >= 0 ? min(pos, n) : -1;
+	const char first = x.p[0];
+	const char last = x.p[x.n - 1];
 	for (int i = min(pos, n - x.n); i >= 0; --i)
-		if (0 == memcmp(p + i, x.p, x.n))
+		if (p[i] == first && p[i + x.n - 1] == last &&
+			0 == memcmp(p + i, x.p, x.n))
 			return i;
 	return -1;
 }
@@ -263,6 +356,7 @@ char* salloc(int n) {
 }
 
 #include "testing.h"
+#include "random.h"
 
 TEST(gcstring_construct) {
 	gcstring s;
@@ -324,6 +418,55 @@ TEST(gcstring_find) {
 	t = "b";
 	int pos = -99;
 	assert_eq(s.find(t, pos), 1);
+
+	s = "hello";
+	assert_eq(s.find("", 2), 2);
+	assert_eq(s.find("", 5), 5);
+	assert_eq(s.find("", 6), -1);
+	assert_eq(s.find("lo", 4), -1);
+	assert_eq(s.find("lo", 99), -1);
+	assert_eq(s.findlast("l"), 3);
+	assert_eq(s.findlast("l", 2), 2);
+	assert_eq(s.findlast(""), 5);
+	assert_eq(s.findlast("hx"), -1);
+}
+
+static int search_naive(const char* s, int sn, const char* x, int xn) {
+	for (int i = 0; i <= sn - xn; ++i)
+		if (0 == memcmp(s + i, x, xn))
+			return i;
+	return -1;
+}
+
+// a small alphabet gives lots of partial matches
+static void test_search_fn(SearchFn fn) {
+	const int N = 300;
+	char s[N];
+	char x[20];
+	for (int i = 0; i < 2000; ++i) {
+		int sn = random(N);
+		for (int j = 0; j < sn; ++j)
+			s[j] = "ab\xff"[random(3)];
+		int xn = 2 + random(sizeof x - 2);
+		if (xn > sn)
+			continue;
+		if (random(2))
+			memcpy(x, s + random(sn - xn + 1), xn);
+		else
+			for (int j = 0; j < xn; ++j)
+				x[j] = "ab\xff"[random(3)];
+		assert_eq(fn(s, sn, x, xn), search_naive(s, sn, x, xn));
+	}
+}
+
+TEST(gcstring_search) {
+	test_search_fn(search_scalar);
+	test_search_fn(search_fn());
+#ifdef SIMD_SEARCH
+	test_search_fn(search_sse2);
+	if (__builtin_cpu_supports("avx2"))
+		test_search_fn(search_avx2);
+#endif
 }
 
 TEST(gcstring_presuffix) {
@@ -366,3 +509,40 @@ TEST(gcstring_beforeLast) {
 	s = "name_lower!";
 	assert_eq(s.beforeLast("_lower!"), "name");
 }
+
+//-------------------------------------------------------------------
+
+// roughly a page of text, and the length of a larger document
+static gcstring bench_text(int n) {
+	const char* words[] = {"the", "quick", "brown", "fox", "jumps", "over",
+		"lazy", "dog", "invoice", "customer", "amount", "date", "total"};
+	gcstring s;
+	while (int(s.size()) < n) {
+		s += words[random(sizeof words / sizeof words[0])];
+		s += random(10) ? " " : "\n";
+	}
+	return s;
+}
+
+static void search_bench(SearchFn fn, int n, int64_t nreps) {
+	gcstring s = bench_text(n);
+	gcstring x = "customer_name"; // partial matches but no match
+	while (nreps-- > 0)
+		fn(s.ptr(), s.size(), x.ptr(), x.size());
+}
+
+BENCHMARK(gcstring_find_scalar_4k) {
+	search_bench(search_scalar, 4 * 1024, nreps);
+}
+
+BENCHMARK(gcstring_find_4k) {
+	search_bench(search_fn(), 4 * 1024, nreps);
+}
+
+BENCHMARK(gcstring_find_scalar_1m) {
+	search_bench(search_scalar, 1024 * 1024, nreps);
+}
+
+BENCHMARK(gcstring_find_1m) {
+	search_bench(search_fn(), 1024 * 1024, nreps);
+}
@@ -13,7 +13,7 @@ Globals globals;
 const int INITSIZE = 1024;
 const int NAMES_SPACE = 1024 * 1024;
 
-#define MISSING ((SuValue*) 1)
+#define MISSING ((SuValue*) 2) // odd values are Value integers
 
 static Hmap<const char*, uint16_t> tbl(INITSIZE);
 static std::vector<Value> data;
@@ -34,10 +34,13 @@ Value Globals::get(uint16_t j) {
 }
 
 void Globals::put(uint16_t j, Value x) {
+	if (data[j])
+		++epoch;
 	data[j] = x;
 }
 
 void Globals::clear() {
+	++epoch;
 	std::fill(data.begin(), data.end(), Value());
 }
 
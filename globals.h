@@ -27,6 +27,10 @@ struct Globals {
 	void put(uint16_t j, Value x);
 	void clear();
 	void pop(uint16_t i);
+
+	// incremented whenever a global is replaced or cleared
+	// so cached lookups (e.g. SuClass::get3) can tell they are stale
+	int epoch = 0;
 };
 
 extern Globals globals;
@@ -6,6 +6,7 @@
 #include "slots.h"
 #include "record.h"
 #include "database.h"
+#include "tempruns.h"
 
 // Index ============================================================
 
@@ -82,7 +83,7 @@ Record Index::iterator::data() {
 }
 
 bool Index::iterator::visible() {
-	return ix->db->visible(tran, iter->adr());
+	return ix->db->visible(tran, asof, iter->adr());
 }
 
 static bool eq(Record r1, Record r2) {
@@ -95,6 +96,54 @@ static bool eq(Record r1, Record r2) {
 	return true;
 }
 
+// bulk build an empty index from keys (with record addresses)
+// returns a duplicate key if there is one, leaving the index empty
+Record Index::load(std::vector<Key>& keys) {
+	std::sort(keys.begin(), keys.end());
+	if (iskey || unique)
+		for (size_t i = 1; i < keys.size(); ++i)
+			if ((iskey || !empty(keys[i])) && eq(keys[i - 1], keys[i]))
+				return keys[i];
+	bt.load(keys.begin(), keys.end());
+	return Record();
+}
+
+// bulk build an empty index from sorted runs of keys (with record addresses)
+// that are too large to sort in memory
+// returns a duplicate key if there is one, the index is then incomplete
+Record Index::load(TempRuns& runs) {
+	// adapts the merged runs to the iterator Btree::load expects
+	// ending early at a duplicate
+	struct Iter {
+		Index* ix;
+		TempRuns* runs;
+		Record* dup;
+		Record operator*() const {
+			return runs->key();
+		}
+		void operator++() {
+			Record prev = runs->key();
+			runs->next();
+			if (runs->eof() || !(ix->iskey || ix->unique))
+				return;
+			Record key = runs->key();
+			if ((ix->iskey || !empty(key)) && eq(prev, key))
+				*dup = key;
+		}
+		bool operator==(const Iter&) const {
+			return runs->eof() || !nil(*dup);
+		}
+		bool operator!=(const Iter& y) const {
+			return !(*this == y);
+		}
+	};
+	Record dup;
+	runs.seek(Record());
+	Iter iter{this, &runs, &dup};
+	bt.load(iter, iter);
+	return dup;
+}
+
 #include "trace.h"
 
 void Index::iterator::operator++() {
@@ -111,6 +160,7 @@ void Index::iterator::operator++() {
 		first = false;
 		++iter;
 	}
+	asof = ix->db->tran_asof(tran);
 	while (!iter.eof() && (iter->adr() >= prevsize || !visible()))
 		++iter;
 	if (!iter.eof() && iter->key.prefixgt(to))
@@ -148,6 +198,7 @@ void Index::iterator::operator--() {
 			tranread->end = to;
 	} else if (!iter.eof())
 		--iter;
+	asof = ix->db->tran_asof(tran);
 	while (!iter.eof() && !visible())
 		--iter;
 	prevsize = ix->db->mmf->size();
@@ -445,3 +496,89 @@ TEST(index_multi) {
 
 	verify(thedb->commit(t));
 }
+
+TEST(index_visibility) {
+	TempDB tempdb;
+	thedb->add_table("test");
+	thedb->add_column("test", "name");
+	thedb->add_index("test", "name", true);
+	Index* index = thedb->get_index("test", "name");
+
+	int t1 = thedb->transaction(READWRITE);
+	thedb->add_record(t1, "test", record("joe"));
+	int t2 = thedb->transaction(READONLY);
+	verify(!index->begin(t1, key("joe")).eof()); // own create
+	verify(index->begin(t2, key("joe")).eof());  // uncommitted
+	verify(thedb->commit(t1));
+	verify(index->begin(t2, key("joe")).eof()); // committed after t2 began
+
+	int t3 = thedb->transaction(READWRITE);
+	verify(!index->begin(t3, key("joe")).eof());
+	thedb->remove_record(t3, "test", "name", key("joe"));
+	verify(index->begin(t3, key("joe")).eof()); // own delete
+	verify(thedb->commit(t3));
+	verify(thedb->commit(t2));
+
+	int t4 = thedb->transaction(READONLY);
+	verify(index->begin(t4, key("joe")).eof());
+	verify(thedb->commit(t4));
+}
+
+#include "ostreamstr.h"
+
+// scan an index while other transactions have outstanding versions
+// half the writers are committed (but not yet finalized) and half are not
+static void scan_with_writers(int64_t nreps, int nwriters) {
+	TempDB tempdb;
+	thedb->add_table("test");
+	thedb->add_column("test", "name");
+	thedb->add_index("test", "name", true);
+	const int N = 10000;
+	int t = thedb->transaction(READWRITE);
+	for (int i = 0; i < N; ++i) {
+		OstreamStr os;
+		os << "r" << i;
+		thedb->add_record(t, "test", record(os.str()));
+	}
+	verify(thedb->commit(t));
+	// an older reader keeps committed writes from being finalized
+	int reader = thedb->transaction(READONLY);
+	std::vector<int> writers;
+	for (int w = 0; w < nwriters; ++w) {
+		t = thedb->transaction(READWRITE);
+		OstreamStr os;
+		os << "w" << w;
+		thedb->add_record(t, "test", record(os.str()));
+		OstreamStr os2;
+		os2 << "r" << w * (N / nwriters);
+		thedb->remove_record(t, "test", "name", key(os2.str()));
+		if (w % 2)
+			verify(thedb->commit(t));
+		else
+			writers.push_back(t);
+	}
+	Index* index = thedb->get_index("test", "name");
+	while (nreps-- > 0) {
+		t = thedb->transaction(READONLY);
+		int n = 0;
+		for (Index::iterator iter = index->begin(t); !iter.eof(); ++iter)
+			++n;
+		assert_eq(n, N);
+		verify(thedb->commit(t));
+	}
+	for (int w : writers)
+		thedb->abort(w);
+	verify(thedb->commit(reader));
+}
+
+BENCHMARK(index_scan) {
+	scan_with_writers(nreps, 0);
+}
+
+BENCHMARK(index_scan_few_writers) {
+	scan_with_writers(nreps, 10);
+}
+
+BENCHMARK(index_scan_many_writers) {
+	scan_with_writers(nreps, 1000);
+}
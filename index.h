@@ -6,12 +6,15 @@
 #include "slots.h"
 #include "mmtypes.h"
 #include <climits>
+#include <vector>
 
 extern Record keymin;
 extern Record keymax;
 
 struct TranRead;
+class TempRuns;
 typedef int TblNum;
+typedef int TranTime;
 
 struct IndexDest {
 	explicit IndexDest(Mmfile* m) : mmf(m) {
@@ -29,7 +32,7 @@ struct IndexDest {
 	Mmfile* mmf;
 };
 
-typedef Btree<Vslot, VFslot, Vslots, VFslots, IndexDest> IndexBtree;
+typedef Btree<Vslot, VFslot, Pslots, VFslots, IndexDest> IndexBtree;
 
 class Database;
 
@@ -43,6 +46,8 @@ public:
 		int nn, bool k, bool u = false);
 
 	bool insert(int tran, Vslot x);
+	Key load(std::vector<Key>& keys);
+	Key load(TempRuns& runs);
 	bool erase(const Key& key) {
 		return bt.erase(key);
 	}
@@ -82,6 +87,7 @@ public:
 		IndexBtree::iterator iter;
 		Mmoffset prevsize = 0;
 		int tran = 0;
+		TranTime asof = 0; // of tran, looked up once per ++ or --
 		Key from;
 		Key to;
 		bool rewound = true;
@@ -31,6 +31,7 @@ Value Frame::fetch_member() {
 }
 
 static bool catch_match(const char*, const char*);
+static bool compare(int op, Value x, Value y);
 
 int callnest = 0;
 
@@ -185,16 +186,40 @@ Value Frame::run() {
 			case I_PUSH_LITERAL | 5:
 			case I_PUSH_LITERAL | 6:
 			case I_PUSH_LITERAL | 7:
-			case I_PUSH_LITERAL | 8:
-			case I_PUSH_LITERAL | 9:
-			case I_PUSH_LITERAL | 10:
-			case I_PUSH_LITERAL | 11:
-			case I_PUSH_LITERAL | 12:
-			case I_PUSH_LITERAL | 13:
-			case I_PUSH_LITERAL | 14:
-			case I_PUSH_LITERAL | 15:
-				PUSH(fn->literals[op & 15]);
+				PUSH(fn->literals[op & 7]);
 				break;
+			case I_INC_AUTO:
+			case I_DEC_AUTO:
+				i = fetch_local();
+				arg = local[i];
+				if (!arg)
+					except("uninitialized variable: " << symstr(
+							   fn->locals[i]));
+				if (arg.is_int())
+					local[i] = Value::from_int64(
+						int64_t(arg.intval()) + (op == I_INC_AUTO ? 1 : -1));
+				else
+					local[i] = op == I_INC_AUTO ? arg + SuOne : arg - SuOne;
+				break;
+			case I_JUMP_AUTO_INT:
+			case I_JUMP_AUTO_AUTO: {
+				jump = fetch_jump();
+				uint8_t* target = ip + jump;
+				int cmp = fetch1();
+				arg = local[i = fetch_local()];
+				if (!arg)
+					except("uninitialized variable: " << symstr(
+							   fn->locals[i]));
+				Value y;
+				if (op == I_JUMP_AUTO_INT)
+					y = (short) fetch2();
+				else if (!((y = local[i = fetch_local()])))
+					except("uninitialized variable: " << symstr(
+							   fn->locals[i]));
+				if (!compare(cmp, arg, y))
+					ip = target;
+				break;
+			}
 			case I_PUSH_AUTO | 0:
 			case I_PUSH_AUTO | 1:
 			case I_PUSH_AUTO | 2:
@@ -716,13 +741,22 @@ Value Frame::run() {
 			case I_NOT:
 				TOP() = TOP().toBool() ? SuFalse : SuTrue;
 				break;
+			// the int cases are handled here to avoid calls
 			case I_ADD:
 				arg = POP();
-				TOP() = TOP() + arg;
+				if (TOP().is_int() && arg.is_int())
+					TOP() = Value::from_int64(
+						int64_t(TOP().intval()) + arg.intval());
+				else
+					TOP() = TOP() + arg;
 				break;
 			case I_SUB:
 				arg = POP();
-				TOP() = TOP() - arg;
+				if (TOP().is_int() && arg.is_int())
+					TOP() = Value::from_int64(
+						int64_t(TOP().intval()) - arg.intval());
+				else
+					TOP() = TOP() - arg;
 				break;
 			case I_CAT:
 				arg = POP();
@@ -742,15 +776,24 @@ Value Frame::run() {
 				break;
 			case I_IS:
 				arg = POP();
-				TOP() = TOP() == arg ? SuTrue : SuFalse;
+				if (TOP().is_int() && arg.is_int())
+					TOP() = TOP().sameAs(arg) ? SuTrue : SuFalse;
+				else
+					TOP() = TOP() == arg ? SuTrue : SuFalse;
 				break;
 			case I_ISNT:
 				arg = POP();
-				TOP() = TOP() != arg ? SuTrue : SuFalse;
+				if (TOP().is_int() && arg.is_int())
+					TOP() = TOP().sameAs(arg) ? SuFalse : SuTrue;
+				else
+					TOP() = TOP() != arg ? SuTrue : SuFalse;
 				break;
 			case I_LT:
 				arg = POP();
-				TOP() = TOP() < arg ? SuTrue : SuFalse;
+				if (TOP().is_int() && arg.is_int())
+					TOP() = TOP().intval() < arg.intval() ? SuTrue : SuFalse;
+				else
+					TOP() = TOP() < arg ? SuTrue : SuFalse;
 				break;
 			case I_LTE:
 				arg = POP();
@@ -843,6 +886,46 @@ static bool catch_match(const char* s, const char* exception) {
 	return false;
 }
 
+// for I_JUMP_AUTO_INT and I_JUMP_AUTO_AUTO
+static bool compare(int op, Value x, Value y) {
+	if (x.is_int() && y.is_int()) {
+		int a = x.intval();
+		int b = y.intval();
+		switch (op) {
+		case I_LT:
+			return a < b;
+		case I_LTE:
+			return a <= b;
+		case I_GT:
+			return a > b;
+		case I_GTE:
+			return a >= b;
+		case I_IS:
+			return a == b;
+		case I_ISNT:
+			return a != b;
+		default:
+			unreachable();
+		}
+	}
+	switch (op) {
+	case I_LT:
+		return x < y;
+	case I_LTE:
+		return x <= y;
+	case I_GT:
+		return x > y;
+	case I_GTE:
+		return x >= y;
+	case I_IS:
+		return x == y;
+	case I_ISNT:
+		return x != y;
+	default:
+		unreachable();
+	}
+}
+
 inline Value getdata(Value ob, Value m) {
 	Value x = ob.getdata(m);
 	if (!x)
@@ -2,6 +2,8 @@
 // Copyright (c) 2000 Suneido Software Corp. All rights reserved
 // Licensed under GPLv2
 
+#include <cstdint>
+
 // abstract base class for input streams
 class Istream {
 public:
@@ -28,8 +30,8 @@ public:
 	int gcount() const {
 		return gcnt;
 	}
-	virtual int tellg() = 0;
-	virtual Istream& seekg(int pos) = 0;
+	virtual int64_t tellg() = 0;
+	virtual Istream& seekg(int64_t pos) = 0;
 
 protected:
 	virtual int get_() = 0;
@@ -4,6 +4,14 @@
 #include "istreamfile.h"
 #include <cstdio>
 
+#ifdef _MSC_VER
+#define FSEEK64 _fseeki64
+#define FTELL64 _ftelli64
+#else
+#define FSEEK64 fseeko64
+#define FTELL64 ftello64
+#endif
+
 class IstreamFileImp {
 public:
 	explicit IstreamFileImp(const char* filename, const char* mode = "r")
@@ -18,17 +26,17 @@ public:
 	int get() const {
 		return f ? fgetc(f) : -1;
 	}
-	int tellg() const {
-		return ftell(f);
+	int64_t tellg() const {
+		return FTELL64(f);
 	}
-	void seekg(int pos) const {
-		fseek(f, pos, SEEK_SET);
+	void seekg(int64_t pos) const {
+		FSEEK64(f, pos, SEEK_SET);
 	}
 	int read(char* buf, int n) const {
 		return fread(buf, 1, n, f);
 	}
 	int size() const {
-		int pos = tellg();
+		int64_t pos = tellg();
 		fseek(f, 0, SEEK_END);
 		int n = tellg();
 		seekg(pos);
@@ -51,11 +59,11 @@ int IstreamFile::get_() {
 	return imp->get();
 }
 
-int IstreamFile::tellg() {
+int64_t IstreamFile::tellg() {
 	return imp->tellg();
 }
 
-Istream& IstreamFile::seekg(int pos) {
+Istream& IstreamFile::seekg(int64_t pos) {
 	imp->seekg(pos);
 	return *this;
 }
@@ -11,8 +11,8 @@ class IstreamFile : public Istream {
 public:
 	explicit IstreamFile(const char* filename, const char* mode = "r");
 	~IstreamFile();
-	int tellg() override;
-	Istream& seekg(int pos) override;
+	int64_t tellg() override;
+	Istream& seekg(int64_t pos) override;
 	int size() const;
 	void close() const;
 
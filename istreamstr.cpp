@@ -11,10 +11,10 @@ public:
 	int get() {
 		return p < end ? *p++ : -1;
 	}
-	int tellg() const {
+	int64_t tellg() const {
 		return p - buf;
 	}
-	void seekg(int pos) {
+	void seekg(int64_t pos) {
 		p = buf + pos;
 	}
 	int read(char* dst, int n) {
@@ -42,11 +42,11 @@ int IstreamStr::get_() {
 	return imp->get();
 }
 
-int IstreamStr::tellg() {
+int64_t IstreamStr::tellg() {
 	return imp->tellg();
 }
 
-Istream& IstreamStr::seekg(int pos) {
+Istream& IstreamStr::seekg(int64_t pos) {
 	imp->seekg(pos);
 	return *this;
 }
@@ -11,8 +11,8 @@ class IstreamStr : public Istream {
 public:
 	explicit IstreamStr(const char* s);
 	IstreamStr(const char* buf, int n);
-	int tellg() override;
-	Istream& seekg(int pos) override;
+	int64_t tellg() override;
+	Istream& seekg(int64_t pos) override;
 
 protected:
 	int get_() override;
@@ -0,0 +1,707 @@
+// Copyright (c) 2000 Suneido Software Corp. All rights reserved
+// Licensed under GPLv2
+
+#include "libcache.h"
+#include "codeopt.h"
+#include "opcodes.h"
+#include "sufunction.h"
+#include "suclass.h"
+#include "suobject.h"
+#include "surecord.h"
+#include "sustring.h"
+#include "sunumber.h"
+#include "sudate.h"
+#include "suboolean.h"
+#include "globals.h"
+#include "symbols.h"
+#include "pack.h"
+#include "checksum.h"
+#include "cmdlineoptions.h"
+#include "exceptimp.h"
+#include "ostreamstr.h"
+#include "build.h"
+#include "compile.h"
+#include "port.h"
+#include "gc.h"
+#include <vector>
+#include <cstring>
+using std::vector;
+
+// Each value starts with a tag:
+// 'v' a packed number, string, date, or boolean
+// 's' a symbol
+// 'o' an object constant, 'r' a record constant
+// 'f' a function, 'c' a class
+// Ints are 4 bytes, strings are a length (-1 for nullptr) and the chars.
+// Global and symbol numbers in the code are saved as a list of
+// (offset, kind, name) which is applied when the code is loaded.
+
+class CodeWriter {
+public:
+	void value(Value x, const Named* parent = nullptr);
+	gcstring result() const {
+		return gcstring(buf.data(), buf.size());
+	}
+
+private:
+	void function(SuFunction* fn, const Named* parent);
+	void suclass(SuClass* c, const Named* parent);
+	void object(SuObject* ob);
+	void named(const Named& n, const Named* parent);
+	void code(SuFunction* fn);
+	const char* global(int gnum);
+	void put(const void* p, int n) {
+		auto s = static_cast<const char*>(p);
+		buf.insert(buf.end(), s, s + n);
+	}
+	void byte(int b) {
+		buf.push_back(b);
+	}
+	void putint(int n) {
+		put(&n, sizeof n);
+	}
+	void str(const char* s) {
+		if (!s)
+			return putint(-1);
+		int n = strlen(s);
+		putint(n);
+		put(s, n);
+	}
+
+	vector<char> buf;
+	int depth = 0;
+};
+
+gcstring packcode(Value x) {
+	CodeWriter w;
+	w.value(x);
+	return w.result();
+}
+
+void CodeWriter::value(Value x, const Named* parent) {
+	++depth;
+	if (auto fn = val_cast<SuFunction*>(x))
+		function(fn, parent);
+	else if (auto c = val_cast<SuClass*>(x))
+		suclass(c, parent);
+	else if (val_cast<SuRecord*>(x)) {
+		byte('r');
+		object(val_cast<SuObject*>(x));
+	} else if (auto ob = val_cast<SuObject*>(x)) {
+		byte('o');
+		object(ob);
+	} else if (!x.is_int() && is_symbol(x)) {
+		byte('s');
+		str(x.str());
+	} else if (x.is_int() || val_cast<SuNumber*>(x) ||
+		val_cast<SuString*>(x) || val_cast<SuDate*>(x) ||
+		val_cast<SuBoolean*>(x)) {
+		gcstring s = x.pack();
+		byte('v');
+		putint(s.size());
+		put(s.ptr(), s.size());
+	} else
+		except("packcode: can't save " << x.type());
+	--depth;
+}
+
+void CodeWriter::function(SuFunction* fn, const Named* parent) {
+	byte('f');
+	named(fn->named, parent);
+	putint(fn->nparams);
+	putint(fn->ndefaults);
+	byte(fn->rest);
+	byte(fn->isMethod);
+	str(fn->className);
+	byte(fn->flags != nullptr);
+	if (fn->flags)
+		put(fn->flags, fn->nparams);
+	putint(fn->nlocals);
+	for (int i = 0; i < fn->nlocals; ++i)
+		str(symstr(fn->locals[i]));
+	code(fn);
+	putint(fn->nd);
+	for (int i = 0; i < fn->nd; ++i) {
+		putint(fn->db[i].si);
+		putint(fn->db[i].ci);
+	}
+	putint(fn->nliterals);
+	for (int i = 0; i < fn->nliterals; ++i)
+		value(fn->literals[i], &fn->named);
+}
+
+static int get16(const uint8_t* p) {
+	return uint16_t(p[0] + (p[1] << 8));
+}
+
+void CodeWriter::code(SuFunction* fn) {
+	const uint8_t* code = fn->code;
+	putint(fn->nc);
+	put(code, fn->nc);
+	vector<int> globals_at;
+	vector<int> symbols_at;
+	for (int i = 0; i < fn->nc; i += insn_len(code + i)) {
+		int op = code[i];
+		if (op == I_SUPER || (I_CALL_GLOBAL <= op && op < I_CALL_MEM) ||
+			op == (I_PUSH | GLOBAL))
+			globals_at.push_back(i + 1);
+		else if ((op & 0xf8) == I_CALL) {
+			// LITERAL means the function is on the stack
+			int n = op == (I_CALL | LITERAL)
+				? 1
+				: 1 + target_len(op & 7, code + i + 1);
+			if ((op & 7) == GLOBAL)
+				globals_at.push_back(i + 1);
+			int nargnames = code[i + n + 1];
+			for (int j = 0; j < nargnames; ++j) {
+				int adr = i + n + 2 + 2 * j;
+				if (get16(code + adr) & 0x8000)
+					symbols_at.push_back(adr);
+			}
+		}
+	}
+	putint(globals_at.size() + symbols_at.size());
+	for (int adr : globals_at) {
+		putint(adr);
+		byte('g');
+		str(global(get16(code + adr)));
+	}
+	for (int adr : symbols_at) {
+		putint(adr);
+		byte('s');
+		str(symstr(get16(code + adr)));
+	}
+}
+
+// copies made for class : _Base can't be looked up by name
+const char* CodeWriter::global(int gnum) {
+	const char* name = globals(gnum);
+	if (*name == '_')
+		except("packcode: can't save reference to " << name);
+	return name;
+}
+
+void CodeWriter::suclass(SuClass* c, const Named* parent) {
+	byte('c');
+	str(c->base ? global(c->base) : nullptr);
+	named(c->named, parent);
+	putint(c->data.size());
+	for (auto [k, v] : c->data) {
+		value(k);
+		value(v, &c->named);
+	}
+}
+
+void CodeWriter::object(SuObject* ob) {
+	int n = ob->vecsize();
+	putint(n);
+	for (int i = 0; i < n; ++i)
+		value(ob->get(i));
+	putint(ob->mapsize());
+	for (auto it = ob->begin(false, true); it != ob->end(); ++it) {
+		auto [k, v] = *it;
+		value(k);
+		value(v);
+	}
+}
+
+// the top level name and library are set by libload
+void CodeWriter::named(const Named& n, const Named* parent) {
+	if (depth > 1 && n.lib != "")
+		except("packcode: can't save reference to " << n.name());
+	if (n.parent && n.parent != parent)
+		except("packcode: unexpected parent for " << n.name());
+	byte(n.parent != nullptr);
+	if (depth == 1 || n.num == 0)
+		str(nullptr);
+	else if (n.num & 0x8000)
+		str(symstr(n.num));
+	else
+		except("packcode: unexpected num for " << n.name());
+	str(n.str);
+}
+
+// CodeReader -------------------------------------------------------
+
+class CodeReader {
+public:
+	CodeReader(const gcstring& s, const char* src_)
+		: p(s.ptr()), lim(s.ptr() + s.size()), src(dupstr(src_)) {
+	}
+	Value value(const Named* parent = nullptr);
+	bool eof() const {
+		return p == lim;
+	}
+
+private:
+	SuFunction* function(const Named* parent);
+	SuClass* suclass(const Named* parent);
+	SuObject* object(SuObject* ob);
+	void named(Named& n, const Named* parent);
+	void code(SuFunction* fn);
+	const char* get(int n) {
+		if (lim - p < n)
+			except("unpackcode: bad data");
+		auto s = p;
+		p += n;
+		return s;
+	}
+	int byte() {
+		return static_cast<uint8_t>(*get(1));
+	}
+	int getint() {
+		int n;
+		memcpy(&n, get(sizeof n), sizeof n);
+		return n;
+	}
+	const char* str() {
+		int n = getint();
+		if (n < 0)
+			return nullptr;
+		char* s = salloc(n);
+		memcpy(s, get(n), n);
+		s[n] = 0;
+		return s;
+	}
+
+	const char* p;
+	const char* lim;
+	const char* src; // shared by all the functions
+};
+
+Value unpackcode(const gcstring& s, const char* src) {
+	CodeReader r(s, src);
+	Value x = r.value();
+	if (!r.eof())
+		except("unpackcode: bad data");
+	return x;
+}
+
+Value CodeReader::value(const Named* parent) {
+	switch (byte()) {
+	case 'f':
+		return function(parent);
+	case 'c':
+		return suclass(parent);
+	case 'o':
+		return object(new SuObject());
+	case 'r':
+		return object(new SuRecord());
+	case 's':
+		return symbol(str());
+	case 'v': {
+		int n = getint();
+		return ::unpack(gcstring(get(n), n));
+	}
+	default:
+		except("unpackcode: bad data");
+	}
+}
+
+SuFunction* CodeReader::function(const Named* parent) {
+	auto fn = new SuFunction;
+	named(fn->named, parent);
+	fn->nparams = getint();
+	fn->ndefaults = getint();
+	fn->rest = byte();
+	fn->isMethod = byte();
+	fn->className = str();
+	if (byte()) {
+		fn->flags = new (noptrs) char[fn->nparams];
+		memcpy(fn->flags, get(fn->nparams), fn->nparams);
+	}
+	fn->nlocals = getint();
+	fn->locals = new (noptrs) short[fn->nlocals];
+	for (int i = 0; i < fn->nlocals; ++i)
+		fn->locals[i] = symnum(str());
+	code(fn);
+	fn->nd = getint();
+	fn->db = static_cast<Debug*>(
+		static_cast<void*>(new (noptrs) char[fn->nd * sizeof(Debug)]));
+	for (int i = 0; i < fn->nd; ++i) {
+		int si = getint();
+		fn->db[i] = Debug(si, getint());
+	}
+	fn->nliterals = getint();
+	fn->literals = new Value[fn->nliterals];
+	for (int i = 0; i < fn->nliterals; ++i)
+		fn->literals[i] = value(&fn->named);
+	fn->src = src;
+	return fn;
+}
+
+void CodeReader::code(SuFunction* fn) {
+	fn->nc = getint();
+	fn->code = new (noptrs) uint8_t[fn->nc];
+	memcpy(fn->code, get(fn->nc), fn->nc);
+	for (int n = getint(); n > 0; --n) {
+		int adr = getint();
+		int kind = byte();
+		const char* name = str();
+		if (adr < 0 || adr + 2 > fn->nc || !name)
+			except("unpackcode: bad data");
+		int num = kind == 'g' ? globals(name) : symnum(name);
+		fn->code[adr] = num & 0xff;
+		fn->code[adr + 1] = (num >> 8) & 0xff;
+	}
+}
+
+SuClass* CodeReader::suclass(const Named* parent) {
+	const char* base = str();
+	auto c = new SuClass(base ? globals(base) : 0);
+	named(c->named, parent);
+	for (int i = getint(); i > 0; --i) {
+		Value k = value();
+		c->put(k, value(&c->named));
+	}
+	return c;
+}
+
+SuObject* CodeReader::object(SuObject* ob) {
+	for (int i = getint(); i > 0; --i)
+		ob->add(value());
+	for (int i = getint(); i > 0; --i) {
+		Value k = value();
+		ob->put(k, value());
+	}
+	ob->set_readonly();
+	return ob;
+}
+
+void CodeReader::named(Named& n, const Named* parent) {
+	n.parent = byte() ? parent : nullptr;
+	if (const char* s = str())
+		n.num = symnum(s);
+	n.str = str();
+}
+
+// LibCache ---------------------------------------------------------
+
+// entry layout: len, key, source hash, source size, data, checksum
+// the checksum at the end detects partial writes
+
+const int MAX_ENTRY = 64 * 1024 * 1024;
+
+// FNV-1a, 64 bits so a changed source is very unlikely to match
+static uint64_t hash64(
+	const void* p, size_t n, uint64_t h = 14695981039346656037ull) {
+	auto s = static_cast<const uint8_t*>(p);
+	for (size_t i = 0; i < n; ++i)
+		h = (h ^ s[i]) * 1099511628211ull;
+	return h;
+}
+
+// the build and the opcode table identify the bytecode format
+// change the version whenever the packcode or entry format changes
+static gcstring header() {
+	static gcstring hdr;
+	if (hdr.size() == 0) {
+		uint64_t h = hash64(nullptr, 0);
+		for (int i = 0; i < 256; ++i)
+			if (opcodes[i])
+				h = hash64(opcodes[i], strlen(opcodes[i]) + 1, h);
+		OstreamStr os;
+		os << "Suneido compiled library cache 3 " << build << " " << h
+		   << "\n";
+		hdr = os.gcstr();
+	}
+	return hdr;
+}
+
+// includes the options because they change the compiled code
+static gcstring make_key(const gcstring& lib, const char* name) {
+	return lib + ":" + name + ":" + compile_options();
+}
+
+LibCache::LibCache(const char* fname) : filename(dupstr(fname)) {
+	load();
+}
+
+Value LibCache::get(const gcstring& lib, const char* name, const char* src) {
+	Entry* e = entries.find(make_key(lib, name));
+	int srcsize = strlen(src);
+	if (!e || e->srcsize != srcsize || e->hash != hash64(src, srcsize))
+		return Value();
+	try {
+		return unpackcode(e->data, src);
+	} catch (const Except&) {
+		return Value();
+	}
+}
+
+void LibCache::put(
+	const gcstring& lib, const char* name, const char* src, Value x) {
+	Entry e;
+	try {
+		e.data = packcode(x);
+	} catch (const Except&) {
+		return; // e.g. dll or reference to a previous definition
+	}
+	e.srcsize = strlen(src);
+	e.hash = hash64(src, e.srcsize);
+	gcstring key = make_key(lib, name);
+	entries[key] = e;
+	if (f) {
+		write(key, e);
+		fflush(f);
+	}
+}
+
+void LibCache::close() {
+	if (f)
+		fclose(f);
+	f = nullptr;
+}
+
+void LibCache::load() {
+	FILE* fin = fopen(filename, "rb");
+	bool ok = false;
+	int nread = 0;
+	if (fin) {
+		gcstring expected = header();
+		int n = expected.size();
+		char* hdr = salloc(n);
+		ok = fread(hdr, 1, n, fin) == size_t(n) &&
+			0 == memcmp(hdr, expected.ptr(), n);
+		int len;
+		while (ok && fread(&len, sizeof len, 1, fin) == 1) {
+			uint32_t ck;
+			char* buf = 0 < len && len < MAX_ENTRY ? new (noptrs) char[len]
+												   : nullptr;
+			if (!buf || fread(buf, 1, len, fin) != size_t(len) ||
+				fread(&ck, sizeof ck, 1, fin) != 1 ||
+				ck != checksum(1, buf, len)) {
+				ok = false; // partial write or corrupt
+				break;
+			}
+			const char* s = buf;
+			gcstring key(s);
+			s += key.size() + 1;
+			Entry e;
+			if (buf + len - s < int(sizeof e.hash + sizeof e.srcsize)) {
+				ok = false;
+				break;
+			}
+			memcpy(&e.hash, s, sizeof e.hash);
+			s += sizeof e.hash;
+			memcpy(&e.srcsize, s, sizeof e.srcsize);
+			s += sizeof e.srcsize;
+			e.data = gcstring(s, buf + len - s);
+			entries[key] = e;
+			++nread;
+		}
+		fclose(fin);
+	}
+	// rewrite if invalid or if mostly out of date entries
+	// if another process is writing, f will be nullptr and we just read
+	if (!ok || nread > 2 * int(entries.size()) + 100)
+		rewrite();
+	else
+		f = fopen_denywrite(filename, "ab");
+}
+
+void LibCache::rewrite() {
+	if (!((f = fopen_denywrite(filename, "wb"))))
+		return;
+	gcstring hdr = header();
+	fwrite(hdr.ptr(), 1, hdr.size(), f);
+	for (auto& slot : entries)
+		write(slot.key, slot.val);
+	fflush(f);
+}
+
+void LibCache::write(const gcstring& key, const Entry& e) {
+	vector<char> buf(key.ptr(), key.ptr() + key.size());
+	buf.push_back(0);
+	auto add = [&buf](const void* p, int n) {
+		auto s = static_cast<const char*>(p);
+		buf.insert(buf.end(), s, s + n);
+	};
+	add(&e.hash, sizeof e.hash);
+	add(&e.srcsize, sizeof e.srcsize);
+	add(e.data.ptr(), e.data.size());
+	int len = buf.size();
+	uint32_t ck = checksum(1, buf.data(), len);
+	fwrite(&len, sizeof len, 1, f);
+	fwrite(buf.data(), 1, len, f);
+	fwrite(&ck, sizeof ck, 1, f);
+}
+
+// beside the executable, rather than in the current directory
+static const char* libcache_path() {
+	char buf[1024];
+	get_exe_path(buf, sizeof buf);
+	static const char name[] = "suneido.libcache";
+	char* p = buf + strlen(buf);
+	while (p > buf && p[-1] != '\\' && p[-1] != '/')
+		--p;
+	if (buf + sizeof buf - p < int(sizeof name))
+		return name;
+	memcpy(p, name, sizeof name);
+	return dupstr(buf);
+}
+
+LibCache* libcache() {
+	static LibCache* cache =
+		cmdlineoptions.no_libcache ? nullptr : new LibCache(libcache_path());
+	return cache;
+}
+
+// tests ------------------------------------------------------------
+
+#include "testing.h"
+#include "ostreamstr.h"
+
+static gcstring disasm(Value x) {
+	OstreamStr os;
+	force<SuFunction*>(x)->disasm(os);
+	return os.str();
+}
+
+static const char* classsrc = "class : Base1\n"
+							  "\t{\n"
+							  "\tName: #name\n"
+							  "\tList: (1, 2.5, 'three', #20200102, false)\n"
+							  "\tNew(.x, _dyn = 0)\n"
+							  "\t\t{\n"
+							  "\t\tsuper(x, named: dyn)\n"
+							  "\t\t}\n"
+							  "\tGet(n)\n"
+							  "\t\t{\n"
+							  "\t\tf = function (a) { a * 2 }\n"
+							  "\t\tfor (i = 0; i < n; ++i)\n"
+							  "\t\t\tGlobal1(.x, f(i), named: i)\n"
+							  "\t\treturn [a: 1, b: .List]\n"
+							  "\t\t}\n"
+							  "\t}";
+
+TEST(libcache_packcode) {
+	Value x = compile(classsrc, "Test1");
+	gcstring s = packcode(x);
+	verify(s.has("Global1"));
+	verify(s.has("Base1"));
+	Value y = unpackcode(s, classsrc);
+
+	auto c = force<SuClass*>(x);
+	auto c2 = force<SuClass*>(y);
+	assert_eq(c2->base, c->base);
+	assert_eq(c2->data.size(), c->data.size());
+	for (auto [k, v] : c->data) {
+		Value v2 = c2->get(k);
+		if (val_cast<SuFunction*>(v)) {
+			assert_eq(disasm(v2), disasm(v));
+			auto fn = val_cast<SuFunction*>(v2);
+			verify(fn->named.parent == &c2->named);
+			assert_eq(fn->isMethod, true);
+		} else
+			assert_eq(v2, v);
+	}
+	verify(c2->get("Name").ptr() == symbol("name").ptr());
+	verify(force<SuObject*>(c2->get("List"))->get_readonly());
+
+	// nested function assigned to a local
+	auto get = force<SuFunction*>(c2->get("Get"));
+	SuFunction* f = nullptr;
+	for (int i = 0; i < get->nliterals && !f; ++i)
+		f = val_cast<SuFunction*>(get->literals[i]);
+	verify(f && f->named.parent == &get->named);
+	assert_eq(f->named.num, symnum("f"));
+	verify(f->src == get->src);
+}
+
+TEST(libcache_cantpack) {
+	const char* src = "class : _Test2 { }";
+	globals.put("Test2", Value(123));
+	Value x = compile(src, "Test2");
+	xassert(packcode(x));
+	globals.put("Test2", Value());
+}
+
+TEST(libcache_file) {
+	extern char* tmpfilename();
+	char* filename = tmpfilename();
+	const char* src = "function (x) { Global1(x) + 1 }";
+	{
+		LibCache cache(filename);
+		verify(!cache.get("stdlib", "Test1", src));
+		cache.put("stdlib", "Test1", src, compile(src));
+		verify(cache.get("stdlib", "Test1", src));
+		cache.close();
+	}
+	{
+		LibCache cache(filename);
+		Value x = cache.get("stdlib", "Test1", src);
+		assert_eq(disasm(x), disasm(compile(src)));
+		verify(!cache.get("mylib", "Test1", src));
+		verify(!cache.get(
+			"stdlib", "Test1", "function (x) { Global1(x) + 2 }"));
+		cache.close();
+	}
+	remove(filename);
+}
+
+TEST(libcache_shared) {
+	extern char* tmpfilename();
+	char* filename = tmpfilename();
+	const char* src = "function (x) { Global1(x) + 1 }";
+	{
+		LibCache cache1(filename);
+		LibCache cache2(filename); // can only read while cache1 writes
+		cache1.put("stdlib", "Test1", src, compile(src));
+		cache2.put("stdlib", "Test2", src, compile(src));
+		verify(cache2.get("stdlib", "Test2", src)); // still in memory
+		cache2.close();
+		cache1.close();
+	}
+	{
+		LibCache cache(filename);
+		verify(cache.get("stdlib", "Test1", src));
+		verify(!cache.get("stdlib", "Test2", src));
+		cache.close();
+	}
+
+	// a cache from a different build is discarded
+	FILE* f = fopen(filename, "r+b");
+	verify(f);
+	fputs("Suneido compiled library cache 1\n", f);
+	fclose(f);
+	{
+		LibCache cache(filename);
+		verify(!cache.get("stdlib", "Test1", src));
+		cache.close();
+	}
+	remove(filename);
+}
+
+TEST(libcache_options) {
+	extern char* tmpfilename();
+	char* filename = tmpfilename();
+	const char* src = "function (x) { switch (x) { case 1: return 2 } }";
+	auto suneido = val_cast<SuObject*>(globals["Suneido"]);
+	verify(suneido);
+	LibCache cache(filename);
+	cache.put("stdlib", "Test1", src, compile(src));
+	verify(cache.get("stdlib", "Test1", src));
+
+	suneido->put("SwitchUnhandledThrow", SuFalse);
+	verify(!cache.get("stdlib", "Test1", src));
+	Value x = compile(src);
+	cache.put("stdlib", "Test1", src, x);
+	assert_eq(disasm(cache.get("stdlib", "Test1", src)), disasm(x));
+	suneido->erase("SwitchUnhandledThrow");
+
+	verify(disasm(cache.get("stdlib", "Test1", src)) != disasm(x));
+	cache.close();
+	remove(filename);
+}
+
+BENCHMARK(libcache_compile) {
+	while (nreps-- > 0)
+		compile(classsrc, "Test1");
+}
+
+BENCHMARK(libcache_unpack) {
+	gcstring s = packcode(compile(classsrc, "Test1"));
+	while (nreps-- > 0)
+		unpackcode(s, classsrc);
+}
@@ -0,0 +1,48 @@
+#pragma once
+// Copyright (c) 2000 Suneido Software Corp. All rights reserved
+// Licensed under GPLv2
+
+#include "value.h"
+#include "gcstring.h"
+#include "hashmap.h"
+#include <cstdio>
+
+// serialized compiled code - SuFunction, SuClass, and constants
+// global and symbol numbers are saved as names
+// so the result can be loaded by a different process
+// throws if x contains something that can't be saved (e.g. dll)
+gcstring packcode(Value x);
+
+// src must be the source x was compiled from, functions refer to it
+Value unpackcode(const gcstring& s, const char* src);
+
+// a persistent cache of compiled library records, stored in a file
+// entries are keyed on library and name
+// and are only used if the hash and size of the source still match
+// only one process at a time writes to the file, others just read it
+class LibCache {
+public:
+	explicit LibCache(const char* filename);
+	// returns Value() if not cached or the source has changed
+	Value get(const gcstring& lib, const char* name, const char* src);
+	// does nothing if x can't be saved
+	void put(const gcstring& lib, const char* name, const char* src, Value x);
+	void close();
+
+private:
+	struct Entry {
+		uint64_t hash = 0;
+		int srcsize = 0;
+		gcstring data;
+	};
+	void load();
+	void rewrite();
+	void write(const gcstring& key, const Entry& e);
+
+	const char* filename;
+	FILE* f = nullptr;
+	HashMap<gcstring, Entry> entries;
+};
+
+// the cache used by libload, nullptr if disabled or not available
+LibCache* libcache();
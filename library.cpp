@@ -3,6 +3,7 @@
 
 #include "library.h"
 #include "compile.h"
+#include "libcache.h"
 #include "interp.h"
 #include "globals.h"
 #include "named.h"
@@ -65,7 +66,14 @@ void libload(int gnum) {
 				src = ps->str();
 			else
 				src = (*srcs).str();
-			Value x = compile(src, gname);
+			// use the saved compiled code if the source hasn't changed
+			LibCache* cache = libcache();
+			Value x = cache ? cache->get(lib, gname, src) : Value();
+			if (!x) {
+				x = compile(src, gname);
+				if (cache)
+					cache->put(lib, gname, src, x);
+			}
 			if (Named* n = const_cast<Named*>(x.get_named())) {
 				n->lib = lib;
 				n->num = gnum;
@@ -2,7 +2,7 @@
 // Licensed under GPLv2
 
 #include "load.h"
-#include "istreamfile.h"
+#include "fileasync.h"
 #include "database.h"
 #include "thedb.h"
 #include "record.h"
@@ -23,8 +23,8 @@ static void verifyFileHeader(const char* buf);
 static int load1(Istream& fin, gcstring tblspec);
 static int load_data(Istream& fin, const gcstring& table);
 static int read_size(Istream& fin);
-static void load_data_record(
-	Istream& fin, const gcstring& table, int tran, int n);
+static Mmoffset load_data_record(Istream& fin, const gcstring& table,
+	Tbl* tbl, int tran, int n, Database::LoadKeys& keys);
 static bool alerts = false;
 
 struct Loading {
@@ -42,6 +42,19 @@ struct Loading {
 	}
 };
 
+// blocks other writers to the table until its indexes are built
+struct LoadingTable {
+	explicit LoadingTable(Tbl* tbl) : tblnum(tbl ? tbl->num : 0) {
+		if (tblnum)
+			theDB()->begin_load(tblnum);
+	}
+	~LoadingTable() {
+		if (tblnum)
+			theDB()->end_load(tblnum);
+	}
+	TblNum tblnum;
+};
+
 extern bool thedb_create;
 
 void load(const gcstring& table) {
@@ -52,7 +65,7 @@ void load(const gcstring& table) {
 	} else { // load entire database
 		const size_t bufsize = 8000;
 		char buf[bufsize];
-		IstreamFile fin("database.su", "rb");
+		IstreamFileAsync fin("database.su");
 		if (!fin)
 			except("can't open database.su");
 		fin.getline(buf, bufsize);
@@ -78,7 +91,7 @@ void load(const gcstring& table) {
 int load_table(const gcstring& table) {
 	const size_t bufsize = 8000;
 	char buf[bufsize];
-	IstreamFile fin((table + ".su").str(), "rb");
+	IstreamFileAsync fin((table + ".su").str());
 	if (!fin)
 		except("can't open " << table << ".su");
 	fin.getline(buf, bufsize);
@@ -116,20 +129,39 @@ static int load1(Istream& fin, gcstring tblspec) {
 
 const int recsPerTran = 50;
 
+// records are checked and output without updating indexes
+// then the indexes are built in bulk (except for views)
+// records with duplicate keys or missing foreign keys are skipped
 static int load_data(Istream& fin, const gcstring& table) {
+	if (table != "views" && Database::is_system_table(table))
+		except("load: can't add records to system table: " << table);
+	Tbl* tbl = table == "views" ? nullptr : theDB()->ck_get_table(table);
+	LoadingTable loading(tbl);
+	if (tbl && tbl->nrecords)
+		except("load: " << table << " is not empty");
+	Database::LoadKeys keys;
+	Mmoffset first = 0;
+	Mmoffset last = 0;
 	int nrecs = 0;
 	int tran = theDB()->transaction(READWRITE);
 	for (;; ++nrecs) {
 		int n = read_size(fin);
 		if (n == 0)
 			break;
-		load_data_record(fin, table, tran, n);
+		if (Mmoffset off =
+				load_data_record(fin, table, tbl, tran, n, keys)) {
+			last = off;
+			if (!first)
+				first = off;
+		}
 		if (nrecs % recsPerTran == recsPerTran - 1) {
 			verify(theDB()->commit(tran));
 			tran = theDB()->transaction(READWRITE);
 		}
 	}
 	verify(theDB()->commit(tran));
+	if (tbl)
+		theDB()->create_indexes(tbl, first, last);
 	return nrecs;
 }
 
@@ -143,8 +175,8 @@ static int read_size(Istream& fin) {
 	return n;
 }
 
-static void load_data_record(
-	Istream& fin, const gcstring& table, int tran, int n) {
+static Mmoffset load_data_record(Istream& fin, const gcstring& table,
+	Tbl* tbl, int tran, int n, Database::LoadKeys& keys) {
 	try {
 		if (n > loadbuf_size) {
 			loadbuf_size = max(n, 2 * loadbuf_size);
@@ -157,13 +189,19 @@ static void load_data_record(
 		if (rec.cursize() != n)
 			except_err(table << ": rec size " << rec.cursize()
 							 << " not what was read " << n);
-		if (table == "views")
+		if (!tbl) {
 			theDB()->add_any_record(tran, table, rec);
-		else
-			theDB()->add_record(tran, table, rec);
+			return 0;
+		}
+		if (rec.size() > tbl->nextfield)
+			except_err(table << ": record has more fields (" << rec.size()
+							 << ") than it should (" << tbl->nextfield << ")");
+		theDB()->load_check(tran, tbl, rec, keys);
+		return theDB()->output_record(tran, tbl, rec);
 	} catch (const Except& e) {
 		errlog("load: skipping corrupted record in: ", table.str(), e.str());
 		alert("skipping corrupted record in: " << table << ": " << e);
 		alerts = true;
 	}
+	return 0;
 }
@@ -116,7 +116,7 @@ Value MemBase::MemberQ(BuiltinArgs& args) {
 	Value m = args.getValue("member");
 	args.end();
 	Value x = lookup([m](MemBase* mb) -> Value {
-		return mb->data.find(m) ? SuTrue : Value();
+		return mb->memfind(m) ? SuTrue : Value();
 	});
 	return x ? SuTrue : SuFalse;
 }
@@ -165,7 +165,7 @@ Value MemBase::method_lookup(BuiltinArgs& args) {
 
 Value MemBase::method_class(Value m) {
 	return lookup([m](MemBase* mb) -> Value {
-		if (Value* pv = mb->data.find(m))
+		if (Value* pv = mb->memfind(m))
 			return val_cast<SuFunction*>(*pv) ? mb : SuFalse;
 		return Value();
 	});
@@ -178,5 +178,5 @@ Value MemBase::ReadonlyQ(BuiltinArgs& args) {
 
 Value MemBase::Size(BuiltinArgs& args) {
 	args.usage(".Size()").end();
-	return data.size();
+	return memsize();
 }
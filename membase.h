@@ -16,7 +16,6 @@ public:
 private:
 	template <typename Finder>
 	Value lookup(Finder finder);
-	void addMembersTo(SuObject* ob);
 	Value method_lookup(BuiltinArgs& args);
 
 protected:
@@ -40,6 +39,14 @@ protected:
 	virtual Value mbclass() = 0; // SuInstance.myclass or SuClass this
 	virtual Value parent() = 0;  // SuInstance.myclass or SuClass.base
 	virtual bool readonly() = 0;
+	// overridden by SuInstance which doesn't always use data
+	virtual Value* memfind(Value m) const {
+		return data.find(m);
+	}
+	virtual int memsize() const {
+		return data.size();
+	}
+	virtual void addMembersTo(SuObject* ob);
 
 	Hmap<Value, Value> data;
 };
@@ -23,7 +23,6 @@ inline void Mmfile::set_file_size(Mmoffset fs) {
 
 Mmfile::Mmfile(const char* filename, bool create, bool ro) : readonly(ro) {
 	verify((1 << MM_SHIFT) < MM_ALIGN);
-	std::fill(base, base + MAX_CHUNKS, nullptr);
 	open(filename, create, readonly);
 	verify(file_size >= 0);
 	verify(file_size < (int64_t) MB_MAX_DB * 1024 * 1024);
@@ -45,18 +44,22 @@ void Mmfile::refresh() {
 }
 
 // blocks have a 4 byte header of size | type
-// and a 4 byte trailer
+// and a 4 byte trailer of size ^ (low 32 bits of) adr
+// NOTE: uint32_t rather than size_t so the format is the same for 64 bit
 
 inline size_t len(void* p) {
-	return p ? ((size_t*) p)[-1] & ~(MM_ALIGN - 1) : 0;
+	return p ? ((uint32_t*) p)[-1] & ~(MM_ALIGN - 1) : 0;
 }
 
 inline char typ(void* p) {
-	return p ? ((size_t*) p)[-1] & (MM_ALIGN - 1) : 0;
+	return p ? ((uint32_t*) p)[-1] & (MM_ALIGN - 1) : 0;
 }
 
 Mmoffset Mmfile::alloc(size_t n, char t, bool zero) {
 	verify(n < chunk_size);
+	// before allocating, so the previous blocks have been filled in
+	if (flusher && file_size - flush_requested >= dirty_limit)
+		flush();
 	last_alloc = n;
 	n = align(n);
 
@@ -80,10 +83,10 @@ Mmoffset Mmfile::alloc(size_t n, char t, bool zero) {
 	if (zero)
 		memset((char*) p - MM_HEADER, 0, n + MM_OVERHEAD); // zero block
 	// header
-	((size_t*) p)[-1] = n | t;
+	((uint32_t*) p)[-1] = n | t;
 	// trailer
 	void* q = (char*) p + n;
-	*((size_t*) q) = n ^ (offset + n);
+	*((uint32_t*) q) = n ^ (uint32_t) (offset + n);
 	// verify(mmcheck(offset) == MMOK);
 	return offset;
 }
@@ -101,6 +104,8 @@ void* Mmfile::adr(Mmoffset offset) {
 	verify(offset < file_size);
 	unsigned int chunk = offset / chunk_size;
 	verify(chunk < MAX_CHUNKS);
+	if (chunk >= base.size())
+		base.resize(chunk + 1);
 	if (!base[chunk]) {
 		map(chunk);
 		if (chunk > hi_chunk)
@@ -138,8 +143,8 @@ MmCheck Mmfile::mmcheck(Mmoffset o) {
 		return MMERR;
 	// TODO: check if off + n is in different chunk
 	void* q = (char*) p + n;
-	if (o + n + sizeof(size_t) > file_size ||
-		*((size_t*) q) != (n ^ (unsigned) (o + n)))
+	if (o + n + sizeof(uint32_t) > file_size ||
+		*((uint32_t*) q) != (n ^ (uint32_t) (o + n)))
 		return MMERR;
 	return MMOK;
 }
@@ -172,7 +177,7 @@ Mmfile::iterator& Mmfile::iterator::operator--() {
 			return *this;
 		}
 		void* p = mmf->adr(off);
-		size_t n = *((size_t*) p) ^ off;
+		size_t n = *((uint32_t*) p) ^ (uint32_t) off;
 		// TODO: check if off - n is in different chunk
 		if (n > MB_PER_CHUNK * 1024 * 1024 ||
 			n > off) { // shouldn't this be chunk_size ?
@@ -279,3 +284,20 @@ TEST(mmfile_chunks) {
 	}
 	verify(0 == remove("testmm"));
 }
+
+TEST(mmfile_flush_all) {
+	const int chunk_size = 65536;
+	remove("testmm");
+	{
+		Mmfile m("testmm", true);
+		m.set_chunk_size(chunk_size);
+		m.flush_behind(chunk_size);
+		for (int i = 0; i < 300; ++i) // one block per chunk
+			m.alloc(60000, 1);
+		m.flush_all(); // queues every chunk
+		Mmoffset end = m.size();
+		m.wait_flushed(end);
+		verify(m.flushed(end));
+	}
+	verify(0 == remove("testmm"));
+}
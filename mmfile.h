@@ -5,6 +5,7 @@
 #include "std.h"
 #include "mmoffset.h"
 #include <cstddef> // for size_t
+#include <vector>
 
 const int MM_HEADER = 4;  // size | type
 const int MM_TRAILER = 4; // size ^ adr
@@ -17,6 +18,7 @@ const int MB_PER_CHUNK = 4;
 enum MmCheck { MMOK, MMEOF, MMERR };
 
 class test_mmfile;
+class Flusher;
 
 class Mmfile {
 public:
@@ -38,6 +40,15 @@ public:
 	Mmoffset get_file_size();
 	void refresh();
 
+	// background flushing (implemented in port)
+	// once started, alloc queues what was appended whenever more than
+	// dirty_limit has accumulated, so the eventual flushes are small
+	void flush_behind(int64_t dirty_limit);
+	void flush();     // queue what was appended since the last flush
+	void flush_all(); // queue all the mapped chunks
+	bool flushed(Mmoffset off);
+	void wait_flushed(Mmoffset off);
+
 	void sync();
 
 	void* first();
@@ -81,19 +92,25 @@ private:
 	void unmap(int chunk);
 	void set_file_size(Mmoffset fs);
 	friend void test_mmfile_chunks();
+	friend void test_mmfile_flush_all();
 
+	// chunks stay mapped, so this is limited by the 32 bit address space
+	// and mmoffset_to_int packs offsets into an int
 	enum { MB_MAX_DB = 2 * 1024 }; // 2 gb
 	enum { MAX_CHUNKS = MB_MAX_DB / MB_PER_CHUNK };
 #ifdef _WIN32
 	void* f{};
-	void* fm[MAX_CHUNKS]{};
+	std::vector<void*> fm;
 #else
 	int fd;
 #endif
 	int chunk_size = MB_PER_CHUNK * 1024 * 1024;
 	Mmoffset file_size = 0;
-	char* base[MAX_CHUNKS]{};
+	std::vector<char*> base; // grows as chunks are mapped
 	int hi_chunk = 0;
 	int last_alloc{};
+	Flusher* flusher = nullptr;
+	int64_t dirty_limit = 0;
+	Mmoffset flush_requested = 0; // everything before this has been queued
 	bool readonly;
 };
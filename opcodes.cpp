@@ -9,8 +9,8 @@ const char* opcodes[256] = { //
 
 	"push literal", "push literal", "push literal", "push literal",
 	"push literal", "push literal", "push literal", "push literal",
-	"push literal", "push literal", "push literal", "push literal",
-	"push literal", "push literal", "push literal", "push literal",
+	"++ auto", "-- auto", "jump no auto int", "jump no auto auto", "", "",
+	"", "",
 
 	"push auto", "push auto", "push auto", "push auto", "push auto",
 	"push auto", "push auto", "push auto", "push auto", "push auto",
@@ -28,7 +28,12 @@ enum {
 	I_BLOCK,
 	I_PUSH_INT,
 
-	I_PUSH_LITERAL = 0x10,
+	I_PUSH_LITERAL = 0x10, // 0 to 7
+	// superinstructions from codeopt
+	I_INC_AUTO = 0x18,
+	I_DEC_AUTO,
+	I_JUMP_AUTO_INT, // compare auto with int, jump if false
+	I_JUMP_AUTO_AUTO,
 	I_PUSH_AUTO = 0x20,
 	I_BLOCK_THROW = 0x2e,
 	I_BOOL = 0x2f,
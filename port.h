@@ -2,6 +2,8 @@
 // Copyright (c) 2003 Suneido Software Corp. All rights reserved
 // Licensed under GPLv2
 
+#include <cstdio>
+
 void* mem_committed(int n);
 void* mem_uncommitted(int size);
 void mem_commit(void* p, int n);
@@ -14,3 +16,7 @@ void sync_timer(Mmfile* mmf);
 int fork_rebuild();
 
 void get_exe_path(char* buf, int buflen);
+
+// other processes can still read the file, but not open it for writing
+// returns nullptr if another process has it open for writing
+FILE* fopen_denywrite(const char* filename, const char* mode);
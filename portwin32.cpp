@@ -9,12 +9,18 @@
 #include "except.h"
 #include "mmfile.h"
 #include "fatal.h"
+#include <vector>
+#include <share.h> // for _SH_DENYWR
 #include "ostreamstr.h"
 
 void get_exe_path(char* buf, int buflen) {
 	GetModuleFileName(nullptr, buf, buflen);
 }
 
+FILE* fopen_denywrite(const char* filename, const char* mode) {
+	return _fsopen(filename, mode, _SH_DENYWR);
+}
+
 void* mem_committed(int n) {
 	void* p =
 		VirtualAlloc(nullptr, n, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
@@ -99,6 +105,8 @@ void Mmfile::open(const char* filename, bool create, bool ro) {
 
 void Mmfile::map(int chunk) {
 	verify(!base[chunk]);
+	if (chunk >= fm.size())
+		fm.resize(chunk + 1);
 
 	int64_t end = (int64_t)(chunk + 1) * chunk_size;
 	fm[chunk] = CreateFileMapping(f,
@@ -126,7 +134,7 @@ void Mmfile::map(int chunk) {
 }
 
 void Mmfile::unmap(int chunk) {
-	if (!base[chunk])
+	if (chunk >= base.size() || !base[chunk])
 		return;
 	// mlog << "- " << chunk << " = " << (void*) base[chunk] << endl;
 	UnmapViewOfFile(base[chunk]);
@@ -135,12 +143,13 @@ void Mmfile::unmap(int chunk) {
 }
 
 void Mmfile::sync() {
-	for (int i = 0; i <= hi_chunk; ++i)
+	for (int i = 0; i < base.size(); ++i)
 		if (base[i])
 			FlushViewOfFile(base[i], 0); // 0 means all
 }
 
 Mmfile::~Mmfile() {
+	delete flusher; // waits for any queued flushes
 	for (int i = 0; i <= hi_chunk; ++i)
 		unmap(i);
 
@@ -156,15 +165,157 @@ Mmfile::~Mmfile() {
 	CloseHandle(f);
 }
 
+// Flusher ----------------------------------------------------------
+
+// flushes (FlushViewOfFile) queued ranges on a separate thread
+// so the main thread doesn't stall on large flushes
+// NOTE: the thread must not allocate from the garbage collected heap
+// add blocks while the queue is full, so it is sized to hold
+// everything flush_all queues without waiting
+class Flusher {
+public:
+	Flusher(Mmoffset synced, int n) : qsize(n), q(n), flushed_(synced) {
+		InitializeCriticalSection(&cs);
+		wake = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		progress = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		thread = CreateThread(nullptr, 0, run, this, 0, nullptr);
+		verify(thread);
+	}
+	~Flusher() {
+		EnterCriticalSection(&cs);
+		stopping = true;
+		LeaveCriticalSection(&cs);
+		SetEvent(wake);
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+		CloseHandle(wake);
+		CloseHandle(progress);
+		DeleteCriticalSection(&cs);
+	}
+	// end is the file offset of the end of the range
+	void add(void* p, size_t n, Mmoffset end) {
+		for (;;) {
+			EnterCriticalSection(&cs);
+			if (count < qsize) {
+				q[(head + count++) % qsize] = Range{p, n, end};
+				LeaveCriticalSection(&cs);
+				SetEvent(wake);
+				return;
+			}
+			LeaveCriticalSection(&cs);
+			WaitForSingleObject(progress, INFINITE); // queue is full
+		}
+	}
+	// wait till the ranges up to off have been flushed
+	void wait(Mmoffset off) {
+		while (flushed() < off)
+			WaitForSingleObject(progress, INFINITE);
+	}
+	Mmoffset flushed() {
+		EnterCriticalSection(&cs);
+		Mmoffset off = flushed_;
+		LeaveCriticalSection(&cs);
+		return off;
+	}
+
+private:
+	static DWORD WINAPI run(LPVOID p) {
+		auto fl = static_cast<Flusher*>(p);
+		for (;;) {
+			WaitForSingleObject(fl->wake, INFINITE);
+			for (;;) {
+				EnterCriticalSection(&fl->cs);
+				if (fl->count == 0) {
+					bool stop = fl->stopping;
+					LeaveCriticalSection(&fl->cs);
+					if (stop)
+						return 0;
+					break;
+				}
+				Range r = fl->q[fl->head]; // not removed till flushed
+				LeaveCriticalSection(&fl->cs);
+				FlushViewOfFile(r.p, r.n);
+				EnterCriticalSection(&fl->cs);
+				fl->head = (fl->head + 1) % fl->qsize;
+				--fl->count;
+				if (r.end > fl->flushed_)
+					fl->flushed_ = r.end;
+				LeaveCriticalSection(&fl->cs);
+				SetEvent(fl->progress);
+			}
+		}
+	}
+
+	struct Range {
+		void* p;
+		size_t n;
+		Mmoffset end;
+	};
+	CRITICAL_SECTION cs;
+	HANDLE thread;
+	HANDLE wake;
+	HANDLE progress;
+	const int qsize;
+	std::vector<Range> q; // allocated by the main thread
+	int head = 0;
+	int count = 0;
+	Mmoffset flushed_;
+	bool stopping = false;
+};
+
+void Mmfile::flush_behind(int64_t limit) {
+	verify(!flusher);
+	dirty_limit = limit;
+	flush_requested = file_size; // synced at startup
+	// flush_all queues what flush does plus every chunk
+	flusher = new Flusher(file_size, 2 * MAX_CHUNKS);
+}
+
+void Mmfile::flush() {
+	if (!flusher)
+		return;
+	while (flush_requested < file_size) {
+		Mmoffset end = (flush_requested / chunk_size + 1) * chunk_size;
+		if (end > file_size)
+			end = file_size;
+		flusher->add(adr(flush_requested), end - flush_requested, end);
+		flush_requested = end;
+	}
+}
+
+// for blocks that were updated in place after being queued
+void Mmfile::flush_all() {
+	if (!flusher)
+		return sync();
+	flush();
+	for (int i = 0; i < base.size(); ++i)
+		if (base[i])
+			flusher->add(base[i], 0, 0); // 0 means all
+}
+
+bool Mmfile::flushed(Mmoffset off) {
+	return !flusher || flusher->flushed() >= off;
+}
+
+void Mmfile::wait_flushed(Mmoffset off) {
+	if (!flusher)
+		return sync();
+	flush();
+	flusher->wait(off);
+}
+
+const int64_t DIRTY_LIMIT = 4 * 1024 * 1024;
+
 static Mmfile* mmf;
 
 static VOID CALLBACK SyncTimerProc(
 	HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime) {
-	mmf->sync();
+	mmf->flush_all();
 }
 
 void sync_timer(Mmfile* m) {
 	mmf = m;
+	mmf->flush_behind(DIRTY_LIMIT);
 	SetTimer(nullptr, // handle to main window
 		0,            // timer identifier
 		60000,        // 1-minute interval
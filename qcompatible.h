@@ -14,6 +14,9 @@ public:
 	int columnsize() override {
 		return (source->columnsize() + source2->columnsize()) / 2;
 	}
+	bool needs_whole_rows() const override { // equal compares allcols
+		return disjoint == "";
+	}
 
 protected:
 	bool isdup(const Row& row);
@@ -9,6 +9,9 @@ using std::max;
 class Difference : public Compatible {
 public:
 	Difference(Query* s1, Query* s2);
+	Query* clone() const override {
+		return clone_sources(new Difference(*this));
+	}
 	void out(Ostream& os) const override;
 	Fields columns() override {
 		return source->columns();
@@ -60,7 +60,7 @@ Expr* Identifier::replace(const Fields& from, const Lisp<Expr*>& to) {
 }
 
 Value Identifier::eval(const Header& hdr, const Row& row) {
-	return row.getval(hdr, ident);
+	return row.getval(hdr, ref);
 }
 
 // UnOp -------------------------------------------------------------
@@ -196,7 +196,7 @@ Value BinOp::eval(const Header& hdr, const Row& row) {
 	if (isterm) {
 		Identifier* id = dynamic_cast<Identifier*>(left);
 		verify(id);
-		gcstring field = row.getraw(hdr, id->ident);
+		gcstring field = row.getraw(hdr, id->ref);
 		Constant* c = dynamic_cast<Constant*>(right);
 		verify(c);
 		gcstring value = c->packed;
@@ -387,7 +387,7 @@ Value In::eval(const Header& hdr, const Row& row) {
 	if (isterm) {
 		Identifier* id = dynamic_cast<Identifier*>(expr);
 		verify(id);
-		gcstring value = row.getraw(hdr, id->ident);
+		gcstring value = row.getraw(hdr, id->ref);
 		for (Lisp<gcstring> v = packed; !nil(v); ++v)
 			if (value == *v)
 				return SuTrue;
@@ -3,6 +3,7 @@
 // Licensed under GPLv2
 
 #include "qexpr.h"
+#include "row.h"
 
 struct Constant : public Expr {
 private:
@@ -39,7 +40,7 @@ public:
 };
 
 struct Identifier : public Expr {
-	explicit Identifier(const gcstring& s) : ident(s) {
+	explicit Identifier(const gcstring& s) : ident(s), ref(s) {
 	}
 	void out(Ostream& os) const override;
 	Fields fields() override {
@@ -54,6 +55,7 @@ struct Identifier : public Expr {
 	bool isfield(const Fields& fields) override;
 
 	gcstring ident;
+	ColRef ref; // bound to the header by the first eval
 };
 
 struct UnOp : public Expr {
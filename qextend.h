@@ -9,6 +9,9 @@ class Expr;
 class Extend : public Query1 {
 public:
 	Extend(Query* source, const Fields& f, Lisp<Expr*> e);
+	Query* clone() const override {
+		return clone_sources(new Extend(*this));
+	}
 	void fold();
 	void init();
 	void out(Ostream& os) const override;
@@ -8,6 +8,9 @@
 class HistoryTable : public Query {
 public:
 	explicit HistoryTable(const gcstring& table);
+	Query* clone() const override {
+		return new HistoryTable(*this);
+	}
 	void out(Ostream& os) const override;
 	Fields columns() override;
 	Indexes indexes() override;
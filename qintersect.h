@@ -7,6 +7,9 @@
 class Intersect : public Compatible {
 public:
 	Intersect(Query* s1, Query* s2);
+	Query* clone() const override {
+		return clone_sources(new Intersect(*this));
+	}
 	void out(Ostream& os) const override;
 	Fields columns() override {
 		return intersect(source->columns(), source2->columns());
@@ -3,7 +3,10 @@
 
 #include "qjoin.h"
 #include <algorithm>
+using std::max;
 #include "trace.h"
+#include "tempruns.h"
+#include "hashfn.h"
 
 Query* Query::make_join(Query* s1, Query* s2, Fields by) {
 	return new Join(s1, s2, by);
@@ -39,8 +42,9 @@ Join::Join(Query* s1, Query* s2, Fields by)
 
 static const char* typestr[] = {"", " 1:1", " 1:n", " n:1", " n:n"};
 void Join::out(Ostream& os) const {
-	os << "(" << *source << ") " << name() << typestr[type] << " on "
-	   << joincols << " (" << *source2 << ")";
+	os << "(" << *source << ") " << name() << typestr[type]
+	   << (hash ? " HASH" : "") << " on " << joincols << " (" << *source2
+	   << ")";
 }
 
 Indexes Join::keys() {
@@ -173,8 +177,22 @@ double Join::opt(Query* src1, Query* src2, Type typ, const Fields& index,
 			cost2 *= p;
 		}
 	}
-	if (freeze)
-		src2->optimize(joincols, needs2, Fields(), is_cursor2, true);
+	// alternatively, read all of source 2 once into a hash table
+	double hcost = hash_cost(src2, nrecs1, needs2, is_cursor);
+	TRACE(JOINOPT, "hash cost " << hcost);
+	bool use_hash = hcost < nrecs1 * SELECT_COST + cost2;
+	if (use_hash) {
+		cost1 -= nrecs1 * SELECT_COST;
+		cost2 = hcost;
+	}
+	if (freeze) {
+		hash = use_hash;
+		if (hash)
+			src2->optimize(
+				Fields(), set_union(needs2, joincols), Fields(), false, true);
+		else
+			src2->optimize(joincols, needs2, Fields(), is_cursor2, true);
+	}
 
 	switch (typ) {
 	case ONE_ONE:
@@ -192,10 +210,21 @@ double Join::opt(Query* src1, Query* src2, Type typ, const Fields& index,
 	default:
 		unreachable();
 	}
-	TRACE(JOINOPT,
-		"nrecs = " << nrecs << " / 2 = " << (nrecs > 1 ? nrecs / 2 : nrecs));
-	if (nrecs > 1)
-		nrecs /= 2; // convert from max to guess of expected
+	// with column statistics, use the usual estimate of
+	// nrecs1 * nrecs2 / max(ndistinct1, ndistinct2)
+	double nd = typ == N_N
+		? max(src1->ndistinct(joincols), src2->ndistinct(joincols))
+		: -1;
+	if (nd > 0) {
+		nrecs /= nd;
+		TRACE(JOINOPT, "nrecs = " << nrecs << " from " << nd << " distinct");
+	} else {
+		TRACE(JOINOPT,
+			"nrecs = " << nrecs << " / 2 = "
+					   << (nrecs > 1 ? nrecs / 2 : nrecs));
+		if (nrecs > 1)
+			nrecs /= 2; // convert from max to guess of expected
+	}
 
 	if (nrecs <= 0)
 		cost2 = 0;
@@ -205,6 +234,91 @@ double Join::opt(Query* src1, Query* src2, Type typ, const Fields& index,
 	return cost1 + cost2;
 }
 
+// the cost of reading all of source 2 (in any order) into a hash table
+// plus the cost of probing it for each record from source 1
+double Join::hash_cost(
+	Query* src2, double nrecs1, const Fields& needs2, bool is_cursor) {
+	// building the table has a fixed overhead
+	// so small joins stay with select
+	const double HASH_FIXED_COST = 10000;
+	const double HASH_COST = 100; // per record built or probed
+
+	// the rows are held in memory, cursors would hold them across transactions
+	if (is_cursor)
+		return IMPOSSIBLE;
+	double cost = src2->optimize(
+		Fields(), set_union(needs2, joincols), Fields(), false, false);
+	if (cost >= IMPOSSIBLE)
+		return IMPOSSIBLE;
+	double nrecs2 = src2->nrecords();
+	if (nrecs2 * src2->recordsize() > tempindex_memory)
+		return IMPOSSIBLE;
+	return cost + HASH_FIXED_COST + (nrecs1 + nrecs2) * HASH_COST;
+}
+
+// JoinHash ---------------------------------------------------------
+
+// maps join keys to the source2 rows with that key
+// groups are chained by index rather than pointer to keep it compact
+class JoinHash {
+public:
+	JoinHash() : heads(64, -1) {
+	}
+	void add(Record key, const Row& row) {
+		size_t h = hashkey(key);
+		int g = find(key, h);
+		if (g < 0) {
+			if (groups.size() >= heads.size())
+				grow();
+			g = groups.size();
+			groups.push_back(Group{key, h, heads[h & mask()], {}});
+			heads[h & mask()] = g;
+		}
+		groups[g].rows.push_back(row);
+	}
+	// returns nullptr if there are no rows with the key
+	std::vector<Row>* find(Record key) {
+		int g = find(key, hashkey(key));
+		return g < 0 ? nullptr : &groups[g].rows;
+	}
+
+private:
+	struct Group {
+		Record key;
+		size_t hash;
+		int next; // the next group in the same bucket, -1 for none
+		std::vector<Row> rows;
+	};
+	static size_t hashkey(Record key) {
+		size_t h = 0;
+		for (int i = 0; i < key.size(); ++i) {
+			gcstring s = key.getraw(i);
+			h = h * 31 + hashfn(s.ptr(), s.size());
+		}
+		return h;
+	}
+	int find(Record key, size_t h) const {
+		for (int g = heads[h & mask()]; g >= 0; g = groups[g].next)
+			if (groups[g].hash == h && groups[g].key == key)
+				return g;
+		return -1;
+	}
+	size_t mask() const {
+		return heads.size() - 1;
+	}
+	void grow() {
+		heads.assign(heads.size() * 2, -1);
+		for (int g = 0; g < int(groups.size()); ++g) {
+			size_t b = groups[g].hash & mask();
+			groups[g].next = heads[b];
+			heads[b] = g;
+		}
+	}
+
+	std::vector<int> heads; // size is a power of two
+	std::vector<Group> groups;
+};
+
 // execution
 
 Header Join::header() {
@@ -217,11 +331,13 @@ Row Join::get(Dir dir) {
 		hdr1 = source->header();
 		row2 = Eof;
 		empty2 = Row(lispn(Record(), source2->header().size()));
+		if (hash && !hashtbl)
+			build_hash();
 	}
 	while (true) {
 		if (row2 == Eof && !next_row1(dir))
 			return Eof;
-		row2 = source2->get(dir);
+		row2 = get2(dir);
 		if (should_output(row2)) {
 #ifndef NDEBUG
 			if (row2 != Eof)
@@ -237,10 +353,40 @@ bool Join::next_row1(Dir dir) {
 	if (Eof == (row1 = source->get(dir)))
 		return false;
 	Record key = row_to_key(hdr1, row1, joincols);
-	source2->select(joincols, key);
+	if (hash) {
+		matches = hashtbl->find(key);
+		imatch = -1;
+	} else
+		source2->select(joincols, key);
 	return true;
 }
 
+void Join::build_hash() {
+	hashtbl = new JoinHash;
+	Header hdr2 = source2->header();
+	Row row;
+	while (Eof != (row = source2->get(NEXT)))
+		hashtbl->add(row_to_key(hdr2, row, joincols), row);
+}
+
+// the next source2 row matching row1
+Row Join::get2(Dir dir) {
+	if (!hash)
+		return source2->get(dir);
+	if (!matches)
+		return Eof;
+	int n = matches->size();
+	if (imatch < 0) // first
+		imatch = dir == NEXT ? 0 : n - 1;
+	else
+		imatch += dir == NEXT ? 1 : -1;
+	if (imatch < 0 || imatch >= n) {
+		matches = nullptr;
+		return Eof;
+	}
+	return (*matches)[imatch];
+}
+
 bool Join::should_output(const Row& row) {
 	return row != Eof;
 }
@@ -288,3 +434,115 @@ bool LeftJoin::should_output(const Row& row) {
 	}
 	return Join::should_output(row);
 }
+
+// tests ------------------------------------------------------------
+
+#include "testing.h"
+
+static Record joinkey(int i) {
+	Record key;
+	key.addval(i);
+	return key;
+}
+
+TEST(joinhash) {
+	JoinHash jh;
+	for (int i = 0; i < 1000; ++i) {
+		Record rec;
+		rec.addval(i);
+		jh.add(joinkey(i % 100), Row(lisp(rec)));
+	}
+	for (int k = 0; k < 100; ++k) {
+		std::vector<Row>* rows = jh.find(joinkey(k));
+		verify(rows);
+		assert_eq(int(rows->size()), 10);
+		// in the order added
+		assert_eq((*rows)[0].data[0].getint(0), k);
+		assert_eq((*rows)[9].data[0].getint(0), k + 900);
+	}
+	verify(!jh.find(joinkey(100)));
+}
+
+#include "tempdb.h"
+#include "thedb.h"
+#include "database.h"
+#include "ostreamstr.h"
+
+static void req(int tran, const char* s) {
+	except_if(!database_request(tran, s), "FAILED: " << s);
+}
+
+// 300 headers, 1000 lines for the first 250 of them
+static void join_tables() {
+	int tran = theDB()->transaction(READWRITE);
+	database_admin("create hdr (hid, name) key(hid)");
+	database_admin("create lin (lid, hid, amt) key(lid)");
+	for (int i = 0; i < 300; ++i) {
+		OstreamStr os;
+		os << "insert{hid: " << i << ", name: 'h" << i << "'} into hdr";
+		req(tran, os.str());
+	}
+	for (int i = 0; i < 1000; ++i) {
+		OstreamStr os;
+		os << "insert{lid: " << i << ", hid: " << i % 250 << ", amt: " << i
+		   << "} into lin";
+		req(tran, os.str());
+	}
+	verify(theDB()->commit(tran));
+}
+
+// returns the number of rows, checks each line is output once
+// and counts the headers without lines
+static int join_rows(Query* q, Dir dir, int& nunmatched) {
+	Header hdr = q->header();
+	std::vector<bool> seen(1000);
+	nunmatched = 0;
+	int n = 0;
+	q->rewind();
+	for (Row row; Query::Eof != (row = q->get(dir)); ++n) {
+		int hid = row.getval(hdr, "hid").integer();
+		assert_eq(row.getval(hdr, "name").gcstr(), gcstring(OSTR("h" << hid)));
+		if (row.getraw(hdr, "lid").size() == 0) {
+			verify(hid >= 250);
+			++nunmatched;
+			continue;
+		}
+		int lid = row.getval(hdr, "lid").integer();
+		assert_eq(lid % 250, hid);
+		assert_eq(row.getval(hdr, "amt"), Value(lid));
+		verify(!seen[lid]);
+		seen[lid] = true;
+	}
+	return n;
+}
+
+TEST(qjoin_hash) {
+	TempDB tempdb;
+	join_tables();
+	int tran = theDB()->transaction(READONLY);
+	Query* q = query("hdr join lin");
+	verify(gcstring(OSTR(*q)).has(" HASH "));
+	q->set_transaction(tran);
+	int nunmatched;
+	assert_eq(join_rows(q, NEXT, nunmatched), 1000);
+	assert_eq(nunmatched, 0);
+	assert_eq(join_rows(q, PREV, nunmatched), 1000);
+	q->close(q);
+	verify(theDB()->commit(tran));
+}
+
+TEST(qjoin_leftjoin_hash) {
+	TempDB tempdb;
+	join_tables();
+	int tran = theDB()->transaction(READONLY);
+	Query* q = query("hdr leftjoin lin");
+	verify(gcstring(OSTR(*q)).has(" HASH "));
+	q->set_transaction(tran);
+	int nunmatched;
+	assert_eq(join_rows(q, NEXT, nunmatched), 1050);
+	assert_eq(nunmatched, 50); // headers 250 to 299 have no lines
+	assert_eq(join_rows(q, PREV, nunmatched), 1050);
+	assert_eq(nunmatched, 50);
+	q->close(q);
+	verify(theDB()->commit(tran));
+}
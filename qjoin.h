@@ -3,10 +3,16 @@
 // Licensed under GPLv2
 
 #include "queryimp.h"
+#include <vector>
+
+class JoinHash;
 
 class Join : public Query2 {
 public:
 	Join(Query* s1, Query* s2, Fields by);
+	Query* clone() const override {
+		return clone_sources(new Join(*this));
+	}
 	void out(Ostream& os) const override;
 	Fields columns() override {
 		return set_union(source->columns(), source2->columns());
@@ -43,6 +49,7 @@ protected:
 	}
 	virtual bool next_row1(Dir dir);
 	virtual bool should_output(const Row& row);
+	Row get2(Dir dir);
 
 	Type type;
 	double nrecs;
@@ -51,17 +58,28 @@ private:
 	double opt(Query* src1, Query* src2, Type typ, const Fields& index,
 		const Fields& needs1, const Fields& needs2, bool is_cursor,
 		bool freeze = false);
+	double hash_cost(
+		Query* src2, double nrecs1, const Fields& needs2, bool is_cursor);
+	void build_hash();
 
 	bool first;
 	Header hdr1;
 	Row row1;
 	Row row2;
 	Row empty2;
+	// hash join, source2 is read once into hashtbl instead of select
+	bool hash = false;
+	JoinHash* hashtbl = nullptr;
+	std::vector<Row>* matches = nullptr; // for the current row1
+	int imatch = -1;
 };
 
 class LeftJoin : public Join {
 public:
 	LeftJoin(Query* s1, Query* s2, Fields by);
+	Query* clone() const override {
+		return clone_sources(new LeftJoin(*this));
+	}
 	Indexes keys() override;
 	double nrecords() override;
 
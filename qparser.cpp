@@ -14,8 +14,10 @@
 #include "symbols.h"
 #include "dbms.h"
 #include "sesviews.h"
+#include "colstats.h"
 #include "exceptimp.h"
 #include "opcodes.h"
+#include "fibers.h"
 #include <cassert>
 #include <cctype>
 
@@ -123,6 +125,7 @@ bool is_admin(char* s) {
 	case K_VIEW:
 	case K_SVIEW:
 	case K_RENAME:
+	case K_ANALYZE:
 		return true;
 	default:
 		return false;
@@ -219,6 +222,12 @@ bool TableSpec::haskey() {
 	return false;
 }
 
+// building an index on a large table can take a while
+// so stop if the connection is killed meanwhile
+static bool admin_progress(int) {
+	return !tls().killed;
+}
+
 void QueryParser::admin() {
 	switch (scanner.keyword) {
 	case K_CREATE: {
@@ -239,7 +248,7 @@ void QueryParser::admin() {
 			for (Lisp<IndexSpec> i = ts.indexes; !nil(i); ++i)
 				theDB()->add_index(table, fields_to_commas(i->columns), i->key,
 					i->fktable, fields_to_commas(i->fkcols), i->fkmode,
-					i->unique);
+					i->unique, admin_progress);
 		} catch (const Except& e) {
 			if (theDB()->istable(table))
 				theDB()->remove_table(table);
@@ -279,7 +288,7 @@ void QueryParser::admin() {
 				if (!indexes.member(i->columns))
 					theDB()->add_index(table, fields_to_commas(i->columns),
 						i->key, i->fktable, fields_to_commas(i->fkcols),
-						i->fkmode, i->unique);
+						i->fkmode, i->unique, admin_progress);
 		} catch (const Except& e) {
 			if (table_created)
 				theDB()->remove_table(table);
@@ -333,7 +342,7 @@ void QueryParser::admin() {
 				if (mode == K_CREATE)
 					theDB()->add_index(table, fields_to_commas(i->columns),
 						i->key, i->fktable, fields_to_commas(i->fkcols),
-						i->fkmode, i->unique);
+						i->fkmode, i->unique, admin_progress);
 				else // drop
 					theDB()->remove_index(table, fields_to_commas(i->columns));
 		} catch (const Except& e) {
@@ -399,8 +408,18 @@ void QueryParser::admin() {
 			theDB()->remove_table(table);
 		return;
 	}
+	case K_ANALYZE: {
+		match();
+		gcstring table = scanner.value;
+		match(T_IDENTIFIER);
+		if (token != Eof)
+			syntax_error();
+		analyze_table(table);
+		return;
+	}
 	default:
-		except("expecting: create, ensure, alter, rename, view, or drop");
+		except("expecting: create, ensure, alter, rename, view, drop, "
+			   "or analyze");
 	}
 }
 
@@ -1381,3 +1400,27 @@ TEST(qparser_joinby) {
 
 	xassert(parse_query("tables join by (x) indexes"));
 }
+
+TEST(qparser_admin_killed) {
+	TempDB tempdb;
+
+	adm("create killed (a, b) key(a)");
+	int tran = theDB()->transaction(READWRITE);
+	for (int i = 0; i < 100; ++i) {
+		OstreamStr os;
+		os << "insert { a: " << i << ", b: " << i % 7 << " } into killed";
+		req(tran, os.str());
+	}
+	verify(theDB()->commit(tran));
+
+	// as if kill_connections closed this session's connection
+	tls().killed = true;
+	xassert(adm("ensure killed index(b)"));
+	xassert(adm("alter killed create index(b)"));
+	tls().killed = false;
+	verify(!theDB()->get_index("killed", "b"));
+
+	adm("ensure killed index(b)");
+	verify(theDB()->get_index("killed", "b"));
+	adm("drop killed");
+}
@@ -7,6 +7,9 @@
 class Product : public Query2 {
 public:
 	Product(Query* s1, Query* s2);
+	Query* clone() const override {
+		return clone_sources(new Product(*this));
+	}
 	void out(Ostream& os) const override;
 	Fields columns() override {
 		return set_union(source->columns(), source2->columns());
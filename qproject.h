@@ -8,6 +8,9 @@
 class Project : public Query1 {
 public:
 	Project(Query* source, const Fields& f, bool allbut = false);
+	Query* clone() const override {
+		return clone_sources(new Project(*this));
+	}
 	void out(Ostream& os) const override;
 	Query* transform() override;
 	Fields columns() override {
@@ -7,6 +7,9 @@
 class Rename : public Query1 {
 public:
 	Rename(Query* source, const Fields& f, const Fields& t);
+	Query* clone() const override {
+		return clone_sources(new Rename(*this));
+	}
 	void out(Ostream& os) const override;
 	Query* transform() override;
 	double optimize2(const Fields& index, const Fields& needs,
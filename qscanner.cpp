@@ -19,7 +19,8 @@ struct Keyword {
 	const char* word;
 	int id;
 };
-static Keyword words[] = {{"alter", K_ALTER}, {"and", T_AND},
+static Keyword words[] = {{"alter", K_ALTER}, {"analyze", K_ANALYZE},
+	{"and", T_AND},
 	{"average", K_AVERAGE}, {"by", K_BY}, {"cascade", K_CASCADE},
 	{"count", K_COUNT}, {"create", K_CREATE}, {"delete", K_DELETE},
 	{"destroy", K_DROP}, {"drop", K_DROP}, {"ensure", K_ENSURE},
@@ -65,17 +66,18 @@ void QueryScanner::insert(const gcstring& s) {
 #include "testing.h"
 #include "except.h"
 
-static const char* qscanner_input = "alter average by count create delete \
-	destroy drop ensure extend false history in into index insert intersect join \
-	key leftjoin list max min minus project remove rename reverse set \
-	sort summarize times to total true union unique update view where";
+static const char* qscanner_input = "alter analyze average by count create \
+	delete destroy drop ensure extend false history in into index insert \
+	intersect join key leftjoin list max min minus project remove rename \
+	reverse set sort summarize times to total true union unique update view \
+	where";
 
-static int results[] = {K_ALTER, K_AVERAGE, K_BY, K_COUNT, K_CREATE, K_DELETE,
-	K_DROP, K_DROP, K_ENSURE, K_EXTEND, K_FALSE, K_HISTORY, K_IN, K_INTO,
-	K_INDEX, K_INSERT, K_INTERSECT, K_JOIN, K_KEY, K_LEFTJOIN, K_LIST, K_MAX,
-	K_MIN, K_MINUS, K_PROJECT, K_REMOVE, K_RENAME, K_REVERSE, K_SET, K_SORT,
-	K_SUMMARIZE, K_TIMES, K_TO, K_TOTAL, K_TRUE, K_UNION, K_UNIQUE, K_UPDATE,
-	K_VIEW, K_WHERE};
+static int results[] = {K_ALTER, K_ANALYZE, K_AVERAGE, K_BY, K_COUNT, K_CREATE,
+	K_DELETE, K_DROP, K_DROP, K_ENSURE, K_EXTEND, K_FALSE, K_HISTORY, K_IN,
+	K_INTO, K_INDEX, K_INSERT, K_INTERSECT, K_JOIN, K_KEY, K_LEFTJOIN, K_LIST,
+	K_MAX, K_MIN, K_MINUS, K_PROJECT, K_REMOVE, K_RENAME, K_REVERSE, K_SET,
+	K_SORT, K_SUMMARIZE, K_TIMES, K_TO, K_TOTAL, K_TRUE, K_UNION, K_UNIQUE,
+	K_UPDATE, K_VIEW, K_WHERE};
 
 TEST(qscanner) {
 	QueryScanner sc(qscanner_input);
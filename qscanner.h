@@ -19,6 +19,7 @@ protected:
 
 enum {
 	K_ALTER = NEXT_KEYWORD,
+	K_ANALYZE,
 	K_AVERAGE,
 	K_BY,
 	K_CASCADE,
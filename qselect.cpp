@@ -17,7 +17,7 @@
 #include "queryimp.h"
 #include "qtable.h"
 #include "hashmap.h"
-#include "array.h"
+#include "bitmap.h"
 #include "database.h"
 #include "qexprimp.h"
 #include "qscanner.h"
@@ -37,51 +37,6 @@
 #include "opcodes.h"
 #include <cmath> // for fabs
 
-struct FilterTreeSlot {
-	typedef int Key;
-	Key key = 0;
-	int adr = 0;
-	FilterTreeSlot() {
-	}
-	explicit FilterTreeSlot(Key k, int a = 0) : key(k), adr(a) {
-	}
-	void copy(const FilterTreeSlot& from) {
-		key = from.key;
-		adr = from.adr;
-	}
-	bool operator<(const FilterTreeSlot& y) const {
-		return key < y.key;
-	}
-	bool operator==(const FilterTreeSlot& y) const {
-		return key == y.key;
-	}
-};
-typedef Array<FilterTreeSlot, 4000 / sizeof(FilterTreeSlot)> FilterTreeSlots;
-
-struct FilterLeafSlot {
-	typedef int Key;
-	Key key = 0;
-	short count = 0;
-	FilterLeafSlot() {
-	}
-	explicit FilterLeafSlot(Key k, short c = 0) : key(k), count(c) {
-	}
-	void copy(const FilterLeafSlot& from) {
-		key = from.key;
-		count = from.count;
-	}
-	bool operator<(const FilterLeafSlot& y) const {
-		return key < y.key;
-	}
-	bool operator==(const FilterLeafSlot& y) const {
-		return key == y.key;
-	}
-};
-typedef Array<FilterLeafSlot, 4000 / sizeof(FilterLeafSlot)> FilterLeafSlots;
-typedef Btree<FilterLeafSlot, FilterTreeSlot, FilterLeafSlots, FilterTreeSlots,
-	TempDest>
-	Filter;
-
 struct Cmp {
 	gcstring ident;
 	int op = 0;
@@ -123,6 +78,7 @@ typedef HashMap<QIndex, double, HashFirst<QIndex>, EqFirst<QIndex> > Ifracs;
 class Select : public Query1 {
 public:
 	Select(Query* s, Expr* e);
+	Query* clone() const override;
 	void out(Ostream& os) const override;
 	Fields columns() override {
 		return source->columns();
@@ -164,8 +120,7 @@ public:
 			TRACE(SLOWQUERY,
 				n_in << "->" << n_out << "  " << this << endl
 					 << "IN: " << q);
-		if (fltr)
-			fltr->free();
+		fltr = nullptr;
 		Query1::close(q);
 	}
 
@@ -193,8 +148,9 @@ protected: // not private so tests can subclass and override
 	Lisp<Keyrange> ranges;
 	int range_i = 0;
 	Keyrange sel;
-	Filter* fltr = nullptr;
+	Bitmap* fltr = nullptr; // addresses of records that pass the filters
 	Header hdr;
+	Lisp<std::pair<ColRef, Iselect*>> iselrefs; // isels bound to hdr
 	int tran = -1;
 	int n_in = 0;
 	int n_out = 0;
@@ -249,6 +205,24 @@ Select::Select(Query* s, Expr* e)
 				   expr->fields(), source->columns()));
 }
 
+// tbl must point to the copied Table
+// which may have been wrapped in a TempIndex by addindex
+Query* Select::clone() const {
+	auto q = new Select(*this);
+	q->source = source->clone();
+	if (tbl) {
+		Query* t = q->source;
+		if (source != tbl) {
+			auto ti = dynamic_cast<Query1*>(t);
+			verify(ti);
+			t = ti->source;
+		}
+		q->tbl = dynamic_cast<Table*>(t);
+		verify(q->tbl);
+	}
+	return q;
+}
+
 void Select::out(Ostream& os) const {
 	os << *source << " WHERE";
 	if (conflicting) {
@@ -459,7 +433,9 @@ double Select::optimize2(const Fields& index, const Fields& needs,
 
 	required_index = index;
 	source_index = primary;
-	tbl->select_index(source_index);
+	// same condition as primarycost uses to skip the data read cost
+	tbl->select_index(source_index,
+		subset(primary, select_needs) && subset(primary, prior_needs));
 
 	return cost;
 }
@@ -645,8 +621,11 @@ double Select::field_frac(const Field& field) {
 			best_size = tbl->indexsize(*idxs);
 		}
 	}
-	if (nil(best_index))
-		return .5;
+	if (nil(best_index)) {
+		Iselect* fsel = isels.find(field);
+		double frac = fsel ? tbl->colfrac(field, *fsel) : -1;
+		return frac >= 0 ? frac : .5;
+	}
 	Iselect fsel = *isels.find(field);
 	double frac = tbl->iselsize(best_index, Iselects(fsel));
 	LOG("field_frac " << best_index << " " << fsel << " = " << frac);
@@ -873,6 +852,8 @@ Row Select::get(Dir dir) {
 		getFirst = false;
 		iterate_setup();
 	}
+	if (fltr && fltr->empty())
+		return Eof;
 	if (rewound) {
 		rewound = false;
 		newrange = true;
@@ -906,44 +887,44 @@ Row Select::get(Dir dir) {
 
 void Select::iterate_setup() {
 	// process filters
+	// each filter index gives a bitmap of the matching record addresses
+	// (the union of its ranges) and the result is their intersection
+	fltr = nullptr;
 	if (!nil(filter)) {
-		fltr = new Filter(new TempDest);
-		Indexes idxs = filter;
-		// process first filter
-		Fields ix = *idxs++;
-		tbl->set_index(ix);
-		Lisp<Keyrange> rs = selects(ix, iselects(ix));
-		while (!nil(rs)) {
-			Keyrange& range = *rs++;
-			LOG("filter range: " << range.org << " => " << range.end);
-			for (source->select(ix, range.org, range.end);
-				 Eof != source->get(NEXT);)
-				if (matches(ix, tbl->iter->key))
-					fltr->insert(FilterLeafSlot(tbl->iter->adr(), 1));
-		}
-		// process additional filters
-		while (!nil(idxs)) {
-			ix = *idxs++;
+		for (Indexes idxs = filter; !nil(idxs); ++idxs) {
+			Fields ix = *idxs;
 			tbl->set_index(ix);
-			rs = selects(ix, iselects(ix));
+			auto bm = new Bitmap;
+			Lisp<Keyrange> rs = selects(ix, iselects(ix));
 			while (!nil(rs)) {
 				Keyrange& range = *rs++;
 				LOG("filter range: " << range.org << " => " << range.end);
 				for (source->select(ix, range.org, range.end);
-					 Eof != source->get(NEXT);)
-					if (matches(ix, tbl->iter->key))
-						fltr->increment(tbl->iter->adr());
+					 Eof != source->get(NEXT);) {
+					int adr = mmoffset_to_int(tbl->iter->adr());
+					// only records that passed the previous filters
+					if ((!fltr || fltr->has(adr)) &&
+						matches(ix, tbl->iter->key))
+						bm->add(adr);
+				}
 			}
+			fltr = bm;
+			LOG("filter " << ix << " => " << fltr->size());
+			if (fltr->empty())
+				break;
 		}
 		tbl->set_index(source_index); // restore primary index
 
 		// remove filter isels - no longer needed
-		for (idxs = filter; !nil(idxs); ++idxs)
+		for (Indexes idxs = filter; !nil(idxs); ++idxs)
 			for (Fields flds(*idxs); !nil(flds); ++flds)
 				isels.erase(*flds);
 	}
 
 	hdr = source->header();
+	iselrefs = Lisp<std::pair<ColRef, Iselect*>>();
+	for (auto iter = isels.begin(); iter != isels.end(); ++iter)
+		iselrefs.push(std::make_pair(ColRef(iter->key), &iter->val));
 	ranges = selects(source_index, iselects(source_index));
 	LOG("ranges " << ranges);
 }
@@ -1051,17 +1032,13 @@ Iselects Select::iselects(const Fields& idx) {
 
 bool Select::matches(Row& row) {
 	// first check against filter
-	if (fltr) {
-		Filter::iterator iter = fltr->find(tbl->iter->adr());
-		if (iter == fltr->end() || iter->count != size(filter))
-			return false;
-	}
+	if (fltr && !fltr->has(mmoffset_to_int(tbl->iter->adr())))
+		return false;
 	// then check against isels
 	// TODO: check keys before data (every other one)
-	for (auto iter = isels.begin(); iter != isels.end(); ++iter) {
-		Iselect& isel = iter->val;
-		gcstring value = row.getraw(hdr, iter->key);
-		if (!isel.matches(value))
+	for (auto r = iselrefs; !nil(r); ++r) {
+		gcstring value = row.getraw(hdr, r->first);
+		if (!r->second->matches(value))
 			return false;
 	}
 	// finally check remaining expressions
@@ -1164,6 +1141,9 @@ public:
 		iselsize_index = index;
 		return (float) .1;
 	}
+	double colfrac(const gcstring& col, const Iselect& isel) override {
+		return -1;
+	}
 	Fields iselsize_index;
 };
 
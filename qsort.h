@@ -7,6 +7,9 @@
 class QSort : public Query1 {
 public:
 	QSort(Query* source, bool r, const Fields& s);
+	Query* clone() const override {
+		return clone_sources(new QSort(*this));
+	}
 	void out(Ostream& os) const override;
 	Fields columns() override {
 		return source->columns();
@@ -5,7 +5,9 @@
 #include "queryimp.h"
 #include "sustring.h"
 #include "suobject.h" // for List
+#include "hashfn.h"
 #include <map>
+#include <vector>
 using namespace std;
 
 #define Eof Query::Eof
@@ -61,6 +63,42 @@ private:
 	bool first;
 };
 
+// used when data is read unordered and the result doesn't need an order
+// groups are found by hashing the "by" fields (open addressing)
+// and returned in the order they were first seen
+// summaries are stored inline, nfuncs per group,
+// instead of allocating Summary objects for every group
+class HashStrategy : public Strategy {
+public:
+	explicit HashStrategy(Summarize* q);
+	Row get(Dir dir, bool rewound) override;
+	void select(const Fields& index, Record from, Record to) override;
+
+private:
+	enum Fn { TOTAL, AVERAGE, COUNT, MAX, MIN, LIST };
+	struct Acc {
+		Value val; // total, max, min, or list
+		int count;
+	};
+	void process();
+	int group(Record byRec);
+	void grow();
+	static void add(Fn fn, Acc& acc, Value x);
+	static Value result(Fn fn, const Acc& acc);
+
+	struct Slot {
+		size_t hash;
+		int group; // -1 if empty
+	};
+	vector<Slot> slots; // size is a power of two
+	vector<Record> keys; // by values for each group
+	vector<Fn> fns;
+	vector<Acc> accs; // nfuncs for each group
+	int nfuncs;
+	int i = 0; // iteration position in groups
+	bool first = true;
+};
+
 // used for "summarize min/max index-field"
 // where we can just read first/last using index
 class IdxStrategy : public Strategy {
@@ -102,7 +140,7 @@ Summarize::Summarize(Query* source, const Fields& p, const Fields& c,
 }
 
 void Summarize::out(Ostream& os) const {
-	const char* s[] = {"", "-SEQ", "-MAP", "-IDX"};
+	const char* s[] = {"", "-SEQ", "-MAP", "-IDX", "-HASH"};
 	os << *source << " SUMMARIZE" << s[strategy];
 	if (!nil(via))
 		os << " ^" << via;
@@ -118,10 +156,15 @@ void Summarize::out(Ostream& os) const {
 
 double Summarize::nrecords() {
 	double nr = source->nrecords();
-	return nr < 1 ? nr
-				  : nil(by)
-			? 1
-			: by_contains_key() ? nr : nr / 2; // TODO review this estimate
+	if (nr < 1)
+		return nr;
+	if (nil(by))
+		return 1;
+	if (by_contains_key())
+		return nr;
+	// one record per distinct value of by
+	double nd = source->ndistinct(by);
+	return nd > 0 ? min(nd, nr) : nr / 2;
 }
 
 Indexes Summarize::indexes() {
@@ -154,14 +197,17 @@ double Summarize::optimize2(const Fields& index, const Fields& needs,
 	double seq_cost = seqCost(index, srcneeds, is_cursor, false);
 	double idx_cost = idxCost(is_cursor, false);
 	double map_cost = mapCost(index, srcneeds, is_cursor, false);
+	double hash_cost = hashCost(index, srcneeds, is_cursor, false);
 
 	if (!freeze)
-		return min(seq_cost, min(idx_cost, map_cost));
+		return min(min(seq_cost, idx_cost), min(map_cost, hash_cost));
 
-	if (seq_cost <= idx_cost && seq_cost <= map_cost)
+	if (seq_cost <= idx_cost && seq_cost <= map_cost && seq_cost <= hash_cost)
 		return seqCost(index, srcneeds, is_cursor, true);
-	else if (idx_cost <= map_cost)
+	else if (idx_cost <= map_cost && idx_cost <= hash_cost)
 		return idxCost(is_cursor, true);
+	else if (hash_cost <= map_cost)
+		return hashCost(index, srcneeds, is_cursor, true);
 	else
 		return mapCost(index, srcneeds, is_cursor, true);
 }
@@ -241,6 +287,20 @@ double Summarize::mapCost(
 	return cost;
 }
 
+double Summarize::hashCost(
+	const Fields& index, const Fields& srcneeds, bool is_cursor, bool freeze) {
+	// results are unordered so only when no index is required
+	if (!nil(index) || nil(by))
+		return IMPOSSIBLE;
+	// using optimize1 to bypass tempindex
+	// add 25% for hash table overhead, less than map since no compares
+	double cost =
+		1.25 * source->optimize1(none, srcneeds, none, is_cursor, freeze);
+	if (freeze)
+		strategy = HASH;
+	return cost;
+}
+
 // functions ========================================================
 
 class Summary {
@@ -421,6 +481,8 @@ void Summarize::iterate_setup() {
 		strategyImp = new IdxStrategy(this);
 	else if (strategy == MAP)
 		strategyImp = new MapStrategy(this);
+	else if (strategy == HASH)
+		strategyImp = new HashStrategy(this);
 	else
 		strategyImp = new SeqStrategy(this);
 }
@@ -586,6 +648,159 @@ void MapStrategy::select(const Fields& index, Record from, Record to) {
 
 //===================================================================
 
+HashStrategy::HashStrategy(Summarize* summarize)
+	: Strategy(summarize), slots(64, Slot{0, -1}),
+	  nfuncs(summarize->funcs.size()) {
+	for (Fields f = q->funcs; !nil(f); ++f)
+		if (*f == "total")
+			fns.push_back(TOTAL);
+		else if (*f == "average")
+			fns.push_back(AVERAGE);
+		else if (*f == "count")
+			fns.push_back(COUNT);
+		else if (*f == "max")
+			fns.push_back(MAX);
+		else if (*f == "min")
+			fns.push_back(MIN);
+		else if (*f == "list")
+			fns.push_back(LIST);
+		else
+			error("unknown summary type");
+}
+
+Row HashStrategy::get(Dir dir, bool rewound) {
+	if (first) {
+		process();
+		first = false;
+	}
+	int n = keys.size();
+	if (rewound) {
+		i = dir == NEXT ? 0 : n;
+		curdir = dir;
+	}
+
+	if (dir != curdir) {
+		// skip over the previous result
+		i = dir == PREV ? max(i - 1, 0) : min(i + 1, n);
+		curdir = dir;
+	}
+
+	for (;;) {
+		if (i == (dir == NEXT ? n : 0))
+			return Eof;
+		int g = dir == NEXT ? i++ : --i;
+		if (keys[g] < sel.org || sel.end < keys[g])
+			continue;
+		Record r = keys[g].dup();
+		for (int f = 0; f < nfuncs; ++f)
+			r.addval(result(fns[f], accs[g * nfuncs + f]));
+		return Row(lisp(Record::empty, r));
+	}
+}
+
+void HashStrategy::process() {
+	Row row;
+	while (Eof != (row = source->get(NEXT))) {
+		int g = group(row_to_key(q->hdr, row, q->by));
+		Acc* acc = &accs[g * nfuncs];
+		int f = 0;
+		for (Fields o = q->on; !nil(o); ++o, ++f)
+			add(fns[f], acc[f], row.getval(q->hdr, *o));
+	}
+}
+
+// the same as the Summary classes
+void HashStrategy::add(Fn fn, Acc& acc, Value x) {
+	switch (fn) {
+	case TOTAL:
+	case AVERAGE:
+		try {
+			acc.val = acc.val + x;
+			++acc.count;
+		} catch (...) {
+		}
+		break;
+	case COUNT:
+		++acc.count;
+		break;
+	case MAX:
+		if (!acc.val || x > acc.val)
+			acc.val = x;
+		break;
+	case MIN:
+		if (!acc.val || x < acc.val)
+			acc.val = x;
+		break;
+	case LIST: {
+		SuObject* list = val_cast<SuObject*>(acc.val);
+		if (list->find(x) == SuFalse)
+			list->add(x);
+		break;
+	}
+	}
+}
+
+Value HashStrategy::result(Fn fn, const Acc& acc) {
+	switch (fn) {
+	case AVERAGE:
+		return acc.count ? Value(acc.val / acc.count) : SuEmptyString;
+	case COUNT:
+		return acc.count;
+	default:
+		return acc.val;
+	}
+}
+
+static size_t hashrec(Record r) {
+	size_t h = 17;
+	for (int i = 0; i < r.size(); ++i) {
+		gcstring x = r.getraw(i);
+		h = 31 * h + hashfn(x.ptr(), x.size());
+	}
+	return h;
+}
+
+// returns the group for the by values, adding a new group if necessary
+int HashStrategy::group(Record byRec) {
+	size_t h = hashrec(byRec);
+	size_t mask = slots.size() - 1;
+	size_t j = h & mask;
+	for (; slots[j].group != -1; j = (j + 1) & mask)
+		if (slots[j].hash == h && keys[slots[j].group] == byRec)
+			return slots[j].group;
+	int g = keys.size();
+	slots[j] = Slot{h, g};
+	keys.push_back(byRec);
+	for (auto fn : fns) {
+		Value init = fn == LIST ? Value(new SuObject)
+			: fn == TOTAL || fn == AVERAGE ? Value(0)
+										 : Value();
+		accs.push_back(Acc{init, 0});
+	}
+	if (keys.size() * 4 > slots.size() * 3) // load factor 3/4
+		grow();
+	return g;
+}
+
+void HashStrategy::grow() {
+	vector<Slot> old(slots.size() * 2, Slot{0, -1});
+	old.swap(slots);
+	size_t mask = slots.size() - 1;
+	for (auto& slot : old)
+		if (slot.group != -1) {
+			size_t j = slot.hash & mask;
+			while (slots[j].group != -1)
+				j = (j + 1) & mask;
+			slots[j] = slot;
+		}
+}
+
+void HashStrategy::select(const Fields& index, Record from, Record to) {
+	// groups outside sel are skipped by get
+}
+
+//===================================================================
+
 Row IdxStrategy::get(Dir, bool rewound) {
 	if (!rewound)
 		return Eof;
@@ -609,3 +824,69 @@ Row IdxStrategy::get(Dir, bool rewound) {
 void IdxStrategy::select(const Fields& index, Record from, Record to) {
 	selIndex = index;
 }
+
+// tests ------------------------------------------------------------
+
+#include "testing.h"
+#include "tempdb.h"
+#include "thedb.h"
+#include "database.h"
+#include "ostreamstr.h"
+
+static void req(int tran, const char* s) {
+	except_if(!database_request(tran, s), "FAILED: " << s);
+}
+
+TEST(qsummarize_hash) {
+	TempDB tempdb;
+	const int NROWS = 1000;
+	const int NGROUPS = 250; // enough to grow the hash table several times
+
+	int tran = theDB()->transaction(READWRITE);
+	database_admin("create stdlib (group, name, text) key(name)");
+	database_admin("create lines (id, grp, amount) key(id)");
+	for (int i = 0; i < NROWS; ++i) {
+		OstreamStr os;
+		os << "insert{id: " << i << ", grp: " << i % NGROUPS
+		   << ", amount: " << i << "} into lines";
+		req(tran, os.str());
+	}
+	verify(theDB()->commit(tran));
+
+	Query* q = query("lines summarize grp, count, total amount, max amount, "
+					 "average amount, list amount");
+	verify(gcstring(OSTR(*q)).has("SUMMARIZE-HASH"));
+	tran = theDB()->transaction(READONLY);
+	q->set_transaction(tran);
+	Header hdr = q->header();
+	const int per = NROWS / NGROUPS;
+	vector<int> order;
+	vector<bool> seen(NGROUPS);
+	for (Row row; Query::Eof != (row = q->get(NEXT));) {
+		int g = row.getval(hdr, "grp").integer();
+		verify(!seen[g]);
+		seen[g] = true;
+		order.push_back(g);
+		assert_eq(row.getval(hdr, "count"), Value(per));
+		// amounts are g, g + NGROUPS, g + 2 * NGROUPS ...
+		int total = per * g + NGROUPS * per * (per - 1) / 2;
+		assert_eq(row.getval(hdr, "total_amount"), Value(total));
+		int maxamt = g + NGROUPS * (per - 1);
+		assert_eq(row.getval(hdr, "max_amount"), Value(maxamt));
+		assert_eq(row.getval(hdr, "average_amount"), Value(total / per));
+		SuObject* list = val_cast<SuObject*>(row.getval(hdr, "list_amount"));
+		verify(list && list->size() == per);
+	}
+	assert_eq(int(order.size()), NGROUPS);
+
+	// reverse gives the same groups in the opposite order
+	q->rewind();
+	for (int i = NGROUPS - 1; i >= 0; --i) {
+		Row row = q->get(PREV);
+		verify(row != Query::Eof);
+		assert_eq(row.getval(hdr, "grp"), Value(order[i]));
+	}
+	verify(q->get(PREV) == Query::Eof);
+	q->close(q);
+	verify(theDB()->commit(tran));
+}
@@ -9,6 +9,9 @@ class Summarize : public Query1 {
 public:
 	Summarize(Query* source, const Fields& p, const Fields& c, const Fields& f,
 		const Fields& o);
+	Query* clone() const override {
+		return clone_sources(new Summarize(*this));
+	}
 	void out(Ostream& os) const override;
 	Fields columns() override;
 	Indexes keys() override;
@@ -27,9 +30,13 @@ public:
 	bool updateable() const override {
 		return false;
 	}
+	bool needs_whole_rows() const override {
+		return wholeRecord;
+	}
 	friend class Strategy;
 	friend class SeqStrategy;
 	friend class MapStrategy;
+	friend class HashStrategy;
 	friend class IdxStrategy;
 
 private:
@@ -40,6 +47,8 @@ private:
 		bool freeze);
 	double mapCost(const Fields& index, const Fields& srcneeds, bool is_cursor,
 		bool freeze);
+	double hashCost(const Fields& index, const Fields& srcneeds,
+		bool is_cursor, bool freeze);
 	bool minmax1() const;
 	Indexes sourceIndexes(const Fields& index) const;
 
@@ -47,7 +56,7 @@ private:
 	Fields cols;
 	Fields funcs;
 	Fields on;
-	enum { NONE, SEQ, MAP, IDX } strategy;
+	enum { NONE, SEQ, MAP, IDX, HASH } strategy;
 	bool first;
 	bool rewound;
 	Header hdr;
@@ -8,6 +8,7 @@
 #include "fibers.h" // for yield
 #include "qhistable.h"
 #include "trace.h"
+#include "colstats.h"
 
 #define LOG(stuff) TRACE(TABLE, stuff)
 
@@ -81,6 +82,34 @@ int Table::totalsize() {
 	return theDB()->totalsize(table);
 }
 
+double Table::ndistinct(const Fields& flds) {
+	double nr = nrecords();
+	for (Indexes k = keys(); !nil(k); ++k)
+		if (subset(flds, *k))
+			return nr;
+	double nd = 1;
+	for (Fields f = flds; !nil(f); ++f) {
+		const ColStats* cs = get_stats(table, *f);
+		if (!cs)
+			return -1;
+		nd *= cs->ndistinct;
+	}
+	return min(nd, nr);
+}
+
+double Table::colfrac(const gcstring& col, const Iselect& isel) {
+	const ColStats* cs = get_stats(table, col);
+	if (!cs)
+		return -1;
+	if (isel.type == ISEL_VALUES) {
+		double sum = 0;
+		for (Lisp<gcstring> v = isel.values; !nil(v); ++v)
+			sum += cs->eqfrac(*v);
+		return min(sum, 1.0);
+	}
+	return cs->rangefrac(isel.org.x, isel.end.x);
+}
+
 float Table::iselsize(const Fields& index, const Iselects& iselects) {
 	Iselects isels;
 
@@ -250,10 +279,14 @@ double Table::optimize2(const Fields& index, const Fields& needs,
 	TRACE(TABLE, "\tidx3 " << idx3 << " cost3 " << cost3);
 
 	double cost;
+	if (freeze)
+		keyonly = false;
 	if (cost1 <= cost2 && cost1 <= cost3) {
 		cost = cost1;
-		if (freeze)
+		if (freeze) {
 			idxflds = idx1 ? idx1->index : none;
+			keyonly = idx1 != nullptr;
+		}
 	} else if (cost2 <= cost1 && cost2 <= cost3) {
 		cost = cost2;
 		if (freeze)
@@ -263,13 +296,16 @@ double Table::optimize2(const Fields& index, const Fields& needs,
 		if (freeze)
 			idxflds = idx3->index;
 	}
-	TRACE(TABLE, "\tchose: idx " << idxflds << " cost " << cost);
+	TRACE(TABLE,
+		"\tchose: idx " << idxflds << " cost " << cost
+						<< (keyonly ? " keyonly" : ""));
 	return cost;
 }
 
 // used by Select::optimize
-void Table::select_index(const Fields& index) {
+void Table::select_index(const Fields& index, bool ko) {
 	idxflds = index;
+	keyonly = ko;
 }
 
 Header Table::header() {
@@ -328,6 +364,8 @@ Row Table::get(Dir dir) {
 		rewound = true;
 		return Eof;
 	}
+	if (keyonly && !singleton)
+		return Row(lisp(iter->key, Record())); // don't touch the data
 	Record r(iter.data());
 	if (tbl->num > TN_VIEWS && r.size() > tbl->nextfield)
 		except("get: record has more fields (" << r.size() << ") than " << table
@@ -357,6 +395,7 @@ bool Table::output(Record r) {
 
 #include "testing.h"
 #include "tempdb.h"
+#include "ostreamstr.h"
 
 static void adm(int tran, const char* s) {
 	database_admin(s);
@@ -408,3 +447,73 @@ TEST(qtable) {
 	f = table.iselsize(lisp(gcstring("hdrnum")), lisp(oneisel));
 	verify(.6 < f && f < .8); // should be .7
 }
+
+TEST(qtable_stats) {
+	TempDB tempdb;
+
+	int tran = theDB()->transaction(READWRITE);
+	adm(tran, "create stdlib (group, name, text) key(name)");
+	adm(tran, "create lines (hdrnum, linenum) key(linenum)");
+	adm(tran, "create stats (a) key(a)"); // not the system stats table
+	for (int i = 1; i <= 10; ++i) {
+		OstreamStr os;
+		os << "insert{hdrnum: " << (i <= 7 ? 1 : i) << ", linenum: " << i
+		   << "} into lines";
+		req(tran, os.str());
+	}
+	verify(theDB()->commit(tran));
+
+	Table table("lines");
+	assert_eq(table.ndistinct(lisp(gcstring("hdrnum"))), -1);
+	adm(tran, "analyze lines");
+	Table table2("lines");
+	assert_eq(table2.ndistinct(lisp(gcstring("hdrnum"))), 4);
+	assert_eq(table2.ndistinct(lisp(gcstring("linenum"))), 10);
+	Iselect oneisel;
+	oneisel.org.x = oneisel.end.x = packint(1);
+	double f = table2.colfrac("hdrnum", oneisel);
+	verify(.6 < f && f < .8); // should be .7
+	assert_eq(theDB()->nrecords("stats"), 0);
+	verify(!Database::is_system_table("stats"));
+	xassert(theDB()->add_table("stats!"));
+
+	adm(tran, "rename lines to lines2");
+	verify(!get_stats("lines", "hdrnum"));
+	verify(get_stats("lines2", "hdrnum"));
+	adm(tran, "drop lines2");
+	verify(!get_stats("lines2", "hdrnum"));
+}
+
+static Table* find_table(Query* q) {
+	while (Query1* q1 = dynamic_cast<Query1*>(q))
+		q = q1->source;
+	return dynamic_cast<Table*>(q);
+}
+
+TEST(qtable_keyonly) {
+	TempDB tempdb;
+
+	int tran = theDB()->transaction(READWRITE);
+	adm(tran, "create stdlib (group, name, text) key(name)");
+	adm(tran,
+		"create lines (hdrnum, linenum, desc) key(linenum) index(hdrnum)");
+	req(tran, "insert{hdrnum: 1, linenum: 1, desc: \"now\"} into lines");
+	req(tran, "insert{hdrnum: 2, linenum: 2, desc: \"is\"} into lines");
+	verify(theDB()->commit(tran));
+
+	// updateable so needs the data records
+	verify(!find_table(query("lines project linenum"))->keyonly);
+
+	Query* q = query("lines project hdrnum");
+	verify(find_table(q)->keyonly);
+	tran = theDB()->transaction(READONLY);
+	q->set_transaction(tran);
+	Header hdr = q->header();
+	Row row = q->get(NEXT);
+	assert_eq(row.getval(hdr, "hdrnum"), Value(1));
+	row = q->get(NEXT);
+	assert_eq(row.getval(hdr, "hdrnum"), Value(2));
+	assert_eq(q->get(NEXT), Query::Eof);
+	q->close(q);
+	verify(theDB()->commit(tran));
+}
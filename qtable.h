@@ -12,6 +12,9 @@ class SuValue;
 class Table : public Query {
 public:
 	explicit Table(const char* s);
+	Query* clone() const override {
+		return new Table(*this);
+	}
 	void out(Ostream& os) const override;
 	Fields columns() override;
 	Indexes indexes() override;
@@ -19,11 +22,14 @@ public:
 	virtual float iselsize(const Fields& index, const Iselects& isels);
 	double optimize2(const Fields& index, const Fields& needs,
 		const Fields& firstneeds, bool is_cursor, bool freeze) override;
-	void select_index(const Fields& index);
+	void select_index(const Fields& index, bool keyonly = false);
 	// estimated sizes
 	double nrecords() override;
 	int recordsize() override;
 	int columnsize() override;
+	double ndistinct(const Fields& flds) override;
+	// from column statistics, -1 if there are none, overridden by tests
+	virtual double colfrac(const gcstring& col, const Iselect& isel);
 	virtual int keysize(const Fields& index); // overridden by select tests
 	virtual int totalsize();
 	virtual int indexsize(const Fields& index);
@@ -66,4 +72,7 @@ protected:
 
 public:
 	const bool singleton = false; // i.e. key()
+	// the index has all the needed fields so get can skip the data records
+	// turned off by query_setup for updateable queries
+	bool keyonly = false;
 };
@@ -22,6 +22,23 @@ Record row_to_key(
 	return key;
 }
 
+// position merged runs the same way get positions the in memory index
+static void seek_runs(TempRuns* runs, Dir dir, const Keyrange& sel) {
+	if (dir == NEXT)
+		runs->seek(sel.org);
+	else { // dir == PREV
+		Record end = sel.end.dup();
+		end.addmax();
+		runs->seek(end); // first key >= end
+		if (runs->eof())
+			runs->last();
+		else
+			runs->prev();
+		while (!runs->eof() && runs->key().prefixgt(sel.end))
+			runs->prev();
+	}
+}
+
 // TempIndex1 --------------------------------------------------------
 
 TempIndex1::TempIndex1(Query* s, const Fields& ci, bool u)
@@ -56,10 +73,30 @@ void TempIndex1::iterate_setup(Dir dir) {
 		td->addref(row.data[1].ptr());
 		// WARNING: assumes data is always second in row
 		verify(index->insert(VFslot(key, row.data[1].to_int64())));
+		if (td->size() > size_t(tempindex_memory)) {
+			spill();
+			index = new VFtree(td = new TempDest);
+		}
+	}
+	if (runs) {
+		spill();
+		index = nullptr;
+		return;
 	}
 	iter = (dir == NEXT ? index->first() : index->last());
 }
 
+// write the in memory index to the temporary file as a sorted run
+void TempIndex1::spill() {
+	if (!runs)
+		runs = new TempRuns;
+	for (iter = index->first(); !iter.eof(); ++iter)
+		runs->add(iter->key,
+			lisp(Record::from_int64(iter->adr, theDB()->mmf)));
+	runs->end_run();
+	index->free();
+}
+
 void TempIndex1::select(const Fields& selindex, Record from, Record to) {
 	verify(prefix(order, selindex));
 	sel.org = from;
@@ -79,7 +116,9 @@ Row TempIndex1::get(Dir dir) {
 	}
 	if (rewound) {
 		rewound = false;
-		if (dir == NEXT)
+		if (runs)
+			seek_runs(runs, dir, sel);
+		else if (dir == NEXT)
 			iter.seek(sel.org);
 		else { // dir == PREV
 			Record end = sel.end.dup();
@@ -91,17 +130,23 @@ Row TempIndex1::get(Dir dir) {
 				while (!iter.eof() && iter->key.prefixgt(sel.end))
 					--iter;
 		}
-	} else if (dir == NEXT)
+	} else if (runs && dir == NEXT)
+		runs->next();
+	else if (runs) // dir == PREV
+		runs->prev();
+	else if (dir == NEXT)
 		++iter;
 	else // dir == PREV
 		--iter;
-	if (iter.eof()) {
+	if (runs ? runs->eof() : iter.eof()) {
 		rewound = true;
 		return Eof;
 	}
 
 	// TODO: put iter->key into row
-	Row row(lisp(Record(), Record::from_int64(iter->adr, theDB()->mmf)));
+	Row row(lisp(Record(),
+		runs ? runs->data()[0]
+			 : Record::from_int64(iter->adr, theDB()->mmf)));
 
 	// TODO: should be able to keydup iter->key
 	Record key = row_to_key(hdr, row, order);
@@ -121,6 +166,8 @@ Row TempIndex1::get(Dir dir) {
 void TempIndex1::close(Query* q) {
 	if (index)
 		index->free();
+	if (runs)
+		runs->close();
 	Query1::close(q);
 }
 
@@ -152,10 +199,34 @@ void TempIndexN::iterate_setup(Dir dir) {
 		for (Lisp<Record> rs = row.data; !nil(rs); ++rs)
 			td->addref(rs->ptr());
 		verify(index->insert(VVslot(key, &d)));
+		if (td->size() > size_t(tempindex_memory)) {
+			spill();
+			index = new VVtree(td = new TempDest);
+		}
+	}
+	if (runs) {
+		spill();
+		index = nullptr;
+		return;
 	}
 	iter = (dir == NEXT ? index->first() : index->last());
 }
 
+// write the in memory index to the temporary file as a sorted run
+void TempIndexN::spill() {
+	if (!runs)
+		runs = new TempRuns;
+	for (iter = index->first(); !iter.eof(); ++iter) {
+		Vdata* d = iter->data;
+		Records rs;
+		for (int i = d->n - 1; i >= 0; --i)
+			rs.push(Record::from_int(d->r[i], theDB()->mmf));
+		runs->add(iter->key, rs);
+	}
+	runs->end_run();
+	index->free();
+}
+
 void TempIndexN::select(const Fields& selindex, Record from, Record to) {
 	verify(prefix(order, selindex));
 	sel.org = from;
@@ -175,7 +246,9 @@ Row TempIndexN::get(Dir dir) {
 	}
 	if (rewound) {
 		rewound = false;
-		if (dir == NEXT)
+		if (runs)
+			seek_runs(runs, dir, sel);
+		else if (dir == NEXT)
 			iter.seek(sel.org);
 		else { // dir == PREV
 			Record end = sel.end.dup();
@@ -187,19 +260,27 @@ Row TempIndexN::get(Dir dir) {
 				while (!iter.eof() && iter->key.prefixgt(sel.end))
 					--iter;
 		}
-	} else if (dir == NEXT)
+	} else if (runs && dir == NEXT)
+		runs->next();
+	else if (runs) // dir == PREV
+		runs->prev();
+	else if (dir == NEXT)
 		++iter;
 	else // dir == PREV
 		--iter;
-	if (iter.eof()) {
+	if (runs ? runs->eof() : iter.eof()) {
 		rewound = true;
 		return Eof;
 	}
 
-	Vdata* d = iter->data;
 	Records rs;
-	for (int i = d->n - 1; i >= 0; --i)
-		rs.push(Record::from_int(d->r[i], theDB()->mmf));
+	if (runs)
+		rs = runs->data();
+	else {
+		Vdata* d = iter->data;
+		for (int i = d->n - 1; i >= 0; --i)
+			rs.push(Record::from_int(d->r[i], theDB()->mmf));
+	}
 	Row row(rs);
 
 	Record key = row_to_key(hdr, row, order);
@@ -220,5 +301,87 @@ Row TempIndexN::get(Dir dir) {
 void TempIndexN::close(Query* q) {
 	if (index)
 		index->free();
+	if (runs)
+		runs->close();
 	Query1::close(q);
 }
+
+// tests ------------------------------------------------------------
+
+#include "testing.h"
+#include "tempdb.h"
+#include "ostreamstr.h"
+#include <utility>
+
+static void req(int tran, const char* s) {
+	except_if(!database_request(tran, s), "FAILED: " << s);
+}
+
+// the first node of type T down the chain of single sources
+template <class T>
+static T* find_node(Query* q) {
+	while (q) {
+		if (auto t = dynamic_cast<T*>(q))
+			return t;
+		auto q1 = dynamic_cast<Query1*>(q);
+		q = q1 ? q1->source : nullptr;
+	}
+	return nullptr;
+}
+
+// rows must come out by name, and by id (the source order) within a name
+static void check_order(Query* q, Dir dir, int nrows) {
+	Header hdr = q->header();
+	q->rewind();
+	std::pair<gcstring, int> prev;
+	int n = 0;
+	for (Row row; Query::Eof != (row = q->get(dir)); ++n) {
+		std::pair<gcstring, int> cur(row.getval(hdr, "name").gcstr(),
+			row.getval(hdr, "id").integer());
+		if (n > 0)
+			verify(dir == NEXT ? prev < cur : cur < prev);
+		prev = cur;
+	}
+	assert_eq(n, nrows);
+}
+
+TEST(qtempindex_spill) {
+	TempDB tempdb;
+	const int NROWS = 500;
+	int tran = theDB()->transaction(READWRITE);
+	database_admin("create nums (id, name) key(id)");
+	database_admin("create other (id, extra) key(id)");
+	for (int i = 0; i < NROWS; ++i) {
+		OstreamStr os;
+		os << "insert{id: " << i << ", name: 'n" << (i * 37) % 100
+		   << "'} into nums";
+		req(tran, os.str());
+		OstreamStr os2;
+		os2 << "insert{id: " << i << ", extra: " << i << "} into other";
+		req(tran, os2.str());
+	}
+	verify(theDB()->commit(tran));
+
+	int memory = tempindex_memory;
+	tempindex_memory = 1000; // small enough to need many runs
+	tran = theDB()->transaction(READONLY);
+
+	Query* q = query("nums sort name");
+	q->set_transaction(tran);
+	check_order(q, NEXT, NROWS);
+	auto t1 = find_node<TempIndex1>(q);
+	verify(t1 && t1->runs);
+	check_order(q, PREV, NROWS);
+	q->close(q);
+
+	q = query("nums join other sort name");
+	q->set_transaction(tran);
+	check_order(q, NEXT, NROWS);
+	auto tn = find_node<TempIndexN>(q);
+	verify(tn && tn->runs);
+	check_order(q, PREV, NROWS);
+	q->close(q);
+
+	verify(theDB()->commit(tran));
+	tempindex_memory = memory;
+}
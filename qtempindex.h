@@ -4,10 +4,14 @@
 
 #include "queryimp.h"
 #include "index.h"
+#include "tempruns.h"
 
 // sort a simple (single) source
 struct TempIndex1 : public Query1 {
 	TempIndex1(Query* s, const Fields& o, bool u);
+	Query* clone() const override {
+		return clone_sources(new TempIndex1(*this));
+	}
 	void out(Ostream& os) const override;
 	Indexes indexes() override;
 	Fields columns() override {
@@ -25,9 +29,13 @@ struct TempIndex1 : public Query1 {
 		return source->output(r);
 	}
 	void close(Query* q) override;
+	bool needs_whole_rows() const override { // only saves the data record
+		return true;
+	}
 
 private:
 	void iterate_setup(Dir dir);
+	void spill();
 
 	Fields order;
 	bool unique;
@@ -35,13 +43,18 @@ private:
 	bool rewound;
 	VFtree* index;
 	VFtree::iterator iter;
+	TempRuns* runs = nullptr; // if too big for memory
 	Keyrange sel;
 	Header hdr;
+	friend void test_qtempindex_spill();
 };
 
 // sort a complex (multiple) source
 struct TempIndexN : public Query1 {
 	TempIndexN(Query* s, const Fields& o, bool u);
+	Query* clone() const override {
+		return clone_sources(new TempIndexN(*this));
+	}
 	void out(Ostream& os) const override;
 	Indexes indexes() override;
 	Fields columns() override {
@@ -64,6 +77,7 @@ struct TempIndexN : public Query1 {
 
 private:
 	void iterate_setup(Dir dir);
+	void spill();
 
 	Fields order;
 	bool unique;
@@ -71,6 +85,8 @@ private:
 	bool rewound;
 	VVtree* index;
 	VVtree::iterator iter;
+	TempRuns* runs = nullptr; // if too big for memory
 	Keyrange sel;
 	Header hdr;
+	friend void test_qtempindex_spill();
 };
@@ -4,11 +4,18 @@
 #include "queryimp.h"
 #include "qtempindex.h"
 #include "qsort.h"
+#include "qtable.h"
 #include "database.h"
 #include "trace.h"
 #include "ostreamstr.h"
 #include "exceptimp.h"
+#include "hashmap.h"
+#include "sesviews.h"
+#include "fibers.h" // for tls() for session views
+#include <cctype>
 #include <cmath>
+#include <vector>
+#include <algorithm>
 
 Row Query::Eof;
 
@@ -24,10 +31,106 @@ Query* query_setup(Query* q, bool is_cursor) {
 	if (q->qcost >= IMPOSSIBLE)
 		except("invalid query");
 	q = q->addindex();
+	need_data(q, q->updateable());
 	trace_tempindex(q);
 	return q;
 }
 
+// turn off Table keyonly where the data records are required
+// i.e. for updates or by operations that look at whole rows
+void need_data(Query* q, bool need) {
+	if (Table* t = dynamic_cast<Table*>(q)) {
+		if (need)
+			t->keyonly = false;
+		return;
+	}
+	need = need || q->needs_whole_rows();
+	if (Query2* q2 = dynamic_cast<Query2*>(q)) {
+		need_data(q2->source, need);
+		need_data(q2->source2, need);
+	} else if (Query1* q1 = dynamic_cast<Query1*>(q))
+		need_data(q1->source, need);
+}
+
+// plan cache -------------------------------------------------------
+
+// Optimized queries are cached by their text and copied for each use
+// so repeated queries skip parsing, transform, and optimize.
+// The cache is cleared by any schema change (Database::schema_version).
+// Plans also depend on table sizes so they are redone after PLAN_REUSES.
+// Session views are part of the key since they can change what names mean.
+
+const int PLAN_CACHE_SIZE = 500;
+const int PLAN_REUSES = 100;
+
+int plan_cache_hits = 0;
+int plan_cache_misses = 0;
+
+struct Plan {
+	Query* q = nullptr;
+	int uses = 0;
+};
+static HashMap<gcstring, Plan> plans;
+static int plans_version = -1;
+
+// collapse whitespace outside of strings so formatting doesn't matter
+static gcstring plan_key(const char* s, bool is_cursor) {
+	OstreamStr os(strlen(s) + 1);
+	os << (is_cursor ? 'C' : 'Q');
+	char quote = 0;
+	bool space = false;
+	for (; *s; ++s) {
+		char c = *s;
+		if (quote) {
+			if (c == '\\' && s[1])
+				os << c << *++s;
+			else
+				os << c;
+			if (c == quote)
+				quote = 0;
+			continue;
+		}
+		if (isspace(c)) {
+			space = true;
+			continue;
+		}
+		if (space && os.size() > 1)
+			os << ' ';
+		space = false;
+		if (c == '"' || c == '\'' || c == '`')
+			quote = c;
+		os << c;
+	}
+	if (SesViews* sv = tls().session_views) {
+		std::vector<gcstring> views;
+		for (auto i = sv->begin(); i != sv->end(); ++i)
+			views.push_back(i->key + "=" + i->val);
+		std::sort(views.begin(), views.end());
+		for (auto& v : views)
+			os << '\n' << v;
+	}
+	return os.gcstr();
+}
+
+Query* query_cached(const char* s, bool is_cursor) {
+	if (plans_version != Database::schema_version) {
+		plans.clear();
+		plans_version = Database::schema_version;
+	}
+	gcstring key = plan_key(s, is_cursor);
+	Plan* p = plans.find(key);
+	if (p && ++p->uses <= PLAN_REUSES) {
+		++plan_cache_hits;
+		return p->q->clone();
+	}
+	++plan_cache_misses;
+	Query* q = query(s, is_cursor);
+	if (int(plans.size()) >= PLAN_CACHE_SIZE)
+		plans.clear();
+	plans[key] = Plan{q, 0};
+	return q->clone();
+}
+
 static bool hasTempIndex(Query* q) {
 	if (dynamic_cast<TempIndex1*>(q) || dynamic_cast<TempIndexN*>(q))
 		return true;
@@ -942,7 +1045,7 @@ static void process(int i) {
 	}
 
 	{ // read prev
-		q = query(s);
+		q = query_cached(s); // a copy of the cached plan
 		q->set_transaction(t);
 		OstreamStr out;
 		for (Fields f = hdr.columns(); !nil(f); ++f)
@@ -1122,6 +1225,37 @@ TEST(query_history) {
 		except_err("diff " << diff);
 }
 
+TEST(query_plan_cache) {
+	TempDB tempdb;
+	adm("create cus(cnum, abbrev, name) key(cnum) key(abbrev)");
+	int hits = plan_cache_hits;
+	int misses = plan_cache_misses;
+
+	Query* q1 = query_cached("cus where name = 'a  b'");
+	Query* q2 = query_cached("  cus\twhere   name = 'a  b' ");
+	verify(q1 != q2);
+	assert_eq(gcstring(OSTR(*q1)), gcstring(OSTR(*q2)));
+	query_cached("cus where name = 'a b'"); // different string
+	query_cached("cus where name = 'a  b'", IS_CURSOR);
+	assert_eq(plan_cache_hits - hits, 1);
+	assert_eq(plan_cache_misses - misses, 3);
+
+	adm("alter cus create index(name)"); // invalidates cache
+	query_cached("cus where name = 'a  b'");
+	assert_eq(plan_cache_hits - hits, 1);
+	assert_eq(plan_cache_misses - misses, 4);
+
+	// the same text means something else with a different session view
+	set_session_view("sv", "cus where cnum = 1");
+	gcstring s1 = OSTR(*query_cached("sv"));
+	set_session_view("sv", "cus where abbrev = 'a'");
+	gcstring s2 = OSTR(*query_cached("sv"));
+	remove_session_view("sv");
+	verify(s1 != s2);
+	verify(s2.find("abbrev") != -1);
+	assert_eq(plan_cache_misses - misses, 6);
+}
+
 TEST(query_prefixed) {
 	Fields index_nil;
 	Fields by_nil;
@@ -133,6 +133,10 @@ public:
 
 	virtual void close(Query*) = 0;
 
+	// copy an optimized query that has not been iterated yet
+	// used by the plan cache in query_cached
+	virtual Query* clone() const = 0;
+
 	// protected:
 	virtual void out(Ostream&) const = 0;
 	const char* strategy();
@@ -152,10 +156,19 @@ public:
 	virtual double nrecords() = 0;
 	virtual int recordsize() = 0;
 	virtual int columnsize() = 0;
+	// estimated number of distinct values of fields, -1 if unknown
+	virtual double ndistinct(const Fields& /*flds*/) {
+		return -1;
+	}
 	QueryCache cache;
 
 	// used to insert TempIndex nodes
 	virtual Query* addindex(); // redefined by Query1 and Query2
+	// true if this looks at fields of its source rows beyond its needs
+	// so the source Tables can't use keyonly
+	virtual bool needs_whole_rows() const {
+		return false;
+	}
 
 	double qcost = 0;
 
@@ -166,9 +179,14 @@ private:
 enum { IS_CURSOR = true };
 
 Query* query(const char* s, bool is_cursor = false);
+// used by DbmsLocal, returns a copy of a cached plan if possible
+Query* query_cached(const char* s, bool is_cursor = false);
+extern int plan_cache_hits;
+extern int plan_cache_misses;
 Query* parse_query(const char* s);
 Expr* parse_expr(const char* s);
 Query* query_setup(Query* q, bool is_cursor = false);
+void need_data(Query* q, bool need);
 void trace_tempindex(Query* q);
 
 Ostream& operator<<(Ostream& os, const Query& query);
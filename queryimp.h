@@ -38,6 +38,9 @@ public:
 	int columnsize() override {
 		return source->columnsize();
 	}
+	double ndistinct(const Fields& flds) override {
+		return subset(source->columns(), flds) ? source->ndistinct(flds) : -1;
+	}
 
 	Lisp<Fixed> fixed() const override {
 		return source->fixed();
@@ -50,6 +53,13 @@ public:
 	}
 
 	Query* source;
+
+protected:
+	// used by clone to replace the copied source with a copy of its own
+	Query* clone_sources(Query1* q) const {
+		q->source = source->clone();
+		return q;
+	}
 };
 
 bool isfixed(Lisp<Fixed> f, const gcstring& field);
@@ -80,6 +90,9 @@ public:
 	Lisp<Fixed> fixed() const override {
 		return Lisp<Fixed>();
 	}
+	double ndistinct(const Fields& /*flds*/) override {
+		return -1;
+	}
 
 	void close(Query* q) override {
 		source->close(q);
@@ -87,6 +100,13 @@ public:
 	}
 
 	Query* source2;
+
+protected:
+	Query* clone_sources(Query2* q) const {
+		q->source = source->clone();
+		q->source2 = source2->clone();
+		return q;
+	}
 };
 
 struct Keyrange {
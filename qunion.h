@@ -7,6 +7,9 @@
 class Union : public Compatible {
 public:
 	Union(Query* s1, Query* s2);
+	Query* clone() const override {
+		return clone_sources(new Union(*this));
+	}
 	void out(Ostream& os) const override;
 	Fields columns() override {
 		return allcols;
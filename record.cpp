@@ -205,6 +205,10 @@ Mmoffset Record::off() const {
 	return dbrep->offset;
 }
 
+bool Record::isdb() const {
+	return rep && rep->buf[0] == DBMODE;
+}
+
 // the number of elements
 int Record::size() const {
 	if (!rep)
@@ -55,6 +55,7 @@ public:
 	void truncate(int n);
 	void* ptr() const;
 	Mmoffset off() const;
+	bool isdb() const; // i.e. off() is valid
 	friend bool nil(Record r);
 	bool operator==(Record r) const;
 	bool operator<(Record r) const;
@@ -96,6 +96,24 @@ Lisp<int> Header::output_fldsyms() const {
 	return fldsyms;
 }
 
+// returns the positions of a column, in the order Row::find checks them
+ColSlots Header::slots(const gcstring& col) const {
+	if (!colslots)
+		colslots = new HashMap<gcstring, ColSlots>();
+	if (ColSlots* p = colslots->find(col))
+		return *p;
+	ColSlots slots;
+	if (col != "-") {
+		short rec = 0;
+		for (Lisp<Fields> f = flds; !nil(f); ++f, ++rec) {
+			int i = search(*f, col);
+			if (i != -1)
+				slots.push(ColSlot{rec, short(i)});
+		}
+	}
+	return (*colslots)[col] = slots.reverse();
+}
+
 int Header::timestamp_field() const {
 	if (!timestamp) {
 		timestamp = -1; // no timestamp
@@ -125,6 +143,16 @@ Value Row::getval(const Header& hdr, const gcstring& col) const {
 	return surec->getdata(symbol(col));
 }
 
+Value Row::getval(const Header& hdr, ColRef& col) const {
+	Which w = find(col.slots(hdr));
+	if (w.offset >= 0 || !member(hdr.cols, col.col))
+		return ::unpack(getraw(w));
+	// else rule
+	if (!surec)
+		(void) get_surec(hdr);
+	return surec->getdata(symbol(col.col));
+}
+
 gcstring Row::getrawval(const Header& hdr, const gcstring& col) const {
 	Which w = find(hdr, col);
 	if (w.offset >= 0)
@@ -146,19 +174,27 @@ gcstring Row::getraw(const Header& hdr, const gcstring& col) const {
 	return getraw(find(hdr, col));
 }
 
+gcstring Row::getraw(const Header& hdr, ColRef& col) const {
+	return getraw(find(col.slots(hdr)));
+}
+
 gcstring Row::getraw(const Which& w) const {
 	return w.offset < 0 ? gcstring("") : (*w.records).getraw(w.offset);
 }
 
-Row::Which Row::find(const Header& hdr, const gcstring& col) const {
-	if (col == "-")
-		return Which(data, -1);
-	int i = -1;
+// returns the first slot whose record is present in this row
+Row::Which Row::find(const ColSlots& slots) const {
 	Records d = data;
-	for (Lisp<Fields> f = hdr.flds; !nil(f); ++f, ++d)
-		if (!nil(d) && !nil(*d) && -1 != (i = search(*f, col)))
+	int rec = 0;
+	for (ColSlots s = slots; !nil(s); ++s) {
+		for (; rec < s->rec && !nil(d); ++rec)
+			++d;
+		if (nil(d))
 			break;
-	return Which(d, i);
+		if (!nil(*d))
+			return Which(d, s->fld);
+	}
+	return Which(data, -1);
 }
 
 bool equal(const Header& hdr, const Row& r1, const Row& r2) {
@@ -195,6 +231,8 @@ const int HUGE_RECORD = 256 * 1024;
 static bool shouldRebuild(const Row& row, const Header& hdr, Record rec) {
 	if (row.data.size() > 2)
 		return true; // must rebuild
+	if (row.data.size() == 2 && nil(rec))
+		return true; // data not read e.g. Table keyonly
 	if (rec.cursize() < SMALL_RECORD)
 		return false;
 	return deletedSize(row, hdr) > rec.cursize() / 3;
@@ -316,6 +354,35 @@ TEST(row_equal) {
 	verify(!equal(hdr, x, y));
 }
 
+TEST(row_slots) {
+	Lisp<Fields> flds;
+	flds.push(lisp(gcstring("a"), gcstring("b")));
+	flds.push(lisp(gcstring("c"), gcstring("a")));
+	Header hdr(flds.reverse(), Fields());
+	assert_eq(hdr.slots("x").size(), 0);
+	assert_eq(hdr.slots("-").size(), 0);
+	ColSlots s = hdr.slots("a");
+	assert_eq(s.size(), 2);
+	verify(s[0].rec == 0 && s[0].fld == 0);
+	verify(s[1].rec == 1 && s[1].fld == 1);
+
+	Record r1;
+	r1.addval("one");
+	Record r2;
+	r2.addval("two");
+	r2.addval("three");
+	Row row(lisp(r1, r2));
+	ColRef a("a");
+	verify(row.getval(hdr, a) == Value(new SuString("one")));
+	Row row2(lisp(Record(), r2)); // first record missing, like union
+	verify(row2.getval(hdr, a) == Value(new SuString("three")));
+	verify(row2.getstr(hdr, "c") == "two");
+
+	Header hdr2(mkhdr("b", "c", "a"));
+	Row row3(lisp(r2));
+	verify(row3.getraw(hdr2, a) == ""); // rebinds to new header
+}
+
 TEST(row_timestamp) {
 	verify(mkhdr("a", "b", "c").timestamp_field() == -1);
 	verify(mkhdr("a", "b_TS", "c_TS").timestamp_field() == symnum("b_TS"));
@@ -5,6 +5,7 @@
 #include "lisp.h"
 #include "record.h"
 #include "gcstring.h"
+#include "hashmap.h"
 #include <utility> // for pair
 #include <algorithm>
 using std::min;
@@ -12,7 +13,16 @@ using std::min;
 typedef Lisp<gcstring> Fields;
 typedef Lisp<Record> Records;
 
+// a position where a column may be found in a Row
+struct ColSlot {
+	short rec; // index into Row data
+	short fld; // field within that record
+};
+typedef Lisp<ColSlot> ColSlots;
+
 class Header {
+	friend class ColRef;
+
 public:
 	Header() {
 	}
@@ -31,6 +41,7 @@ public:
 	Fields schema() const;
 	Lisp<int> output_fldsyms() const;
 	int timestamp_field() const;
+	ColSlots slots(const gcstring& col) const;
 
 	Lisp<Fields> flds;
 	Fields cols;
@@ -38,6 +49,29 @@ public:
 private:
 	mutable Lisp<int> fldsyms;
 	mutable int timestamp = 0;
+	// column -> slots, built on first use and shared by copies
+	mutable HashMap<gcstring, ColSlots>* colslots = nullptr;
+};
+
+// a column bound to the slots of the last Header it was used with
+// so per row access doesn't have to look up the column name
+class ColRef {
+public:
+	explicit ColRef(const gcstring& c) : col(c) {
+	}
+	const ColSlots& slots(const Header& hdr) {
+		if (hdr.colslots != bound || !bound) {
+			cached = hdr.slots(col);
+			bound = hdr.colslots;
+		}
+		return cached;
+	}
+
+	gcstring col;
+
+private:
+	const void* bound = nullptr;
+	ColSlots cached;
 };
 
 inline bool nil(const Header& hdr) {
@@ -65,8 +99,10 @@ public:
 	explicit Row(const Records& d) : data(d) {
 	}
 	gcstring getraw(const Header& hdr, const gcstring& colname) const;
+	gcstring getraw(const Header& hdr, ColRef& col) const;
 	gcstring getrawval(const Header& hdr, const gcstring& col) const;
 	Value getval(const Header& hdr, const gcstring& colname) const;
+	Value getval(const Header& hdr, ColRef& col) const;
 	gcstring getstr(const Header& hdr, const gcstring& colname) const;
 	bool operator==(const Row& r) const {
 		return data == r.data;
@@ -149,7 +185,10 @@ private:
 		const Records records;
 		short offset;
 	};
-	Which find(const Header& hdr, const gcstring& col) const;
+	Which find(const Header& hdr, const gcstring& col) const {
+		return find(hdr.slots(col));
+	}
+	Which find(const ColSlots& slots) const;
 	gcstring getraw(const Which& w) const;
 
 	int tran = -1;
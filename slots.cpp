@@ -3,7 +3,244 @@
 
 #include "slots.h"
 #include "std.h"
+#include "tmpalloc.h"
+#include "ostream.h"
+
+// Pkey -------------------------------------------------------------
+
+// Pslots keys are encoded so that comparing encodings with memcmp
+// gives the same order as comparing the Records.
+// Each field is followed by 0,0 and a 0 within a field is written as 0,1
+
+static int enclen(Record r) {
+	int n = 0;
+	for (int i = 0; i < r.size(); ++i) {
+		gcstring f = r.getraw(i);
+		n += f.size() + 2 + std::count(f.ptr(), f.ptr() + f.size(), 0);
+	}
+	return n;
+}
+
+static void encode(Record r, uint8_t* dst) {
+	for (int i = 0; i < r.size(); ++i) {
+		gcstring f = r.getraw(i);
+		for (auto s = f.ptr(), lim = s + f.size(); s < lim; ++s)
+			if ((*dst++ = *s) == 0)
+				*dst++ = 1;
+		*dst++ = 0;
+		*dst++ = 0;
+	}
+}
+
+Pkey::operator Record() const {
+	if (!encoded())
+		return rec;
+	// big enough since the encoding has two bytes of overhead per field
+	Record r(size() + 8);
+	char* fld = tmpalloc(size());
+	int nf = 0;
+	for (int i = 0; i < size(); ++i) {
+		uint8_t c = at(i);
+		if (c != 0)
+			fld[nf++] = c;
+		else if (at(++i) == 1)
+			fld[nf++] = 0;
+		else {
+			r.addraw(gcstring::noalloc(fld, nf));
+			nf = 0;
+		}
+	}
+	return r;
+}
+
+Record Pkey::dup() const {
+	return encoded() ? Record(*this) : rec.dup();
+}
+
+// compares the encoding of r a byte at a time, so nothing is allocated
+int Pkey::compare(Record r) const {
+	if (!encoded())
+		return rec < r ? -1 : rec == r ? 0 : 1;
+	int pos = 0;
+	// compares the next byte of the encoding to c
+	auto cmp = [&](int c) {
+		return pos < size() ? at(pos++) - c : -1;
+	};
+	int c;
+	for (int i = 0; i < r.size(); ++i) {
+		gcstring f = r.getraw(i);
+		auto s = reinterpret_cast<const uint8_t*>(f.ptr());
+		for (auto lim = s + f.size(); s < lim; ++s)
+			if ((c = cmp(*s)) || (*s == 0 && (c = cmp(1))))
+				return c;
+		if ((c = cmp(0)) || (c = cmp(0)))
+			return c;
+	}
+	return pos < size() ? 1 : 0;
+}
+
+Ostream& operator<<(Ostream& os, const Pkey& key) {
+	return os << key.dup();
+}
+
+// Pslots -----------------------------------------------------------
+
+// the size of a slot with an n byte suffix
+static int slotsize(int n) {
+	return 1 + (n < 0x80 ? 1 : 2) + n;
+}
+
+// returns the suffix length of the slot at p and advances p to the suffix
+static int getlen(const uint8_t*& p) {
+	int n = *p++;
+	if (n & 0x80)
+		n = ((n & 0x7f) << 8) | *p++;
+	return n;
+}
+
+static int common(const uint8_t* x, int nx, const uint8_t* y, int ny) {
+	int n = std::min(nx, ny);
+	int i = 0;
+	while (i < n && x[i] == y[i])
+		++i;
+	return i;
+}
+
+Pslot Pslots::operator[](int i) {
+	if (old())
+		return Pslot(vs()[i].key);
+	verify(0 <= i && i < sz);
+	const uint8_t* p = buf + offsets()[i];
+	int k = *p++;
+	int n = getlen(p);
+	return Pslot(prefix(), k, p, n);
+}
+
+// copies the encoding, without decoding the key
+bool Pslots::append(const Pslot& x) {
+	if (old() || !x.key.encoded())
+		return insert(end(), Vslot(x));
+	int n = x.key.size();
+	auto enc = reinterpret_cast<uint8_t*>(tmpalloc(n));
+	x.key.copyto(enc);
+	return add(sz, enc, n);
+}
+
+bool Pslots::insert(const iterator& position, const Vslot& x) {
+	if (old())
+		return vs().insert(vs().begin() + position.i, x);
+	int n = enclen(x.key);
+	auto enc = reinterpret_cast<uint8_t*>(tmpalloc(n));
+	encode(x.key, enc);
+	return add(position.i, enc, n);
+}
+
+// adds an encoded key at position i, returns false if it won't fit
+// the first key added to an empty node becomes the prefix
+bool Pslots::add(int i, const uint8_t* enc, int n) {
+	const uint8_t* pre = prefix();
+	int pl = plen;
+	if (sz == 0) {
+		pre = enc;
+		pl = std::min(n, int(MAXPREFIX));
+	}
+	int k = common(enc, n, pre, pl);
+	int m = n - k;
+	int need = slotsize(m) + sizeof(short) + (sz == 0 ? pl : 0);
+	if (need >= remaining())
+		return false;
+	if (sz == 0) {
+		plen = pl;
+		prev = BUFSIZE - pl;
+		memcpy(buf + prev, enc, pl);
+	}
+	// prepend to heap
+	prev -= slotsize(m);
+	uint8_t* p = buf + prev;
+	*p++ = k;
+	if (m < 0x80)
+		*p++ = m;
+	else {
+		*p++ = 0x80 | (m >> 8);
+		*p++ = m & 0xff;
+	}
+	memcpy(p, enc + k, m);
+	// insert into vector
+	short* t = offsets();
+	std::copy_backward(t + i, t + sz, t + sz + 1);
+	t[i] = prev;
+	++sz;
+	return true;
+}
+
+void Pslots::erase(const iterator& position) {
+	if (old()) {
+		vs().erase(vs().begin() + position.i);
+		return;
+	}
+	int i = position.i;
+	verify(0 <= i && i < sz);
+	// erase from heap
+	short* t = offsets();
+	int offset = t[i];
+	const uint8_t* p = buf + offset + 1;
+	int n = slotsize(getlen(p));
+	memmove(buf + prev + n, buf + prev, offset - prev);
+	prev += n;
+	// erase from vector
+	std::copy(t + i + 1, t + sz, t + i);
+	--sz;
+	// adjust vector
+	for (int j = 0; j < sz; ++j)
+		if (t[j] < offset)
+			t[j] += n;
+	if (sz == 0) {
+		prev = BUFSIZE;
+		plen = 0;
+	}
+}
+
+void Pslots::erase(const iterator& first, const iterator& last) {
+	for (iterator i = last; i != first; --i)
+		erase(i - 1);
+	if (first.i == 0 && !old() && sz > 0)
+		reprefix();
+}
+
+// after erasing from the front (i.e. split) the prefix may not suit
+// the remaining keys, so rebuild with the new first key as the prefix
+// if that takes less space
+void Pslots::reprefix() {
+	int n = sz;
+	auto lens = reinterpret_cast<int*>(tmpalloc(n * sizeof(int)));
+	int total = 0;
+	for (int i = 0; i < n; ++i)
+		total += lens[i] = (*this)[i].key.size();
+	auto keys = reinterpret_cast<uint8_t*>(tmpalloc(total));
+	uint8_t* p = keys;
+	for (int i = 0; i < n; p += lens[i++])
+		(*this)[i].key.copyto(p);
+
+	int pl = std::min(lens[0], int(MAXPREFIX));
+	int size = pl;
+	p = keys;
+	for (int i = 0; i < n; p += lens[i++])
+		size += slotsize(lens[i] - common(p, lens[i], keys, pl));
+	if (size >= BUFSIZE - prev)
+		return;
+
+	sz = 0;
+	prev = BUFSIZE;
+	plen = 0;
+	p = keys;
+	for (int i = 0; i < n; p += lens[i++])
+		verify(add(i, p, lens[i]));
+}
+
+// tests ------------------------------------------------------------
+
 #include "testing.h"
+#include <vector>
 
 TEST(slots_vslot) {
 	Mmoffset n = (int64_t) 3 * 1024 * 1024 * 1024;
@@ -27,3 +264,103 @@ TEST(slots_vfslot) {
 	assert_eq(vfs2.key, r);
 	assert_eq(vfs2.adr, n);
 }
+
+static Record rec(const gcstring& a) {
+	Record r;
+	r.addraw(a);
+	return r;
+}
+static Record rec(const gcstring& a, const gcstring& b) {
+	Record r = rec(a);
+	r.addraw(b);
+	return r;
+}
+
+TEST(slots_pkey) {
+	Record recs[] = {Record(), rec(""), rec("", ""), rec("", "a"), rec("a"),
+		rec("a", ""), rec(gcstring("a\0", 2)), rec(gcstring("a\0b", 3)),
+		rec("a\x01"), rec("a", "b"), rec("ab"), rec("b"), rec("\x7f"),
+		rec("\xff")};
+	for (auto x : recs) {
+		int n = enclen(x);
+		auto enc = new (noptrs) uint8_t[n];
+		encode(x, enc);
+		Pkey kx(enc, 0, enc, n);
+		assert_eq(Record(kx), x);
+		for (auto y : recs) {
+			int cmp = x < y ? -1 : y < x ? 1 : 0;
+			int c = kx.compare(y);
+			assert_eq(c < 0 ? -1 : c > 0 ? 1 : 0, cmp);
+		}
+	}
+}
+
+static Record custkey(int i) {
+	Record r;
+	r.addval("customer name prefix");
+	r.addval(i);
+	return r;
+}
+
+TEST(slots_pslots) {
+	Pslots slots;
+	const int empty = slots.remaining();
+	int n = 0;
+	for (;; ++n) {
+		Vslot x(custkey((n * 7919) % 10000));
+		if (!slots.insert(std::lower_bound(slots.begin(), slots.end(), x), x))
+			break;
+	}
+	assert_eq(slots.size(), n);
+	Vslots vslots;
+	int nv = 0;
+	for (; vslots.insert(vslots.end(), Vslot(custkey(nv))); ++nv)
+		;
+	verify(n > 2 * nv);
+
+	std::vector<Record> keys;
+	for (int i = 0; i < n; ++i) {
+		keys.push_back(slots[i].key.dup());
+		if (i > 0)
+			verify(Vslot(keys[i - 1]) < slots[i]);
+		Vslot x(keys[i]);
+		auto pos = std::lower_bound(slots.begin(), slots.end(), x);
+		assert_eq(pos - slots.begin(), i);
+	}
+
+	// erasing from the front changes the prefix
+	int half = n / 2;
+	slots.erase(slots.begin(), slots.begin() + half);
+	assert_eq(slots.size(), n - half);
+	for (int i = 0; i < slots.size(); ++i)
+		assert_eq(slots[i].key, keys[half + i]);
+
+	while (!slots.empty())
+		slots.erase(slots.begin() + slots.size() / 2);
+	assert_eq(slots.remaining(), empty);
+	char* s = salloc(500);
+	memset(s, 'x', 500);
+	Vslot big(rec(gcstring::noalloc(s, 500)));
+	verify(slots.insert(slots.end(), big));
+	assert_eq(slots.front().key, big.key);
+}
+
+TEST(slots_pslots_old) {
+	Vslots vslots;
+	for (int i = 0; i < 10; ++i)
+		vslots.push_back(Vslot(custkey(i)));
+	auto& slots = *reinterpret_cast<Pslots*>(&vslots);
+	assert_eq(slots.size(), 10);
+	assert_eq(slots[3].key, custkey(3));
+	verify(slots.insert(slots.end(), Vslot(custkey(10))));
+	assert_eq(vslots.size(), 11);
+	slots.erase(slots.begin());
+	assert_eq(vslots.front().key, custkey(1));
+
+	Pslots newslots;
+	newslots.push_back(slots[4]);
+	Pslots copy;
+	copy.push_back(newslots.front()); // copies the encoding
+	assert_eq(copy.size(), 1);
+	assert_eq(copy.back().key, custkey(5));
+}
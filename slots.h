@@ -19,6 +19,8 @@ inline int keydup(int key) {
 	return key;
 }
 
+struct Pslot;
+
 // array of key records, used by Index
 class Vslot {
 public:
@@ -28,6 +30,7 @@ public:
 	}
 	explicit Vslot(void* k) : key(k) {
 	}
+	Vslot(const Pslot& x); // NOLINT
 	typedef Record Key;
 	Mmoffset adr() {
 		verify(key.size() > 0);
@@ -36,6 +39,7 @@ public:
 	void copy(const Vslot& from) {
 		key = from.key.dup();
 	}
+	void copy(const Pslot& from);
 	bool operator<(const Vslot& y) const {
 		return key < y.key;
 	}
@@ -150,6 +154,9 @@ public:
 		verify(sz > 0);
 		erase(end() - 1);
 	}
+	bool append(const Vslot& x) { // returns false if it won't fit
+		return insert(end(), x);
+	}
 	bool insert(const iterator& position, const Vslot& x) {
 		// prepend to heap
 		int n = x.key.cursize();
@@ -217,6 +224,234 @@ private:
 	}
 };
 
+// prefix compressed key records, used by Index ----------------------
+
+// a key from Pslots, either a Record (from a node in the old format)
+// or an encoded key split between the node prefix and the slot suffix
+// comparisons with a Record are done on the encoding, without decoding
+class Pkey {
+public:
+	explicit Pkey(Record r) : rec(r) {
+	}
+	Pkey(const uint8_t* p, int k_, const uint8_t* s, int n_)
+		: pre(p), sfx(s), k(k_), n(n_) {
+	}
+	explicit operator Record() const; // decodes
+	Record dup() const;
+	// returns < 0, 0, or > 0 like memcmp
+	int compare(Record r) const;
+	bool encoded() const {
+		return pre != nullptr;
+	}
+	// the encoded size
+	int size() const {
+		return k + n;
+	}
+	// copies the encoding to dst, which must be size()
+	void copyto(uint8_t* dst) const {
+		memcpy(dst, pre, k);
+		memcpy(dst + k, sfx, n);
+	}
+
+private:
+	uint8_t at(int i) const {
+		return i < k ? pre[i] : sfx[i - k];
+	}
+
+	Record rec;
+	const uint8_t* pre = nullptr;
+	const uint8_t* sfx = nullptr;
+	int k = 0; // the number of bytes of the node prefix
+	int n = 0; // the number of bytes of suffix
+};
+
+inline Record keydup(const Pkey& key) {
+	return key.dup();
+}
+
+inline bool operator==(const Pkey& x, Record y) {
+	return x.compare(y) == 0;
+}
+inline bool operator==(Record x, const Pkey& y) {
+	return y.compare(x) == 0;
+}
+inline bool operator!=(const Pkey& x, Record y) {
+	return x.compare(y) != 0;
+}
+inline bool operator!=(Record x, const Pkey& y) {
+	return y.compare(x) != 0;
+}
+
+Ostream& operator<<(Ostream& os, const Pkey& key);
+
+struct Pslot {
+	typedef Record Key;
+	explicit Pslot(Record r) : key(r) {
+	}
+	Pslot(const uint8_t* pre, int k, const uint8_t* sfx, int n)
+		: key(pre, k, sfx, n) {
+	}
+
+	Pkey key;
+};
+
+inline Vslot::Vslot(const Pslot& x) : key(x.key) {
+}
+
+inline void Vslot::copy(const Pslot& from) {
+	key = from.key.dup();
+}
+
+// Btree compares leaf slots with the slot being inserted or searched for
+inline bool operator<(const Pslot& x, const Vslot& y) {
+	return x.key.compare(y.key) < 0;
+}
+inline bool operator<(const Vslot& x, const Pslot& y) {
+	return y.key.compare(x.key) > 0;
+}
+inline bool operator>(const Vslot& x, const Pslot& y) {
+	return y.key.compare(x.key) < 0;
+}
+inline bool operator<=(const Vslot& x, const Pslot& y) {
+	return y.key.compare(x.key) >= 0;
+}
+inline bool operator==(const Pslot& x, const Vslot& y) {
+	return x.key.compare(y.key) == 0;
+}
+
+// Like Vslots, but keys are stored in an order preserving encoding
+// (see slots.cpp) and the leading bytes shared with the node prefix
+// are only stored once, so nodes hold more keys.
+// The prefix comes from the first key added to an empty node.
+// Each slot is the number of bytes it shares with the prefix (0 to 255)
+// followed by the length of the rest (1 or 2 bytes) and the rest.
+// Nodes written before this format don't start with MAGIC
+// and are handled as Vslots. dbcompact rewrites them in the new format.
+class Pslots {
+public:
+	Pslots() : magic(MAGIC), sz(0), prev(BUFSIZE), plen(0) { // NOLINT
+		memset(buf, 7, sizeof buf);
+	}
+	class iterator {
+		friend class Pslots;
+
+	public:
+		using difference_type = int;
+		using value_type = Pslot;
+		using pointer = const Pslot*;
+		using reference = const Pslot&;
+		using iterator_category = std::random_access_iterator_tag;
+
+		iterator() = default;
+
+		Pslot operator*() const {
+			verify(s);
+			return (*s)[i];
+		}
+		iterator& operator++() {
+			++i;
+			return *this;
+		}
+		iterator& operator+=(int n) {
+			i += n;
+			return *this;
+		}
+		iterator& operator--() {
+			verify(i > 0);
+			--i;
+			return *this;
+		}
+		iterator operator+(int d) const {
+			return iterator(s, i + d);
+		}
+		iterator operator-(int d) const {
+			return iterator(s, i - d);
+		}
+		int operator-(const iterator& iter) const {
+			return i - iter.i;
+		}
+		bool operator==(const iterator& iter) const {
+			return i == iter.i;
+		}
+		bool operator!=(const iterator& iter) const {
+			return i != iter.i;
+		}
+		bool operator<(const iterator& iter) const {
+			return i < iter.i;
+		}
+
+	private:
+		iterator(Pslots* _s, short _i) : s(_s), i(_i) {
+		}
+		Pslots* s = nullptr;
+		short i = 0;
+	};
+	bool empty() const {
+		return size() == 0;
+	}
+	int size() const {
+		return old() ? vs().size() : sz;
+	}
+	iterator begin() {
+		return iterator(this, 0);
+	}
+	iterator end() {
+		return iterator(this, size());
+	}
+	Pslot operator[](int i);
+	Pslot front() {
+		return (*this)[0];
+	}
+	Pslot back() {
+		return (*this)[size() - 1];
+	}
+	void push_back(const Vslot& x) {
+		verify(insert(end(), x));
+	}
+	void push_back(const Pslot& x) {
+		verify(append(x));
+	}
+	bool append(const Pslot& x); // returns false if it won't fit
+	void pop_back() {
+		verify(size() > 0);
+		erase(end() - 1);
+	}
+	bool insert(const iterator& position, const Vslot& x);
+	void erase(const iterator& position);
+	void erase(const iterator& first, const iterator& last);
+	int remaining() const {
+		return old() ? vs().remaining() : prev - sz * int(sizeof(short));
+	}
+
+private:
+	enum { MAGIC = -1, MAXPREFIX = 255 };
+	enum { BUFSIZE = mem - 4 * sizeof(short) };
+	bool old() const {
+		return magic != MAGIC;
+	}
+	Vslots& vs() {
+		return *reinterpret_cast<Vslots*>(this);
+	}
+	const Vslots& vs() const {
+		return *reinterpret_cast<const Vslots*>(this);
+	}
+	short* offsets() {
+		return reinterpret_cast<short*>(buf);
+	}
+	const uint8_t* prefix() const {
+		return buf + BUFSIZE - plen;
+	}
+	bool add(int i, const uint8_t* enc, int n);
+	void reprefix();
+
+	short magic; // overlaps the first offset of Vslots, which is >= 0
+	short sz;
+	short prev; // points to start of heap (grows downward)
+	short plen; // the prefix is at the end of buf
+	uint8_t buf[BUFSIZE];
+};
+static_assert(sizeof(Pslots) == sizeof(Vslots)); // so old nodes can be read
+
 // array of variable length key and int adr
 class VFslot {
 public:
@@ -16,6 +16,7 @@
 
 void SuClass::put(Value m, Value x) {
 	data[m] = x;
+	cache_epoch = -1;
 }
 
 Value SuClass::get(Value m) const { // no inheritance
@@ -155,7 +156,22 @@ Value SuClass::get2(Value self, Value member) { // handles binding and getters
 	return Value();
 }
 
-Value SuClass::get3(Value member) { // handles inheritance
+// caches lookups (including failures) to avoid repeatedly searching
+// the inheritance chain, which is the usual path for method calls
+Value SuClass::get3(Value member) {
+	if (cache_epoch != globals.epoch) {
+		cache.clear();
+		cache_epoch = globals.epoch;
+	}
+	if (Value* pv = cache.find(member))
+		return *pv;
+	Value x = search(member);
+	if (cache_epoch == globals.epoch) // in case search loaded a base class
+		cache.put(member, x);
+	return x;
+}
+
+Value SuClass::search(Value member) { // handles inheritance
 	SuClass* c = this;
 	for (int i = 0; i < 100; ++i) {
 		if (Value x = c->get(member))
@@ -175,6 +191,18 @@ Value SuClass::parent() {
 
 #include "testing.h"
 
+TEST(suclass_cache) {
+	globals.put("Test_Base", run("class { F() { 1 } }"));
+	globals.put("Test_Derived", run("Test_Base { G() { 2 } }"));
+	assert_eq(Value(1), run("Test_Derived().F()"));
+	assert_eq(Value(2), run("Test_Derived().G()"));
+	globals.put("Test_Base", run("class { F() { 3 } G() { 4 } }"));
+	assert_eq(Value(3), run("Test_Derived().F()"));
+	assert_eq(Value(2), run("Test_Derived().G()"));
+	globals.put("Test_Derived", Value());
+	globals.put("Test_Base", Value());
+}
+
 TEST(suclass_construct) {
 	val_cast<SuClass*>(run("class { }"));
 	val_cast<SuInstance*>(run("c = class { }; new c"));
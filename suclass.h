@@ -6,6 +6,7 @@
 
 class SuObject;
 class Ostream;
+class Shape;
 
 // user defined classes
 class SuClass : public MemBase {
@@ -31,6 +32,7 @@ private:
 	void put(Value m, Value x); // used by compile
 	Value get2(Value self, Value member);
 	Value get3(Value member);
+	Value search(Value member);
 	Value mbclass() override {
 		return this;
 	}
@@ -41,7 +43,15 @@ private:
 
 	const short base;
 	bool has_getter = true;
+	// results of get3, valid as long as globals.epoch is unchanged
+	Hmap<Value, Value> cache;
+	int cache_epoch = -1;
+	// the initial (empty) member layout of instances, see SuInstance
+	Shape* shape = nullptr;
 
 	friend class SuInstance;
 	friend struct ClassContainer;
+	friend class CodeWriter;
+	friend class CodeReader;
+	friend void test_libcache_packcode();
 };
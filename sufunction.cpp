@@ -128,12 +128,25 @@ int SuFunction::disasm1(Ostream& out, int ci) {
 	} else if (op == I_PUSH_INT) {
 		out << TARGET(ci);
 		ci += 2;
+	} else if (op == I_INC_AUTO || op == I_DEC_AUTO)
+		out << symstr(locals[code[ci++]]);
+	else if (op == I_JUMP_AUTO_INT || op == I_JUMP_AUTO_AUTO) {
+		int target = ci + 2 + TARGET(ci);
+		ci += 2;
+		int cmp = code[ci++];
+		out << symstr(locals[code[ci++]]) << " " << opcodes[cmp] << " ";
+		if (op == I_JUMP_AUTO_INT) {
+			out << TARGET(ci);
+			ci += 2;
+		} else
+			out << symstr(locals[code[ci++]]);
+		out << " " << target;
 	} else if (op < 16 || op == I_BOOL || op == I_BLOCK_THROW)
 		;
 	else if (op < I_PUSH) {
 		switch (op & 0xf0) {
 		case I_PUSH_LITERAL:
-			out << literals[op & 15];
+			out << literals[op & 7];
 			break;
 		case I_PUSH_AUTO:
 			out << symstr(locals[op & 15]);
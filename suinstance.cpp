@@ -8,18 +8,154 @@
 #include "builtinargs.h"
 #include "sublock.h"
 #include "eqnest.h"
+#include "symbols.h"
+#include <algorithm>
+
+// Shape ============================================================
+
+// the members of an instance, in the order they were added
+// instances start with their class's empty shape
+// adding a member moves to the shape with that member added,
+// which is created the first time, so instances that add the same members
+// in the same order (normally in New) share their shapes
+class Shape {
+public:
+	Shape() = default;
+	int size() const {
+		return n;
+	}
+	Value member(int i) const {
+		return members[i];
+	}
+	// returns the slot for a member, or -1 if it's not in this shape
+	int find(Value m) const {
+		for (int i = 0; i < n; ++i)
+			if (members[i].same(m))
+				return i;
+		if (allsyms && is_symbol(m))
+			return -1;
+		for (int i = 0; i < n; ++i)
+			if (members[i] == m)
+				return i;
+		return -1;
+	}
+	// returns the shape with m added,
+	// or nullptr if that would be too many members or shapes
+	Shape* add(Value m) {
+		for (int i = 0; i < nnext; ++i)
+			if (next[i]->members[n] == m)
+				return next[i];
+		if (n >= MAXMEMBERS || nnext >= MAXNEXT)
+			return nullptr;
+		return next[nnext++] = new Shape(this, m);
+	}
+
+private:
+	enum { MAXMEMBERS = 64, MAXNEXT = 8 };
+	Shape(const Shape* prev, Value m)
+		: members(new Value[prev->n + 1]), n(prev->n + 1),
+		  allsyms(prev->allsyms && is_symbol(m)) {
+		std::copy(prev->members, prev->members + prev->n, members);
+		members[prev->n] = m;
+	}
+
+	Value* members = nullptr;
+	int n = 0;
+	bool allsyms = true; // so find can skip comparing symbols by value
+	int nnext = 0;
+	Shape* next[MAXNEXT] = {};
+};
+
+Shape* SuInstance::rootshape(Value c) {
+	SuClass* cls = val_cast<SuClass*>(c);
+	if (!cls)
+		return new Shape;
+	if (!cls->shape)
+		cls->shape = new Shape;
+	return cls->shape;
+}
+
+// SuInstance =======================================================
+
+SuInstance::SuInstance(Value c) : myclass(c), shape(rootshape(c)) {
+}
+
+SuInstance::SuInstance(const SuInstance& x)
+	: MemBase(x), myclass(x.myclass), shape(x.shape) {
+	data = x.data.copy();
+	if (shape && shape->size()) {
+		nslots = x.nslots;
+		slots = new Value[nslots];
+		std::copy(x.slots, x.slots + shape->size(), slots);
+	}
+}
+
+template <class F>
+void SuInstance::foreach(F f) const {
+	if (shape)
+		for (int i = 0; i < shape->size(); ++i)
+			f(shape->member(i), slots[i]);
+	else
+		for (auto [key, val] : data)
+			f(key, val);
+}
 
 Value SuInstance::getdata(Value m) {
-	if (Value* pv = data.find(m))
+	if (Value* pv = SuInstance::memfind(m))
 		return *pv;
 	else
 		return val_cast<SuClass*>(myclass)->get2(this, m);
 }
 
 void SuInstance::putdata(Value m, Value v) {
+	if (shape) {
+		int i = shape->find(m);
+		if (i >= 0) {
+			slots[i] = v;
+			return;
+		}
+		if (Shape* next = shape->add(m)) {
+			i = shape->size();
+			if (i >= nslots) {
+				nslots = std::max(2 * nslots, 4);
+				Value* s = new Value[nslots];
+				std::copy(slots, slots + i, s);
+				slots = s;
+			}
+			slots[i] = v;
+			shape = next;
+			return;
+		}
+		todata();
+	}
 	data[m] = v;
 }
 
+Value* SuInstance::memfind(Value m) const {
+	if (!shape)
+		return data.find(m);
+	int i = shape->find(m);
+	return i < 0 ? nullptr : &slots[i];
+}
+
+int SuInstance::memsize() const {
+	return shape ? shape->size() : data.size();
+}
+
+void SuInstance::addMembersTo(SuObject* ob) {
+	foreach([ob](Value m, Value) { ob->add(m); });
+}
+
+// switch from the shape and slots to the hash table
+void SuInstance::todata() {
+	if (!shape)
+		return;
+	foreach([this](Value m, Value v) { data[m] = v; });
+	shape = nullptr;
+	slots = nullptr;
+	nslots = 0;
+}
+
 Value SuInstance::call(Value self, Value member, short nargs, short nargnames,
 	short* argnames, int each) {
 	static Value COPY("Copy");
@@ -53,21 +189,40 @@ bool SuInstance::eq(const SuValue& x) const {
 		if (EqNest::has(this, &x))
 			return true;
 		EqNest eqnest(this, &x);
-		return data == that->data;
+		if (!shape && !that->shape)
+			return data == that->data;
+		if (shape && shape == that->shape) {
+			for (int i = 0; i < shape->size(); ++i)
+				if (!(slots[i] == that->slots[i]))
+					return false;
+			return true;
+		}
+		if (memsize() != that->memsize())
+			return false;
+		bool result = true;
+		foreach([that, &result](Value m, Value v) {
+			Value* pv = that->memfind(m);
+			if (!pv || !(*pv == v))
+				result = false;
+		});
+		return result;
 	}
 	return false;
 }
 
+// members are combined in any order
+// since equal instances can have different shapes
 size_t SuInstance::hashfn() const {
 	size_t hash = hashcontrib();
-	if (data.size() <= 5)
-		for (auto [key, val] : data)
-			hash = 31 * hash + (key.hashcontrib() ^ val.hashcontrib());
+	if (memsize() <= 5)
+		foreach([&hash](Value m, Value v) {
+			hash += m.hashcontrib() ^ v.hashcontrib();
+		});
 	return hash;
 }
 
 size_t SuInstance::hashcontrib() const {
-	return myclass.hashcontrib() + 31 * data.size();
+	return myclass.hashcontrib() + 31 * memsize();
 }
 
 void SuInstance::out(Ostream& os) const {
@@ -89,9 +244,7 @@ gcstring SuInstance::to_gcstr() const {
 Value SuInstance::Copy(
 	short nargs, short nargnames, short* argnames, int each) {
 	NOARGS("instance.Copy()");
-	SuInstance* cp = new SuInstance(myclass);
-	cp->data = data.copy();
-	return cp;
+	return new SuInstance(*this);
 }
 
 Value SuInstance::Delete(
@@ -101,9 +254,12 @@ Value SuInstance::Delete(
 	args.usage("instance.Delete(member ...) or .Delete(all:)");
 	if (Value all = args.getNamed("all")) {
 		args.end();
-		if (all == SuTrue)
+		if (all == SuTrue) {
 			data.clear();
+			shape = rootshape(myclass);
+		}
 	} else {
+		todata();
 		while (Value m = args.getNextUnnamed())
 			data.erase(m);
 	}
@@ -128,3 +284,26 @@ const char* SuInstance::toString() const {
 Value SuInstance::method_class(Value m) {
 	return force<SuClass*>(myclass)->method_class(m);
 }
+
+#include "testing.h"
+
+TEST(suinstance_shapes) {
+	assert_eq(Value(3), run("c = class { New() { .a = 1; .b = 2 } }; "
+							"x = c(); x.a + x.b"));
+	// same members added in a different order
+	assert_eq(SuTrue, run("c = class { }; x = c(); x.a = 1; x.b = 2; "
+						  "y = c(); y.b = 2; y.a = 1; x is y"));
+	assert_eq(SuFalse, run("c = class { }; x = c(); x.a = 1; "
+						   "y = c(); y.a = 2; x is y"));
+	// string instead of symbol
+	assert_eq(Value(1),
+		run("c = class { }; x = c(); x.abc = 1; x['ab' $ 'c']"));
+	assert_eq(Value(1), run("c = class { }; x = c(); x.a = 1; "
+							"y = x.Copy(); y.a = 2; x.a"));
+	assert_eq(run("#(b)"), run("c = class { }; x = c(); x.a = 1; x.b = 2; "
+							   "x.Delete('a'); x.Members()"));
+	// too many members for a shape
+	assert_eq(Value(99), run("c = class { }; x = c(); "
+							 "for (i = 0; i < 100; ++i) x['m' $ i] = i; "
+							 "x.Size() is 100 ? x.m99 : false"));
+}
@@ -6,11 +6,16 @@
 #include "membase.h"
 
 class SuClass;
+class Shape;
 
+// instances store their members in slots laid out by a Shape
+// shared with other instances of the class with the same members
+// they only switch to the hash table (data) for unusual cases
+// e.g. Delete, or too many members
 class SuInstance : public MemBase {
 public:
-	SuInstance(Value c) : myclass(c) {
-	}
+	SuInstance(Value c);
+	SuInstance(const SuInstance& x);
 
 	Value getdata(Value) override;
 	void putdata(Value, Value) override;
@@ -29,6 +34,13 @@ private:
 	Value Delete(short nargs, short nargnames, short* argnames, int each);
 	const char* toString() const;
 	Value method_class(Value m) override;
+	Value* memfind(Value m) const override;
+	int memsize() const override;
+	void addMembersTo(SuObject* ob) override;
+	void todata();
+	static Shape* rootshape(Value c);
+	template <class F>
+	void foreach(F f) const;
 
 	Value mbclass() override {
 		return myclass;
@@ -43,4 +55,7 @@ private:
 	// instance references its class directly, not by global
 	// partly to allow instances of anonymous classes
 	const Value myclass;
+	Shape* shape; // nullptr once the members are in data
+	Value* slots = nullptr;
+	int nslots = 0; // allocated
 };
@@ -37,7 +37,10 @@ void SuNumber::out(Ostream& os) const {
 	os << dn;
 }
 
+int SuNumber::nalloc = 0;
+
 void* SuNumber::operator new(size_t n) { // NOLINT
+	++nalloc;
 	return ::operator new(n, noptrs);
 }
 
@@ -136,9 +139,9 @@ char* SuNumber::format(char* buf, const char* mask) const {
 }
 
 size_t SuNumber::hashfn() const {
-	// have to ensure that hashfn() == integer() for SHRT_MIN -> SHRT_MAX
+	// have to ensure that hashfn() == integer() for immediate Value ints
 	int n;
-	if (dn.to_int(&n) && SHRT_MIN <= n && n <= SHRT_MAX)
+	if (dn.to_int(&n) && Value::fits(n))
 		return n;
 	return dn.hashfn();
 }
@@ -174,7 +177,7 @@ void SuNumber::pack(char* buf) const {
 Value SuNumber::unpack(const gcstring& buf) {
 	auto dnum = Dnum::unpack(buf);
 	int n;
-	if (dnum.to_int(&n) && SHRT_MIN <= n && n <= SHRT_MAX)
+	if (dnum.to_int(&n) && Value::fits(n))
 		return Value(n);
 	return new SuNumber(dnum);
 }
@@ -330,7 +333,7 @@ TEST(sunum_format) {
 }
 
 TEST(sunum_unpack_int) {
-	int data[] = {0, 1, 123, 1000, 12000, SHRT_MAX};
+	int data[] = {0, 1, 123, 1000, 12000, SHRT_MAX, 100000, 12345678};
 	for (auto i : data)
 		for (int sign = +1; sign >= -1; sign -= 2) {
 			int n = i * sign;
@@ -24,6 +24,7 @@ public:
 
 	void out(Ostream&) const override;
 	void* operator new(size_t n); // NOLINT
+	static int nalloc;            // count of heap allocations, for tests
 	void* operator new(size_t n, void* p) {
 		return p;
 	}
@@ -20,6 +20,7 @@
 #include <cstdlib>
 #include <cctype>
 #include <algorithm>
+#include <vector>
 using std::min;
 using std::max;
 
@@ -348,6 +349,23 @@ Value SuString::FindLast(
 	return i == -1 ? SuFalse : i;
 }
 
+// membership of the chars in a Find1of set
+// a table lookup per char instead of searching the set
+class CharSet {
+public:
+	explicit CharSet(const gcstring& set) {
+		memset(in, 0, sizeof in);
+		for (auto c : set)
+			in[uint8_t(c)] = true;
+	}
+	bool operator[](char c) const {
+		return in[uint8_t(c)];
+	}
+
+private:
+	bool in[256];
+};
+
 Value SuString::Find1of(
 	short nargs, short nargnames, short* argnames, int each) {
 	BuiltinArgs args(nargs, nargnames, argnames, each);
@@ -356,12 +374,16 @@ Value SuString::Find1of(
 	int pos = args.getint("pos", 0);
 	args.end();
 
+	if (set.size() == 1) {
+		int i = s.find(set[0], pos);
+		return i == -1 ? size() : i;
+	}
+	CharSet cs(set);
 	auto buf = s.ptr();
 	int nbuf = size();
 	for (int i = max(pos, 0); i < nbuf; ++i)
-		for (auto c : set)
-			if (buf[i] == c)
-				return i;
+		if (cs[buf[i]])
+			return i;
 	return size();
 }
 
@@ -373,11 +395,11 @@ Value SuString::FindLast1of(
 	int pos = args.getint("pos", size() - 1);
 	args.end();
 
+	CharSet cs(set);
 	auto buf = s.ptr();
 	for (int i = min(pos, size() - 1); i >= 0; --i)
-		for (auto c : set)
-			if (buf[i] == c)
-				return i;
+		if (cs[buf[i]])
+			return i;
 	return SuFalse;
 }
 
@@ -389,16 +411,12 @@ Value SuString::Findnot1of(
 	int pos = args.getint("pos", 0);
 	args.end();
 
+	CharSet cs(set);
 	auto buf = s.ptr();
 	int nbuf = size();
-	auto setbuf = set.ptr();
-	auto setlim = setbuf + set.size();
 	for (int i = max(pos, 0); i < nbuf; ++i)
-		for (auto t = setbuf;; ++t)
-			if (t >= setlim)
-				return i;
-			else if (buf[i] == *t)
-				break;
+		if (!cs[buf[i]])
+			return i;
 	return size();
 }
 
@@ -410,15 +428,11 @@ Value SuString::FindLastnot1of(
 	int pos = args.getint("pos", size() - 1);
 	args.end();
 
+	CharSet cs(set);
 	auto buf = s.ptr();
-	auto setbuf = set.ptr();
-	auto setlim = setbuf + set.size();
 	for (int i = min(pos, size() - 1); i >= 0; --i)
-		for (auto t = setbuf;; ++t)
-			if (t >= setlim)
-				return i;
-			else if (buf[i] == *t)
-				break;
+		if (!cs[buf[i]])
+			return i;
 	return SuFalse;
 }
 
@@ -480,16 +494,39 @@ Value SuString::Replace(
 	return replace(ARG(0).gcstr(), reparg, count);
 }
 
+// returns the string a pattern matches if it has no special characters
+// or "" if it must be handled as a regular expression
+static gcstring rx_literal(const gcstring& pat) {
+	if (pat.has_prefix("(?q)") && pat.find("(?-q)") == -1)
+		return pat.substr(4);
+	for (auto c : pat)
+		if (strchr("^$.\\[]()|?*+", c)) // includes nul
+			return "";
+	return pat;
+}
+
+// returns false if the replacement has & or \ substitutions
+static bool rep_literal(gcstring& rep) {
+	if (rep.has_prefix("\\=")) {
+		rep = rep.substr(2);
+		return true;
+	}
+	return rep.find('&') == -1 && rep.find('\\') == -1;
+}
+
 Value SuString::replace(const gcstring& patarg, Value reparg, int count) const {
 	if (count <= 0)
 		return this;
-	const char* pat = rx_compile(patarg);
 	gcstring rep;
 	if (val_cast<SuString*>(reparg) || val_cast<SuBoolean*>(reparg) ||
 		reparg.is_int() || val_cast<SuNumber*>(reparg)) {
 		rep = reparg.gcstr();
 		reparg = Value();
+		gcstring lit = rx_literal(patarg);
+		if (lit.size() > 0 && rep_literal(rep))
+			return replace_literal(lit, rep, count);
 	}
+	const char* pat = rx_compile(patarg);
 	int oldsize = size();
 	Buffer* result = nullptr; // construct only if needed
 	auto old = ptr();
@@ -528,6 +565,32 @@ Value SuString::replace(const gcstring& patarg, Value reparg, int count) const {
 	return new SuString(result->gcstr());
 }
 
+// a single scan for the matches, then one exact size copy
+Value SuString::replace_literal(
+	const gcstring& pat, const gcstring& rep, int count) const {
+	std::vector<int> found;
+	for (int i = 0; int(found.size()) < count && -1 != (i = s.find(pat, i));
+		 i += pat.size())
+		found.push_back(i);
+	if (found.empty())
+		return this;
+	int n = size() + int(found.size()) * (int(rep.size()) - int(pat.size()));
+	char* buf = salloc(n);
+	char* dst = buf;
+	auto src = ptr();
+	int from = 0;
+	for (int i : found) {
+		memcpy(dst, src + from, i - from);
+		dst += i - from;
+		memcpy(dst, rep.ptr(), rep.size());
+		dst += rep.size();
+		from = i + pat.size();
+	}
+	memcpy(dst, src + from, size() - from);
+	buf[n] = 0;
+	return new SuString(gcstring::noalloc(buf, n));
+}
+
 Value SuString::MapN(short nargs, short nargnames, short* argnames, int each) {
 	if (nargs != 2)
 		except("usage: string.MapN(n, block)");
@@ -895,6 +958,25 @@ TEST(sustring_replace) {
 		"<h><e><l><l><o> world");
 	assert_eq(SuString("world").replace("^", "hello "), "hello world");
 	assert_eq(SuString("hello").replace("$", " world"), "hello world");
+
+	// literal
+	assert_eq(SuString("a.b.c").replace("(?q).", "-"), "a-b-c");
+	assert_eq(SuString("a.b.c").replace("(?q).", "-", 1), "a-b.c");
+	assert_eq(SuString("aaaa").replace("aa", "b"), "bb");
+	assert_eq(SuString("hello world").replace("o", "\\=&"), "hell& w&rld");
+	assert_eq(SuString("hello world").replace("world", ""), "hello ");
+	assert_eq(SuString("hello").replace("l", "[&]"), "he[l][l]o");
+}
+
+TEST(sustring_find1of) {
+	verify(SuTrue == run("'hello world'.Find1of('wo') is 4"));
+	verify(SuTrue == run("'hello world'.Find1of('o', 5) is 7"));
+	verify(SuTrue == run("'hello world'.Find1of('xyz') is 11"));
+	verify(SuTrue == run("'hello world'.FindLast1of('lo') is 9"));
+	verify(SuTrue == run("'hello world'.FindLast1of('xyz') is false"));
+	verify(SuTrue == run("'hello world'.Findnot1of('hel') is 4"));
+	verify(SuTrue == run("'hello world'.FindLastnot1of('dlr') is 7"));
+	verify(SuTrue == run("'\\xff'.Find1of('\\xff') is 0"));
 }
 
 TEST(sustring_match) {
@@ -933,3 +1015,53 @@ TEST(sustring_isGlobal) {
 	verify(!isGlobal("Foo?bar"));
 	verify(!isGlobal("Foo.bar"));
 }
+
+//-------------------------------------------------------------------
+
+// lines of typical report text up to roughly n bytes
+static gcstring bench_text(int n) {
+	const char* line =
+		"Invoice 1234\tCustomer: Acme Widgets Ltd.\t$1,234.56\r\n";
+	gcstring s;
+	while (int(s.size()) < n)
+		s += line;
+	return s;
+}
+
+// calls fn with a string of n bytes, so the times include the call
+static void string_bench(const char* fn, int n, int64_t nreps) {
+	Value f = compile(fn);
+	Value s = new SuString(bench_text(n));
+	while (nreps-- > 0) {
+		KEEPSP
+		PUSH(s);
+		docall(f, CALL, 1);
+	}
+}
+
+BENCHMARK(sustring_find_64k) {
+	string_bench(
+		"function (s) { s.Find('Customer: Zeta') }", 64 * 1024, nreps);
+}
+
+BENCHMARK(sustring_find1of_64k) {
+	string_bench("function (s) { s.Find1of('#@~') }", 64 * 1024, nreps);
+}
+
+BENCHMARK(sustring_replace_64k) {
+	string_bench(
+		"function (s) { s.Replace('Customer', 'Client') }", 64 * 1024, nreps);
+}
+
+BENCHMARK(sustring_replace_regex_64k) {
+	string_bench(
+		"function (s) { s.Replace('[0-9]+', '#') }", 64 * 1024, nreps);
+}
+
+BENCHMARK(sustring_split_64k) {
+	string_bench("function (s) { s.Split('\\r\\n') }", 64 * 1024, nreps);
+}
+
+BENCHMARK(sustring_tr_64k) {
+	string_bench("function (s) { s.Tr('a-z', 'A-Z') }", 64 * 1024, nreps);
+}
@@ -124,6 +124,8 @@ private:
 	Value Repeat(short nargs, short nargnames, short* argnames, int each);
 	Value Replace(short nargs, short nargnames, short* argnames, int each);
 	Value replace(const gcstring& pat, Value rep, int count = INT_MAX) const;
+	Value replace_literal(
+		const gcstring& pat, const gcstring& rep, int count) const;
 	Value Reverse(short nargs, short nargnames, short* argnames, int each);
 	Value ServerEval(short nargs, short nargnames, short* argnames, int each);
 	Value Size(short nargs, short nargnames, short* argnames, int each);
@@ -100,6 +100,10 @@ Value symbol(int i) {
 	return x;
 }
 
+bool is_symbol(Value x) {
+	return symbols.contains(x.ptr());
+}
+
 const char* symstr(int i) {
 	return i & 0x8000 ? symbol(i).str() : itostr(i, salloc(8), 10);
 }
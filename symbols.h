@@ -22,3 +22,7 @@ Value symbol(int i);
 
 // return the char* string for a symbol index
 const char* symstr(int i);
+
+// whether x is an SuSymbol, since symbols are unique
+// a symbol is only equal to a different value if that is not a symbol
+bool is_symbol(Value x);
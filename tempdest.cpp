@@ -12,13 +12,16 @@ TempDest::TempDest() : inuse(0) {
 }
 
 void TempDest::addref(void* p) {
-	if (gc_inheap(p))
+	if (gc_inheap(p)) {
 		refs.push_back(p);
+		nbytes += GC_size(p);
+	}
 }
 
 void* TempDest::allocadr(int n) {
 	++tempdest_inuse;
 	++inuse;
+	nbytes += n;
 	return static_cast<TempNode*>(heap.alloc(n));
 }
 
@@ -26,6 +29,7 @@ void TempDest::free() {
 	heap.destroy();
 	tempdest_inuse -= inuse;
 	inuse = 0;
+	nbytes = 0;
 	std::fill(refs.begin(), refs.end(), (void*) 0); // to help gc
 	refs.clear();
 }
@@ -24,10 +24,15 @@ public:
 		return reinterpret_cast<Mmoffset>(adr);
 	}
 	void addref(void* p);
+	// approximate memory used, for TempIndex spilling
+	size_t size() const {
+		return nbytes;
+	}
 	~TempDest();
 
 private:
 	Heap heap;
 	std::deque<void*> refs;
 	int inuse;
+	size_t nbytes = 0;
 };
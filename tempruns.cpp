@@ -0,0 +1,343 @@
+// Copyright (c) 2000 Suneido Software Corp. All rights reserved
+// Licensed under GPLv2
+
+#include "tempruns.h"
+#include "database.h"
+#include "thedb.h"
+#include "except.h"
+#include "gc.h"
+#include <cstring>
+#include <algorithm>
+using std::max;
+using std::min;
+
+#ifdef _MSC_VER
+#define FSEEK64 _fseeki64
+#else
+#define FSEEK64 fseeko64
+#endif
+
+int tempindex_memory = 32 * 1024 * 1024;
+
+// entry layout: len, key size, key, number of records, records, len
+// the length at each end allows reading backwards
+// records in the database are written as their offset ('D')
+// other records are written in full ('M')
+
+const int BUFSIZE = 64 * 1024;
+const int SPARSE = 32; // every SPARSE'th entry offset is kept for seek
+
+class TempRuns::Cursor {
+public:
+	Cursor(FILE* f_, int64_t s) : f(f_), start(s), end(s) {
+	}
+	void added(int64_t off, int64_t e) {
+		if (n++ % SPARSE == 0)
+			sparse.push_back(off);
+		end = e;
+	}
+	void seek(Record k) {
+		// binary search the sparse offsets
+		int lo = 0;
+		int hi = sparse.size();
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			load(sparse[mid], true);
+			if (key < k)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		// then scan forward
+		load(lo == 0 ? start : sparse[lo - 1], true);
+		while (!eof && key < k)
+			next();
+	}
+	void last() {
+		if (end == start) {
+			eof = true;
+			return;
+		}
+		int len = getint(at(end - 4, 4, false));
+		load(end - len - 8, false);
+	}
+	void next() {
+		int len = getint(at(pos, 4, true));
+		int64_t off = pos + len + 8;
+		if (off >= end)
+			eof = true;
+		else
+			load(off, true);
+	}
+	void prev() {
+		if (pos <= start) {
+			eof = true;
+			return;
+		}
+		int len = getint(at(pos - 4, 4, false));
+		load(pos - len - 8, false);
+	}
+	Records data() {
+		int len = getint(at(pos, 4, true));
+		const char* p = at(pos, len + 8, true) + 4;
+		p += 4 + getint(p); // skip key
+		int nrecs = getint(p);
+		p += 4;
+		Records rs;
+		for (int i = 0; i < nrecs; ++i)
+			if (*p++ == 'D') {
+				Mmoffset off;
+				memcpy(&off, p, sizeof off);
+				p += sizeof off;
+				rs.push(Record(theDB()->mmf, off));
+			} else {
+				int n = getint(p);
+				p += 4;
+				rs.push(Record(memcpy(new (noptrs) char[n], p, n)));
+				p += n;
+			}
+		return rs.reverse();
+	}
+
+	bool eof = true;
+	Record key;
+
+private:
+	static int getint(const char* p) {
+		int n;
+		memcpy(&n, p, sizeof n);
+		return n;
+	}
+	void load(int64_t off, bool forward) {
+		pos = off;
+		int len = getint(at(pos, 4, forward));
+		const char* p = at(pos, len + 8, forward) + 4;
+		int n = getint(p);
+		key = Record(memcpy(new (noptrs) char[n], p + 4, n));
+		eof = false;
+	}
+	// returns a pointer to n bytes starting at file offset off
+	// reads a block into buf if necessary, positioned for the direction
+	const char* at(int64_t off, int len, bool forward) {
+		if (bufoff <= off && off + len <= bufoff + buflen)
+			return buf + (off - bufoff);
+		if (len > BUFSIZE) {
+			char* big = new (noptrs) char[len];
+			read(off, big, len);
+			return big;
+		}
+		if (!buf)
+			buf = new (noptrs) char[BUFSIZE];
+		bufoff = forward ? off : max(start, off + len - BUFSIZE);
+		buflen = min(int64_t(BUFSIZE), end - bufoff);
+		read(bufoff, buf, buflen);
+		return buf + (off - bufoff);
+	}
+	void read(int64_t off, char* dst, int len) {
+		if (FSEEK64(f, off, SEEK_SET) != 0 ||
+			fread(dst, 1, len, f) != size_t(len))
+			except("TempIndex: error reading temporary file");
+	}
+
+	FILE* f;
+	int64_t start;
+	int64_t end;
+	int n = 0;
+	std::vector<int64_t> sparse;
+	int64_t pos = 0;
+	char* buf = nullptr;
+	int64_t bufoff = -1;
+	int buflen = 0;
+};
+
+TempRuns::TempRuns() {
+	extern char* tmpfilename();
+	filename = tmpfilename();
+	f = fopen(filename, "w+b");
+	if (!f)
+		except("TempIndex: can't create temporary file");
+}
+
+void TempRuns::write(const void* buf, int n) {
+	if (fwrite(buf, 1, n, f) != size_t(n))
+		except("TempIndex: error writing temporary file");
+	fileend += n;
+}
+
+// records are compacted by copyto
+void TempRuns::writerec(Record r) {
+	tmp.resize(r.cursize());
+	r.copyto(tmp.data());
+	write(tmp.data(), tmp.size());
+}
+
+void TempRuns::add(Record key, const Records& data) {
+	if (reading) { // runs can be added after seeking e.g. by load
+		if (FSEEK64(f, fileend, SEEK_SET) != 0)
+			except("TempIndex: error seeking temporary file");
+		reading = false;
+	}
+	if (nadded++ == 0)
+		cursors.push_back(new Cursor(f, fileend));
+	int64_t off = fileend;
+	int keysize = key.cursize();
+	int nrecs = size(data);
+	int len = 4 + keysize + 4;
+	for (Records rs = data; !nil(rs); ++rs)
+		len += 1 + (rs->isdb() ? sizeof(Mmoffset) : 4 + rs->cursize());
+	write(&len, 4);
+	write(&keysize, 4);
+	writerec(key);
+	write(&nrecs, 4);
+	for (Records rs = data; !nil(rs); ++rs)
+		if (rs->isdb()) {
+			Mmoffset x = rs->off();
+			write("D", 1);
+			write(&x, sizeof x);
+		} else {
+			int n = rs->cursize();
+			write("M", 1);
+			write(&n, 4);
+			writerec(*rs);
+		}
+	write(&len, 4);
+	cursors.back()->added(off, fileend);
+}
+
+void TempRuns::end_run() {
+	nadded = 0;
+}
+
+void TempRuns::close() {
+	if (!f)
+		return;
+	fclose(f);
+	f = nullptr;
+	remove(filename);
+	cursors.clear();
+	cur = -1;
+}
+
+// merged iteration -------------------------------------------------
+
+void TempRuns::seek(Record key) {
+	for (auto c : cursors)
+		c->seek(key);
+	reading = true;
+	fwd = true;
+	choose();
+}
+
+void TempRuns::last() {
+	for (auto c : cursors)
+		c->last();
+	reading = true;
+	fwd = false;
+	choose();
+}
+
+// since keys are unique, a change of direction can reposition
+// every run relative to the current key
+void TempRuns::next() {
+	if (fwd) {
+		cursors[cur]->next();
+	} else {
+		Record k = key();
+		for (auto c : cursors) {
+			c->seek(k);
+			if (!c->eof && c->key == k)
+				c->next();
+		}
+		fwd = true;
+	}
+	choose();
+}
+
+void TempRuns::prev() {
+	if (!fwd) {
+		cursors[cur]->prev();
+	} else {
+		Record k = key();
+		for (auto c : cursors) {
+			c->seek(k);
+			if (c->eof)
+				c->last();
+			else
+				c->prev();
+		}
+		fwd = false;
+	}
+	choose();
+}
+
+// set cur to the run with the smallest key (forward)
+// or the largest key (backward)
+void TempRuns::choose() {
+	cur = -1;
+	for (int i = 0; i < int(cursors.size()); ++i) {
+		Cursor* c = cursors[i];
+		if (c->eof)
+			continue;
+		if (cur < 0 ||
+			(fwd ? c->key < cursors[cur]->key : cursors[cur]->key < c->key))
+			cur = i;
+	}
+}
+
+Record TempRuns::key() const {
+	verify(cur >= 0);
+	return cursors[cur]->key;
+}
+
+Records TempRuns::data() {
+	verify(cur >= 0);
+	return cursors[cur]->data();
+}
+
+// tests ------------------------------------------------------------
+
+#include "testing.h"
+
+static Record testkey(int i) {
+	Record r;
+	r.addval(i);
+	return r;
+}
+
+TEST(tempruns) {
+	TempRuns runs;
+	// three interleaved runs, 0..299
+	for (int r = 0; r < 3; ++r) {
+		for (int i = r; i < 300; i += 3) {
+			Record data;
+			data.addval(i * 10);
+			runs.add(testkey(i), lisp(data));
+		}
+		runs.end_run();
+	}
+	int i = 0;
+	for (runs.seek(Record()); !runs.eof(); runs.next(), ++i) {
+		assert_eq(runs.key(), testkey(i));
+		assert_eq(runs.data()[0].getint(0), i * 10);
+	}
+	assert_eq(i, 300);
+	i = 299;
+	for (runs.last(); !runs.eof(); runs.prev(), --i)
+		assert_eq(runs.key(), testkey(i));
+	assert_eq(i, -1);
+
+	// change direction
+	runs.seek(testkey(100));
+	assert_eq(runs.key(), testkey(100));
+	runs.next();
+	runs.next();
+	assert_eq(runs.key(), testkey(102));
+	runs.prev();
+	assert_eq(runs.key(), testkey(101));
+	runs.prev();
+	runs.prev();
+	assert_eq(runs.key(), testkey(99));
+	runs.next();
+	assert_eq(runs.key(), testkey(100));
+	runs.close();
+}
@@ -0,0 +1,51 @@
+#pragma once
+// Copyright (c) 2000 Suneido Software Corp. All rights reserved
+// Licensed under GPLv2
+
+#include "row.h"
+#include <cstdio>
+#include <vector>
+
+// maximum memory used by a TempIndex1 or TempIndexN before spilling to disk
+extern int tempindex_memory;
+
+// sorted runs of (key, records) entries in a temporary file
+// used by TempIndex1 and TempIndexN for sorts that don't fit in memory
+// the runs are merged as they are read, forward or backward
+// keys must be unique (TempIndex adds a sequence number if necessary)
+class TempRuns {
+public:
+	TempRuns();
+	// entries must be added in order within each run
+	void add(Record key, const Records& data);
+	void end_run();
+	void close(); // removes the file
+
+	// iteration
+	void seek(Record key); // to the first entry >= key
+	void last();
+	void next();
+	void prev();
+	bool eof() const {
+		return cur < 0;
+	}
+	Record key() const;
+	Records data();
+
+	class Cursor;
+
+private:
+	void write(const void* buf, int n);
+	void writerec(Record r);
+	void choose();
+
+	FILE* f = nullptr;
+	char* filename = nullptr;
+	int64_t fileend = 0;
+	int nadded = 0; // in the current run
+	std::vector<char> tmp;
+	std::vector<Cursor*> cursors; // one per run
+	int cur = -1;                 // the current cursor, -1 for eof
+	bool fwd = true;              // direction of the last move
+	bool reading = false;         // the file position isn't at the end
+};
@@ -4,6 +4,7 @@
 #include "thedb.h"
 #include "database.h"
 #include "port.h"
+#include "cmdlineoptions.h"
 
 bool thedb_create = false;
 Database* thedb = 0;
@@ -24,6 +25,7 @@ Database* theDB() {
 
 	if (!thedb) {
 		thedb = new Database("suneido.db", thedb_create);
+		thedb->sync_commit = cmdlineoptions.sync_commit;
 		sync_timer(thedb->mmf);
 	}
 	return thedb;
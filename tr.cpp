@@ -10,7 +10,25 @@ using namespace std;
 
 static gcstring makset(const gcstring&);
 static gcstring expandRanges(const gcstring&);
-static int xindex(const gcstring&, char, bool, int);
+
+// maps each char to its first index in the from set, or -1
+// a table lookup per char instead of searching the set
+class TrMap {
+public:
+	explicit TrMap(const gcstring& set) {
+		memset(map, 0xff, sizeof map);
+		for (int i = set.size() - 1; i >= 0; --i)
+			map[uint8_t(set[i])] = i;
+	}
+	int operator[](char c) const {
+		return map[uint8_t(c)];
+	}
+
+private:
+	int map[256];
+};
+
+static int xindex(const TrMap&, char, bool, int);
 
 gcstring tr(const gcstring& srcstr, const gcstring& from, const gcstring& to) {
 	const int srclen = srcstr.size();
@@ -19,14 +37,13 @@ gcstring tr(const gcstring& srcstr, const gcstring& from, const gcstring& to) {
 
 	bool allbut = (from[0] == '^');
 	gcstring fromset = makset(allbut ? from.substr(1) : from);
+	TrMap frommap(fromset);
 
 	auto src = srcstr.ptr();
 	int si = 0;
-	for (; si < srclen; ++si) {
-		int p = fromset.find(src[si]);
-		if (allbut == (p == -1))
+	for (; si < srclen; ++si)
+		if (allbut == (frommap[src[si]] == -1))
 			break;
-	}
 	if (si == srclen)
 		return srcstr; // no changes
 
@@ -40,13 +57,13 @@ gcstring tr(const gcstring& srcstr, const gcstring& from, const gcstring& to) {
 	char* dst = buf + si;
 
 	for (; si < srclen; ++si) {
-		int i = xindex(fromset, src[si], allbut, lastto);
+		int i = xindex(frommap, src[si], allbut, lastto);
 		if (collapse && i >= lastto) {
 			*dst++ = toset[lastto];
 			do {
 				if (++si >= srclen)
 					goto finished;
-				i = xindex(fromset, src[si], allbut, lastto);
+				i = xindex(frommap, src[si], allbut, lastto);
 			} while (i >= lastto);
 		}
 		if (i < 0)
@@ -83,8 +100,8 @@ static gcstring expandRanges(const gcstring& s) {
 	return dst.gcstr();
 }
 
-static int xindex(const gcstring& fromset, char c, bool allbut, int lastto) {
-	int i = fromset.find(c);
+static int xindex(const TrMap& frommap, char c, bool allbut, int lastto) {
+	int i = frommap[c];
 	if (allbut)
 		return (i == -1) ? lastto + 1 : -1;
 	else
@@ -145,3 +162,26 @@ PORTTEST(tr) {
 	auto result = tr(args[0], args[1], args[2]).str();
 	return result == args[3] ? nullptr : OSTR("got: " << result);
 }
+
+//-------------------------------------------------------------------
+
+static gcstring bench_text(int n) {
+	const char* line =
+		"Invoice 1234\tCustomer: Acme Widgets Ltd.\t$1,234.56\r\n";
+	gcstring s;
+	while (int(s.size()) < n)
+		s += line;
+	return s;
+}
+
+BENCHMARK(tr_4k) {
+	gcstring s = bench_text(4 * 1024);
+	while (nreps-- > 0)
+		tr(s, "a-z", "A-Z");
+}
+
+BENCHMARK(tr_collapse_64k) {
+	gcstring s = bench_text(64 * 1024);
+	while (nreps-- > 0)
+		tr(s, "^a-zA-Z0-9", " ");
+}
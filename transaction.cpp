@@ -10,6 +10,7 @@
 #include "errlog.h"
 #include "checksum.h"
 #include "ostreamstr.h"
+#include "fibers.h" // for yield for sync_commit
 #include <climits>
 
 // TODO: why is trans a map? wouldn't a HashMap be faster & smaller?
@@ -63,6 +64,7 @@ void Database::create_act(int tran, TblNum tblnum, Mmoffset off) {
 	Transaction* t = ck_get_tran(tran);
 	verify(t->type == READWRITE);
 	created[off] = UNCOMMITTED + tran;
+	versions.add(off);
 	t->acts.push_back(TranAct(CREATE_ACT, tblnum, off, clock));
 }
 
@@ -80,6 +82,7 @@ bool Database::delete_act(int tran, TblNum tblnum, Mmoffset off) {
 		return false;
 	}
 	deleted[off] = TranDelete(tran);
+	versions.add(off);
 	t->acts.push_back(TranAct(DELETE_ACT, tblnum, off, clock));
 	return true;
 }
@@ -129,6 +132,7 @@ void Database::undo_delete_act(int tran, TblNum tblnum, Mmoffset off) {
 	TranAct& ta = t->acts.back();
 	verify(ta.type == DELETE_ACT && ta.tblnum == tblnum && ta.off == off);
 	deleted.erase(off);
+	versions.remove(off);
 	t->acts.pop_back();
 }
 
@@ -160,7 +164,8 @@ bool Database::commit(int tran, const char** conflict) {
 			*conflict = t->conflict;
 		return false;
 	}
-	if (t->type == READWRITE && !t->acts.empty()) {
+	bool update = t->type == READWRITE && !t->acts.empty();
+	if (update) {
 		if (!validate_reads(t)) {
 			abort(tran);
 			if (conflict)
@@ -171,9 +176,21 @@ bool Database::commit(int tran, const char** conflict) {
 	}
 	verify(trans.erase(tran));
 	verify(finalize());
+	if (update && sync_commit)
+		wait_flushed();
 	return true;
 }
 
+// group commit - other fibers can commit while this waits
+// so their data is flushed together
+void Database::wait_flushed() {
+	Mmoffset off = mmf->size();
+	mmf->flush();
+	while (!mmf->flushed(off) && Fibers::yield())
+		;
+	mmf->wait_flushed(off);
+}
+
 void Database::commit_update_tran(int tran) {
 	Transaction* t = ck_get_tran(tran);
 	int ncreates = 0;
@@ -201,7 +218,7 @@ void Database::commit_update_tran(int tran) {
 	}
 	t->asof = commit_time;
 	t->reads.clear(); // no longer needed
-	final.insert(*t);
+	add_final_keys(&*final.insert(*t).first);
 
 	write_commit_record(tran, t->acts, ncreates, ndeletes);
 }
@@ -255,11 +272,12 @@ bool Database::refresh(int tran) {
 bool Database::validate_reads(Transaction* t) {
 	// look at final transactions after asof
 	// TODO: maybe track & use read start time instead of transaction
-	auto begin = lower_bound(final.begin(), final.end(), t->asof);
+	if (lower_bound(final.begin(), final.end(), t->asof) == final.end())
+		return true; // nothing committed since asof
 	sort(t->reads.begin(), t->reads.end());
 	TblNum cur_tblnum = -1;
 	const char* cur_index = 0;
-	short* colnums = 0;
+	FinalIdx* fi = 0;
 	int nidxcols = 0;
 	for (auto tr = t->reads.begin(); tr != t->reads.end(); ++tr) {
 		if (tr->tblnum != cur_tblnum || tr->index != cur_index) {
@@ -267,15 +285,14 @@ bool Database::validate_reads(Transaction* t) {
 			cur_index = tr->index;
 
 			Tbl* tbl = get_table(tr->tblnum);
-			if (!tbl)
-				continue;
-			colnums = comma_to_nums(tbl->cols, tr->index);
-			verify(colnums);
+			fi = tbl ? final_index(tbl, tr->index) : 0;
 
 			nidxcols = 1 +
 				count((const char*) tr->index,
 					(const char*) strchr(tr->index, 0), ',');
 		}
+		if (!fi)
+			continue;
 		// crude removal of record address from org & end
 		Record from = tr->org;
 		if (from.size() > nidxcols) {
@@ -288,24 +305,70 @@ bool Database::validate_reads(Transaction* t) {
 			to.truncate(nidxcols);
 		}
 
-		for (auto iter = begin; iter != final.end(); ++iter) {
-			for (auto act = iter->acts.begin(); act != iter->acts.end();
-				 ++act) {
-				if (act->tblnum != tr->tblnum)
-					continue;
-				Record rec(input(act->off));
-				Record key = project(rec, colnums);
-				if (from <= key && key <= to) {
-					t->conflict = read_conflict(&*iter, tr->tblnum, from, to,
-						cur_index, key, act->type);
-					return false;
-				}
+		for (auto fk = fi->keys.lower_bound(from);
+			 fk != fi->keys.end() && fk->first <= to; ++fk) {
+			const Transaction* ft = fk->second.tran;
+			if (ft->asof >= t->asof) {
+				t->conflict = read_conflict(ft, tr->tblnum, from, to,
+					cur_index, fk->first, fk->second.type);
+				return false;
 			}
 		}
 	}
 	return true;
 }
 
+// returns the committed write keys for an index,
+// building them from the final transactions the first time
+FinalIdx* Database::final_index(Tbl* tbl, const char* index) {
+	auto& idxs = final_keys[tbl->num];
+	auto it = idxs.find(index);
+	if (it != idxs.end())
+		return &it->second;
+	FinalIdx& fi = idxs[index];
+	fi.colnums = comma_to_nums(tbl->cols, index);
+	verify(fi.colnums);
+	for (auto iter = final.begin(); iter != final.end(); ++iter)
+		for (auto act = iter->acts.begin(); act != iter->acts.end(); ++act)
+			if (act->tblnum == tbl->num)
+				fi.keys.insert(
+					make_pair(project(input(act->off), fi.colnums),
+						FinalKey{&*iter, act->type}));
+	return &fi;
+}
+
+// called by commit to add the keys of a newly final transaction
+// to the indexes that have already been built
+void Database::add_final_keys(const Transaction* t) {
+	for (auto act = t->acts.begin(); act != t->acts.end(); ++act) {
+		auto fk = final_keys.find(act->tblnum);
+		if (fk == final_keys.end())
+			continue;
+		Record rec(input(act->off));
+		for (auto& [columns, fi] : fk->second)
+			fi.keys.insert(make_pair(
+				project(rec, fi.colnums), FinalKey{t, act->type}));
+	}
+}
+
+// called by finalize before a transaction is removed from final
+void Database::remove_final_keys(const Transaction* t) {
+	for (auto act = t->acts.begin(); act != t->acts.end(); ++act) {
+		auto fk = final_keys.find(act->tblnum);
+		if (fk == final_keys.end())
+			continue;
+		Record rec(input(act->off));
+		for (auto& [columns, fi] : fk->second) {
+			auto range = fi.keys.equal_range(project(rec, fi.colnums));
+			for (auto k = range.first; k != range.second; ++k)
+				if (k->second.tran == t) {
+					fi.keys.erase(k);
+					break;
+				}
+		}
+	}
+}
+
 char* Database::read_conflict(const Transaction* t, int tblnum, Record from,
 	Record to, const char* index, Record key, ActType type) {
 	OstreamStr os;
@@ -338,6 +401,7 @@ void Database::abort(int tran) {
 				TranTime* p = created.find(act->off);
 				verify(p && *p > UNCOMMITTED);
 				created.erase(act->off);
+				versions.remove(act->off);
 				if (act->time > table_create_time(act->tblnum))
 					if (Tbl* tbl = get_table(act->tblnum)) {
 						Record r(input(act->off));
@@ -353,6 +417,7 @@ void Database::abort(int tran) {
 				TranDelete* p = deleted.find(act->off);
 				verify(p && p->time > UNCOMMITTED);
 				deleted.erase(act->off);
+				versions.remove(act->off);
 				if (Tbl* tbl = get_table(act->tblnum)) {
 					// undo tables record update
 					++tbl->nrecords;
@@ -383,10 +448,12 @@ bool Database::finalize() {
 		const Transaction& t = *final.begin();
 		for (auto act = t.acts.begin(); act != t.acts.end(); ++act) {
 			try {
-				if (act->type == CREATE_ACT)
+				if (act->type == CREATE_ACT) {
 					verify(created.erase(act->off));
-				else { // DELETE_ACT
+					versions.remove(act->off);
+				} else { // DELETE_ACT
 					verify(deleted.erase(act->off));
+					versions.remove(act->off);
 					if (act->time > table_create_time(act->tblnum) &&
 						get_table(act->tblnum)) {
 						Record r(input(act->off));
@@ -397,6 +464,7 @@ bool Database::finalize() {
 				ok = false;
 			}
 		}
+		remove_final_keys(&t);
 		final.erase(final.begin());
 	}
 	return ok;
@@ -415,10 +483,18 @@ TranTime Database::delete_time(Mmoffset off) {
 }
 
 bool Database::visible(int tran, Mmoffset address) {
-	if (tran == schema_tran)
-		return true;
+	return visible(tran, tran_asof(tran), address);
+}
 
-	TranTime asof = ck_get_tran(tran)->asof;
+TranTime Database::tran_asof(int tran) {
+	return tran == schema_tran ? FUTURE : ck_get_tran(tran)->asof;
+}
+
+bool Database::visible(int tran, TranTime asof, Mmoffset address) {
+	// most records have no uncommitted or unfinalized versions
+	// so they are visible to every transaction
+	if (tran == schema_tran || !versions.has(address))
+		return true;
 
 	TranTime ct = create_time(address);
 	if (ct > UNCOMMITTED) {
@@ -648,3 +724,70 @@ TEST(transaction_conflicts3) {
 	verify(thedb->commit(t));
 	END
 }
+
+TEST(transaction_conflicts4) {
+	// read validation against final keys built lazily and then incrementally
+	SETUP
+	int t1 = thedb->transaction(READWRITE);
+	Index* idx = thedb->get_index("test", "name");
+	verify(idx->begin(t1, key("m"), key("z")).eof());
+	thedb->add_record(t1, "test", record("ann"));
+	int t2 = thedb->transaction(READWRITE);
+	thedb->add_record(t2, "test", record("bob")); // outside t1's read range
+	verify(thedb->commit(t2));
+	verify(thedb->refresh(t1)); // builds final keys for test^name
+	verify(idx->begin(t1, key("m"), key("z")).eof());
+	int t3 = thedb->transaction(READWRITE);
+	thedb->add_record(t3, "test", record("sue")); // inside t1's read range
+	verify(thedb->commit(t3));
+	verify(!thedb->commit(t1));
+	END
+}
+
+TEST(transaction_sync_commit) {
+	SETUP
+	Mmfile* mmf = thedb->mmf;
+	mmf->flush_behind(1 << 30); // so only commits queue flushes
+
+	int t = thedb->transaction(READWRITE);
+	thedb->add_record(t, "test", record("ann"));
+	verify(thedb->commit(t));
+	verify(!mmf->flushed(mmf->size())); // commit doesn't wait by default
+
+	thedb->sync_commit = true;
+	t = thedb->transaction(READWRITE);
+	thedb->add_record(t, "test", record("bob"));
+	verify(thedb->commit(t));
+	verify(mmf->flushed(mmf->size())); // including the commit record
+	thedb->sync_commit = false;
+	END
+}
+
+//-------------------------------------------------------------------
+
+// a long update transaction validated against many concurrent writers
+BENCHMARK(validate_reads) {
+	TempDB tempdb;
+	setup();
+	const int NWRITERS = 100;
+	int n = 0;
+	while (nreps-- > 0) {
+		int t = thedb->transaction(READWRITE);
+		for (int i = 0; i < 10; ++i) {
+			OstreamStr os;
+			os << "r" << i;
+			(void) thedb->get_index("test", "name")->begin(t, key(os.str()));
+		}
+		OstreamStr os;
+		os << "t" << n++;
+		thedb->add_record(t, "test", record(os.str()));
+		for (int i = 0; i < NWRITERS; ++i) {
+			int w = thedb->transaction(READWRITE);
+			OstreamStr os;
+			os << "w" << n++;
+			thedb->add_record(w, "test", record(os.str()));
+			verify(thedb->commit(w));
+		}
+		verify(thedb->commit(t));
+	}
+}
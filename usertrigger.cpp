@@ -14,27 +14,39 @@ extern bool is_client;
 
 static List<int> disabled_triggers;
 
-void Tbl::user_trigger(int tran, Record oldrec, Record newrec) {
-	if (tran == schema_tran)
-		return;
-	if (trigger == -1)
-		return;
+// returns the Trigger_ function for the table, if it has an enabled one
+static Value trigger_fn(Tbl* tbl) {
+	if (tbl->trigger == -1)
+		return Value();
 	Value fn;
-	if (!trigger) {
-		trigger = globals(CATSTRA("Trigger_", name.str()));
-		fn = globals.find(trigger);
+	if (!tbl->trigger) {
+		tbl->trigger = globals(CATSTRA("Trigger_", tbl->name.str()));
+		fn = globals.find(tbl->trigger);
 		if (!fn) {
-			globals.pop(trigger); // remove it if we just added it
-			trigger = -1;
-			return;
+			globals.pop(tbl->trigger); // remove it if we just added it
+			tbl->trigger = -1;
+			return Value();
 		}
-		flds = get_fields();
+		tbl->flds = tbl->get_fields();
 	} else {
-		fn = globals.find(trigger);
+		fn = globals.find(tbl->trigger);
 		if (!fn)
-			return;
+			return Value();
 	}
-	if (disabled_triggers.has(trigger))
+	if (disabled_triggers.has(tbl->trigger))
+		return Value();
+	return fn;
+}
+
+bool Tbl::has_user_trigger() {
+	return bool(trigger_fn(this));
+}
+
+void Tbl::user_trigger(int tran, Record oldrec, Record newrec) {
+	if (tran == schema_tran)
+		return;
+	Value fn = trigger_fn(this);
+	if (!fn)
 		return;
 	KEEPSP
 	SuTransaction* t = new SuTransaction(tran);
@@ -19,7 +19,7 @@ bool Value::toBool() const {
 int Value::index() const {
 	int n;
 	if (is_int())
-		n = im.n;
+		n = intval();
 	else if (!int_if_num(&n))
 		except("indexes must be integers");
 	return n;
@@ -27,7 +27,7 @@ int Value::index() const {
 
 Ostream& operator<<(Ostream& os, Value x) {
 	if (x.is_int())
-		os << x.im.n;
+		os << x.intval();
 	else if (x.p)
 		x.p->out(os);
 	else
@@ -40,55 +40,66 @@ bool operator==(Value x, Value y) {
 		return true;
 	if (!x.p || !y.p)
 		return false;
-	return x.is_int()                        //  X    Y
-		? y.is_int()                         //
-			? false                          // int	int
-			: NUM(x.im.n)->eq(*y.p)          // int  val
-		: y.is_int() ? x.p->eq(*NUM(y.im.n)) // val	int
-					 : x.p->eq(*y.p);        // val	val
+	return x.is_int()                            //  X    Y
+		? y.is_int()                             //
+			? false                              // int	int
+			: NUM(x.intval())->eq(*y.p)          // int  val
+		: y.is_int() ? x.p->eq(*NUM(y.intval())) // val	int
+					 : x.p->eq(*y.p);            // val	val
 }
 
 bool operator<(Value x, Value y) {
-	return x.is_int() ? y.is_int() ? x.im.n < y.im.n : NUM(x.im.n)->lt(*y.p)
-					  : y.is_int() ? x.p->lt(*NUM(y.im.n)) : x.p->lt(*y.p);
+	return x.is_int()
+		? y.is_int() ? x.intval() < y.intval() : NUM(x.intval())->lt(*y.p)
+		: y.is_int() ? x.p->lt(*NUM(y.intval())) : x.p->lt(*y.p);
 }
 
 Value Value::operator-() const {
-	return is_int() ? Value(-im.n) : Value(neg(p->number()));
+	return is_int() ? from_int64(-int64_t(intval())) : Value(neg(p->number()));
 }
 
 Value Value::operator+() const {
 	return is_int() ? *this : Value(p->number());
 }
 
+// integer operations are done in 64 bits so they can't overflow
+// results outside the immediate range are boxed by from_int64
+
 Value operator+(Value x, Value y) {
-	return x.is_int() ? y.is_int() ? Value(x.im.n + y.im.n)
-								   : Value(add(NUM(x.im.n), y.p->number()))
-					  : y.is_int() ? Value(add(x.p->number(), NUM(y.im.n)))
-								   : Value(add(x.p->number(), y.p->number()));
+	return x.is_int()
+		? y.is_int() ? Value::from_int64(int64_t(x.intval()) + y.intval())
+					 : Value(add(NUM(x.intval()), y.p->number()))
+		: y.is_int() ? Value(add(x.p->number(), NUM(y.intval())))
+					 : Value(add(x.p->number(), y.p->number()));
 }
 
 Value operator-(Value x, Value y) {
-	return x.is_int() ? y.is_int() ? Value(x.im.n - y.im.n)
-								   : Value(sub(NUM(x.im.n), y.p->number()))
-					  : y.is_int() ? Value(sub(x.p->number(), NUM(y.im.n)))
-								   : Value(sub(x.p->number(), y.p->number()));
+	return x.is_int()
+		? y.is_int() ? Value::from_int64(int64_t(x.intval()) - y.intval())
+					 : Value(sub(NUM(x.intval()), y.p->number()))
+		: y.is_int() ? Value(sub(x.p->number(), NUM(y.intval())))
+					 : Value(sub(x.p->number(), y.p->number()));
 }
 
 Value operator*(Value x, Value y) {
-	return x.is_int() ? y.is_int() ? Value(x.im.n * y.im.n)
-								   : Value(mul(NUM(x.im.n), y.p->number()))
-					  : y.is_int() ? Value(mul(x.p->number(), NUM(y.im.n)))
-								   : Value(mul(x.p->number(), y.p->number()));
+	return x.is_int()
+		? y.is_int() ? Value::from_int64(int64_t(x.intval()) * y.intval())
+					 : Value(mul(NUM(x.intval()), y.p->number()))
+		: y.is_int() ? Value(mul(x.p->number(), NUM(y.intval())))
+					 : Value(mul(x.p->number(), y.p->number()));
 }
 
 Value operator/(Value x, Value y) {
-	return x.is_int() ? y.is_int() ? y.im.n != 0 && (x.im.n % y.im.n) == 0
-				? Value(x.im.n / y.im.n)
-				: Value(div(NUM(x.im.n), NUM(y.im.n)))
-								   : Value(div(NUM(x.im.n), y.p->number()))
-					  : y.is_int() ? Value(div(x.p->number(), NUM(y.im.n)))
-								   : Value(div(x.p->number(), y.p->number()));
+	if (x.is_int() && y.is_int()) {
+		int64_t n = x.intval();
+		int64_t d = y.intval();
+		if (d != 0 && n % d == 0)
+			return Value::from_int64(n / d);
+		return Value(div(NUM(x.intval()), NUM(y.intval())));
+	}
+	return x.is_int() ? Value(div(NUM(x.intval()), y.p->number()))
+		: y.is_int()  ? Value(div(x.p->number(), NUM(y.intval())))
+					  : Value(div(x.p->number(), y.p->number()));
 }
 
 #include "catstr.h"
@@ -125,6 +136,7 @@ TEST(value) {
 	verify(mid == mid);
 	Value big(100000);
 	verify(big == big);
+	verify(big.is_int());
 	Value sym("sym");
 	verify(sym == sym);
 	Value str(new SuString("sym"));
@@ -147,21 +159,60 @@ TEST(value) {
 	verify(x.is_int());
 	assert_eq(x = mid + one, 30001);
 	verify(x.is_int());
-	verify(mid + mid == 60000); // overflow
+	assert_eq(x = mid + mid, 60000);
+	verify(x.is_int());
 	assert_eq(big + one, 100001);
-	assert_eq(big + big, 200000);
-	assert_eq(zero - mid - mid, -60000); // overflow
+	assert_eq(x = big + big, 200000);
+	verify(x.is_int());
+	assert_eq(zero - mid - mid, -60000);
+	assert_eq(-Value(INT_MIN), Value(new SuNumber("2147483648")));
+	assert_eq(Value(INT_MAX) + one, Value(new SuNumber("2147483648")));
+	assert_eq(Value(INT_MIN) - one, Value(new SuNumber("-2147483649")));
+	assert_eq(Value(INT_MIN) / SuMinusOne, -Value(INT_MIN));
 
 	assert_eq(Value(1) / Value(8), Value(new SuNumber(".125")));
 	assert_eq(x = mid / Value(300), 100);
 	verify(x.is_int());
 
-	assert_eq(x = mid * mid, Value(30000 * 30000)); // overflow
+	assert_eq(x = mid * mid, Value(30000 * 30000));
+	assert_eq(big * big, Value(new SuNumber("10000000000"))); // overflow
 }
 
 TEST(value_smallint) {
 	Value x(0x1234);
-	assert_eq((int) x.p, 0x1234ffff);
+	assert_eq(x.bits, 0x2469);
+	x = -0x1234;
+	assert_eq(x.bits, -0x2467);
+	assert_eq(x.intval(), -0x1234);
+	x = 0x3fffffff; // largest that fits with 32 bit pointers
+	verify(x.is_int());
+	assert_eq(x.intval(), 0x3fffffff);
+}
+
+// integer arithmetic in the immediate range should not allocate
+TEST(value_noalloc) {
+	int nalloc = SuNumber::nalloc;
+	Value x(0);
+	for (int i = 0; i < 1000; ++i)
+		x = x + Value(i * 1000) - Value(i);
+	assert_eq(x, 499500 * 999);
+	verify(x < Value(1000000000));
+	verify(x == Value(499500 * 999));
+	assert_eq(SuNumber::nalloc, nalloc);
+}
+
+BENCHMARK(value_add) {
+	Value x(12345678);
+	Value y(87654321);
+	while (nreps-- > 0)
+		(void) (x + y);
+}
+
+BENCHMARK(value_add_boxed) {
+	Value x(new SuNumber(12345678));
+	Value y(new SuNumber(87654321));
+	while (nreps-- > 0)
+		(void) (x + y);
 }
 
 #include "porttest.h"
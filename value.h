@@ -6,7 +6,8 @@
 #include "sunumber.h"
 #include "symbols.h"
 #include "gcstring.h"
-#include <malloc.h>
+#include <malloc.h>
+#include <climits>
 #include <typeinfo>
 
 class SuString;
@@ -19,13 +20,16 @@ class Ostream;
 
 // return a SuValue pointer, temporary auto box integer on stack if necessary
 // NOTE: only for use by Value, not intended to be public
-#define VAL ((SuValue*) (is_int() ? NUM(im.n) : p))
+#define VAL ((SuValue*) (is_int() ? NUM(intval()) : p))
 
 /*
- * Value is a "value" type that either directly contains a short integer
+ * Value is a "value" type that either directly contains an integer
  * or else wraps an SuValue* which handles polymorphism.
- * Assumes there are no valid pointer with a low short of 0xffff
+ * Integers are stored shifted left one bit with the low bit set.
+ * Assumes there are no valid pointers with the low bit set
  * which should be safe since alignment should be at least even.
+ * With 64 bit pointers any int fits,
+ * with 32 bit pointers the range is -2^30 to 2^30 - 1
  */
 class Value {
 public:
@@ -36,12 +40,20 @@ public:
 	Value(const SuString* x) : p((SuValue*) x) { // NOLINT
 	}
 	Value(int n) { // NOLINT
-		if (SHRT_MIN <= n && n <= SHRT_MAX) {
-			im.type = INTVAL;
-			im.n = n;
-		} else
+		if (fits(n))
+			bits = intptr_t(n) * 2 + 1;
+		else
 			p = new SuNumber(n);
 	}
+	// for the results of integer arithmetic, which may overflow int
+	static Value from_int64(int64_t n) {
+		return fits(n) ? Value(int(n)) : Value(SuNumber::from_int64(n));
+	}
+	// whether n can be stored directly, without allocating an SuNumber
+	static bool fits(int64_t n) {
+		return sizeof(intptr_t) > 4 ? INT_MIN <= n && n <= INT_MAX
+									: -0x40000000 <= n && n < 0x40000000;
+	}
 	Value(const char* s) : p(symbol(s).p) { // NOLINT
 	}
 
@@ -57,20 +69,20 @@ public:
 	bool toBool() const;
 
 	unsigned int hash() const {
-		return is_int() ? im.n : p->hashfn();
+		return is_int() ? intval() : p->hashfn();
 	}
 	unsigned int hashcontrib() const {
-		return is_int() ? im.n : p->hashcontrib();
+		return is_int() ? intval() : p->hashcontrib();
 	}
 
 	// does NOT accept false or "" as zero
 	[[nodiscard]] bool int_if_num(int* pn) const {
-		return is_int() ? (*pn = im.n, true) : p->int_if_num(pn);
+		return is_int() ? (*pn = intval(), true) : p->int_if_num(pn);
 	}
 
 	// throws, accepts false and "" as zero
 	int integer() const {
-		return is_int() ? im.n : (p ? p->integer() : 0);
+		return is_int() ? intval() : (p ? p->integer() : 0);
 	}
 
 	// throws, does NOT accept false or "" as zero
@@ -78,11 +90,13 @@ public:
 
 	// accepts false and "" as zero
 	SuNumber* number() const {
-		return is_int() ? new SuNumber(im.n) : p->number();
+		return is_int() ? new SuNumber(intval()) : p->number();
 	}
 
 	int symnum() const {
-		return is_int() && im.n > 0 ? im.n : VAL->symnum();
+		if (is_int() && 0 < intval() && intval() < 0x8000)
+			return intval();
+		return VAL->symnum();
 	}
 
 	const char* str_if_str() const {
@@ -164,17 +178,21 @@ public:
 	friend Ostream& operator<<(Ostream& os, Value x);
 
 	bool is_int() const {
-		return im.type == INTVAL;
+		return bits & 1;
+	}
+	// the same pointer or integer, cheaper than == but may miss equal values
+	bool same(Value y) const {
+		return bits == y.bits;
+	}
+	// only valid if is_int()
+	int intval() const {
+		return int(bits >> 1);
 	}
 
 private:
-	static const short INTVAL = static_cast<uint16_t>(0xffff);
 	union {
 		SuValue* p;
-		struct {
-			short type; // NOTE: should be low word
-			short n;
-		} im;
+		intptr_t bits;
 	};
 	friend void test_value_smallint();
 };